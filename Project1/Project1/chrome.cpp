@@ -0,0 +1,194 @@
+#include "chrome.h"
+
+#include <algorithm>
+#include <cmath>
+
+// hover and the caret pulse get snapped to steps, so an animation is a
+// handful of shapes instead of a new one every frame. the pulse is slow and
+// only dims a little, so it needs finer ones to not visibly step
+static const float kHoverSteps = 32.0f;
+static const float kPulseSteps = 128.0f;
+
+enum : uint64_t
+{
+    kGlowButtonShape = 1,
+    kCaretShape = 2,
+};
+
+void ChromeCache::NewFrame()
+{
+    m_stats.frameVertices = m_vertices;
+    m_stats.frameTessellated = m_tessellated;
+    m_vertices = 0;
+    m_tessellated = 0;
+
+    // shapes point into the atlas for their white pixel, a new atlas moves it
+    ImVec2 whitePixel = ImGui::GetFontTexUvWhitePixel();
+    if (whitePixel.x != m_whitePixel.x || whitePixel.y != m_whitePixel.y)
+    {
+        if (!m_shapes.empty())
+            m_stats.resets++;
+        m_shapes.clear();
+        m_whitePixel = whitePixel;
+    }
+}
+
+const ChromeCache::Shape* ChromeCache::Find(uint64_t key)
+{
+    auto it = m_shapes.find(key);
+    if (it == m_shapes.end())
+        return nullptr;
+    m_stats.replayed++;
+    return &it->second;
+}
+
+void ChromeCache::BeginRecord(ImDrawList& scratch)
+{
+    scratch._ResetForNewFrame();
+    scratch.PushClipRectFullScreen();
+}
+
+const ChromeCache::Shape& ChromeCache::EndRecord(uint64_t key, ImDrawList& scratch)
+{
+    if (m_shapes.size() >= kMaxShapes)
+    {
+        m_shapes.clear();
+        m_stats.resets++;
+    }
+    Shape& shape = m_shapes[key];
+    shape.vertices.assign(scratch.VtxBuffer.begin(), scratch.VtxBuffer.end());
+    shape.indices.assign(scratch.IdxBuffer.begin(), scratch.IdxBuffer.end());
+    m_tessellated += shape.vertices.size();
+    m_stats.recorded++;
+    return shape;
+}
+
+void ChromeCache::Replay(ImDrawList* drawList, const Shape& shape, ImVec2 pos)
+{
+    int vertexCount = (int)shape.vertices.size();
+    int indexCount = (int)shape.indices.size();
+    drawList->PrimReserve(indexCount, vertexCount);
+
+    // indices were recorded from 0, they move up to wherever this list is
+    unsigned int base = drawList->_VtxCurrentIdx;
+    ImDrawVert* vertex = drawList->_VtxWritePtr;
+    for (const ImDrawVert& v : shape.vertices)
+    {
+        vertex->pos = ImVec2(v.pos.x + pos.x, v.pos.y + pos.y);
+        vertex->uv = v.uv;
+        vertex->col = v.col;
+        vertex++;
+    }
+    ImDrawIdx* index = drawList->_IdxWritePtr;
+    for (ImDrawIdx i : shape.indices)
+        *index++ = (ImDrawIdx)(base + i);
+
+    drawList->_VtxWritePtr = vertex;
+    drawList->_IdxWritePtr = index;
+    drawList->_VtxCurrentIdx += vertexCount;
+    m_vertices += vertexCount;
+}
+
+static uint64_t ColorKey(int r, int g, int b)
+{
+    return (uint64_t)(r & 0xFF) | (uint64_t)(g & 0xFF) << 8 | (uint64_t)(b & 0xFF) << 16;
+}
+
+void DrawGlowButton(ImDrawList* drawList, ChromeCache* cache, ImVec2 center, ImU32 baseColor, ImU32 hoverColor, float hover)
+{
+    int step = (int)std::lround(std::clamp(hover, 0.0f, 1.0f) * kHoverSteps);
+    float hoverT = step / kHoverSteps;
+
+    // blend between normal and hover colors
+    int baseR = (baseColor >> 0) & 0xFF;
+    int baseG = (baseColor >> 8) & 0xFF;
+    int baseB = (baseColor >> 16) & 0xFF;
+    int hoverR = (hoverColor >> 0) & 0xFF;
+    int hoverG = (hoverColor >> 8) & 0xFF;
+    int hoverB = (hoverColor >> 16) & 0xFF;
+    int r = baseR + (int)((hoverR - baseR) * hoverT);
+    int g = baseG + (int)((hoverG - baseG) * hoverT);
+    int b = baseB + (int)((hoverB - baseB) * hoverT);
+
+    auto record = [=](ImDrawList* list, ImVec2 at) {
+        // layers of glow that fade out and spread further the more it's hovered.
+        // circles use imgui's own segment count, a 24px glow doesn't need 64
+        const float baseGlowRadius = 6.0f;
+        const float hoverGlowRadius = 16.0f;
+        float glowRadius = baseGlowRadius + (hoverGlowRadius - baseGlowRadius) * hoverT;
+        const int glowLayers = 8;
+        for (int i = glowLayers; i >= 0; i--)
+        {
+            float t = (float)i / glowLayers;
+            float radius = 8 + t * glowRadius;
+            float alphaF = expf(-t * t * 3.0f) * (0.06f + 0.22f * hoverT);
+            int alpha = (int)(alphaF * 255.0f);
+            if (alpha < 2)
+                continue;
+            list->AddCircleFilled(at, radius, IM_COL32(r, g, b, alpha));
+        }
+
+        // the button itself, and a little shine
+        list->AddCircleFilled(at, 8, IM_COL32(r, g, b, 255));
+        list->AddCircleFilled(ImVec2(at.x - 2, at.y - 2), 3, IM_COL32(255, 255, 255, 50 + (int)(40 * hoverT)));
+    };
+
+    if (!cache)
+    {
+        record(drawList, center);
+        return;
+    }
+    uint64_t key = kGlowButtonShape << 56 | (uint64_t)step << 24 | ColorKey(r, g, b);
+    cache->Draw(drawList, key, center, [&](ImDrawList* list) { record(list, ImVec2(0, 0)); });
+}
+
+void DrawCaret(ImDrawList* drawList, ChromeCache* cache, float x, float top, float height, ImU32 color, float alpha)
+{
+    int step = (int)std::lround(std::clamp(alpha, 0.0f, 1.0f) * kPulseSteps);
+    float alphaT = step / kPulseSteps;
+    int r = (color >> 0) & 0xFF;
+    int g = (color >> 8) & 0xFF;
+    int b = (color >> 16) & 0xFF;
+
+    auto record = [=](ImDrawList* list, ImVec2 at) {
+        const float width = 3.0f;
+        float centerX = at.x + width * 0.5f;
+        float centerY = at.y + height * 0.5f;
+
+        // soft glow, rounded rects growing outwards
+        const float glowRadius = 4.0f;
+        const int glowLayers = 6;
+        for (int i = glowLayers; i >= 0; i--)
+        {
+            float t = (float)i / glowLayers;
+            float radius = t * glowRadius;
+            float alphaF = expf(-t * t * 4.0f) * 0.15f * alphaT;
+            int layerAlpha = (int)(alphaF * 255.0f);
+            if (layerAlpha < 1)
+                continue;
+            list->AddRectFilled(
+                ImVec2(centerX - width * 0.5f - radius, centerY - height * 0.5f - radius),
+                ImVec2(centerX + width * 0.5f + radius, centerY + height * 0.5f + radius),
+                IM_COL32(r, g, b, layerAlpha),
+                radius + 2.0f);
+        }
+
+        // body with round ends
+        float bottom = at.y + height;
+        float end = width * 0.5f;
+        ImU32 body = IM_COL32(r, g, b, (int)(alphaT * 255));
+        list->AddRectFilled(ImVec2(at.x, at.y + end), ImVec2(at.x + width, bottom - end), body, 0.0f);
+        list->AddCircleFilled(ImVec2(at.x + end, at.y + end), end, body, 24);
+        list->AddCircleFilled(ImVec2(at.x + end, bottom - end), end, body, 24);
+    };
+
+    if (!cache)
+    {
+        record(drawList, ImVec2(x, top));
+        return;
+    }
+    // height in quarter pixels, it follows the font size
+    uint64_t heightKey = (uint64_t)std::lround(height * 4.0f) & 0xFFFF;
+    uint64_t key = kCaretShape << 56 | heightKey << 32 | (uint64_t)step << 24 | ColorKey(r, g, b);
+    cache->Draw(drawList, key, ImVec2(x, top), [&](ImDrawList* list) { record(list, ImVec2(0, 0)); });
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "imgui/imgui.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// the title bar buttons and the input caret are the same few shapes frame
+// after frame - layers of anti-aliased circles and rounded rects that cost
+// thousands of vertices to tessellate. each look (color, size, how far into
+// its hover or pulse animation) gets tessellated once around the origin and
+// after that it's a copy with a translate
+//
+// the vertices carry the atlas' white pixel uv, so a new atlas throws
+// everything away. past kMaxShapes the whole cache starts over
+class ChromeCache
+{
+public:
+    struct Stats
+    {
+        uint64_t recorded = 0;        // shapes tessellated
+        uint64_t replayed = 0;        // ...and drawn from the cache
+        uint64_t resets = 0;          // atlas changed or the cache filled up
+        size_t frameVertices = 0;     // vertices drawn last frame
+        size_t frameTessellated = 0;  // ...of those, how many had to be worked out
+    };
+
+    // once a frame, before drawing any chrome
+    void NewFrame();
+
+    // draws the shape for key with its origin at pos. the first time a key
+    // is seen, record draws it around (0, 0) into the list it's handed
+    template <typename Record>
+    void Draw(ImDrawList* drawList, uint64_t key, ImVec2 pos, Record&& record)
+    {
+        const Shape* shape = Find(key);
+        if (!shape)
+        {
+            // a list of its own each time - they're registered with the imgui
+            // context, and this cache outlives it
+            ImDrawList scratch(ImGui::GetDrawListSharedData());
+            BeginRecord(scratch);
+            record(&scratch);
+            shape = &EndRecord(key, scratch);
+        }
+        Replay(drawList, *shape, pos);
+    }
+
+    size_t Shapes() const { return m_shapes.size(); }
+    const Stats& GetStats() const { return m_stats; }
+
+    static constexpr size_t kMaxShapes = 128;
+
+private:
+    struct Shape
+    {
+        std::vector<ImDrawVert> vertices;
+        std::vector<ImDrawIdx> indices;
+    };
+
+    const Shape* Find(uint64_t key);
+    void BeginRecord(ImDrawList& scratch);
+    const Shape& EndRecord(uint64_t key, ImDrawList& scratch);
+    void Replay(ImDrawList* drawList, const Shape& shape, ImVec2 pos);
+
+    std::unordered_map<uint64_t, Shape> m_shapes;
+    ImVec2 m_whitePixel = ImVec2(-1.0f, -1.0f);
+    size_t m_vertices = 0;
+    size_t m_tessellated = 0;
+    Stats m_stats;
+};
+
+// a title bar button with its glow. hover 0..1 blends base into hoverColor.
+// without a cache it's tessellated on the spot
+void DrawGlowButton(ImDrawList* drawList, ChromeCache* cache, ImVec2 center, ImU32 baseColor, ImU32 hoverColor, float hover);
+
+// the input caret and its glow, left edge at x, top at top. alpha is the pulse
+void DrawCaret(ImDrawList* drawList, ChromeCache* cache, float x, float top, float height, ImU32 color, float alpha);
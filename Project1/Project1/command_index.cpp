@@ -0,0 +1,304 @@
+#include "command_index.h"
+#include "fuzzy.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <mutex>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::string Fold(std::string_view text)
+    {
+        std::string folded(text);
+        for (char& c : folded)
+            c = (char)tolower((unsigned char)c);
+        return folded;
+    }
+
+#ifdef _WIN32
+    constexpr char kPathSeparator = ';';
+    constexpr const char* kDefaultPathExt = ".COM;.EXE;.BAT;.CMD;.VBS;.VBE;.JS;.JSE;.WSF;.WSH;.MSC";
+#else
+    constexpr char kPathSeparator = ':';
+#endif
+
+    std::vector<std::string> SplitList(std::string_view list, char separator)
+    {
+        std::vector<std::string> items;
+        while (!list.empty())
+        {
+            size_t end = list.find(separator);
+            std::string_view item = list.substr(0, end);
+            // cmd tolerates quotes around PATH entries
+            if (item.size() >= 2 && item.front() == '"' && item.back() == '"')
+                item = item.substr(1, item.size() - 2);
+            if (!item.empty())
+                items.emplace_back(item);
+            if (end == std::string_view::npos)
+                break;
+            list.remove_prefix(end + 1);
+        }
+        return items;
+    }
+
+    // on windows "git.exe" runs as "git" if .exe is in PATHEXT - stemLength is then the "git" part
+    bool HasPathExt(std::string_view name, const std::vector<std::string>& exts, size_t& stemLength)
+    {
+#ifdef _WIN32
+        size_t dot = name.find_last_of('.');
+        if (dot == std::string_view::npos || dot == 0)
+            return false;
+        std::string ext = Fold(name.substr(dot));
+        if (std::find(exts.begin(), exts.end(), ext) == exts.end())
+            return false;
+        stemLength = dot;
+        return true;
+#else
+        (void)exts;
+        stemLength = name.size();
+        return true;
+#endif
+    }
+
+    // one entry per folded name, the most certain kind wins
+    void SortAndDedup(CommandList& list)
+    {
+        auto& entries = list.entries;
+        std::sort(entries.begin(), entries.end(), [](const CommandList::Entry& a, const CommandList::Entry& b) {
+            int c = a.folded.compare(b.folded);
+            return c != 0 ? c < 0 : a.kind > b.kind;
+        });
+        entries.erase(std::unique(entries.begin(), entries.end(), [](const CommandList::Entry& a, const CommandList::Entry& b) {
+            return a.folded == b.folded;
+        }), entries.end());
+
+        list.masks.clear();
+        list.masks.reserve(entries.size());
+        for (const auto& entry : entries)
+            list.masks.push_back(FuzzyCharMask(entry.folded));
+    }
+}
+
+const CommandList::Entry* CommandList::Find(std::string_view name) const
+{
+    std::string folded = Fold(name);
+    auto it = std::lower_bound(entries.begin(), entries.end(), folded, [](const Entry& e, const std::string& p) {
+        return e.folded < p;
+    });
+    if (it == entries.end() || it->folded != folded)
+        return nullptr;
+    return &*it;
+}
+
+struct CommandIndex::Published
+{
+    std::mutex mutex;
+    std::shared_ptr<const CommandList> current;
+    uint64_t buildId = 0;         // latest build started, older ones get dropped
+    std::atomic<uint64_t> generation{ 0 };
+};
+
+CommandIndex::CommandIndex(const std::vector<std::string>& known, const std::vector<std::string>& builtins)
+    : m_dirs(kMaxPathDirs), m_cwdDirs(4), m_published(std::make_shared<Published>())
+{
+    auto base = std::make_shared<CommandList>();
+    auto add = [&](const std::string& name, CommandList::Kind kind) {
+        CommandList::Entry entry;
+        entry.name = name;
+        entry.folded = Fold(name);
+        entry.kind = kind;
+        base->entries.push_back(std::move(entry));
+    };
+    for (const auto& name : known)
+        add(name, CommandList::kKnown);
+    for (const auto& name : builtins)
+        add(name, CommandList::kBuiltin);
+    SortAndDedup(*base);
+
+    m_base = base;
+    m_published->current = base;
+}
+
+std::shared_ptr<const CommandList> CommandIndex::Current() const
+{
+    std::lock_guard<std::mutex> lock(m_published->mutex);
+    return m_published->current;
+}
+
+uint64_t CommandIndex::Generation() const
+{
+    return m_published->generation.load();
+}
+
+void CommandIndex::Update(std::string_view pathVar, std::string_view pathExt, const std::string& cwd)
+{
+    bool pathChanged = pathVar != m_pathVar || pathExt != m_pathExt;
+    if (pathChanged)
+    {
+        m_pathVar = pathVar;
+        m_pathExt = pathExt;
+
+        // duplicates are common in PATH, the first one is the one that counts
+        std::vector<std::string> dirs = SplitList(pathVar, kPathSeparator);
+        m_dirPaths.clear();
+        for (auto& dir : dirs)
+        {
+            if (std::find(m_dirPaths.begin(), m_dirPaths.end(), dir) == m_dirPaths.end())
+                m_dirPaths.push_back(std::move(dir));
+        }
+        m_truncated = m_dirPaths.size() > kMaxPathDirs;
+        if (m_truncated)
+            m_dirPaths.resize(kMaxPathDirs);
+
+        m_exts.clear();
+#ifdef _WIN32
+        for (const auto& ext : SplitList(pathExt.empty() ? std::string_view(kDefaultPathExt) : pathExt, ';'))
+            m_exts.push_back(Fold(ext));
+#endif
+    }
+
+    // keeps the cwd listing warm for Resolve
+#ifdef _WIN32
+    m_cwdDirs.Lookup(cwd);
+#else
+    (void)cwd;
+#endif
+
+    // generation first, same as the completer - a listing landing mid-loop gets picked up next frame
+    uint64_t generation = m_dirs.Generation();
+    if (!pathChanged && generation == m_dirsGeneration)
+        return;
+    m_dirsGeneration = generation;
+    m_dirty = m_dirty || pathChanged;
+
+    // look them all up even if one is missing, so they all get read at once
+    std::vector<std::shared_ptr<const DirListing>> listings;
+    listings.reserve(m_dirPaths.size());
+    bool ready = true;
+    for (const auto& dir : m_dirPaths)
+    {
+        listings.push_back(m_dirs.Lookup(dir));
+        ready = ready && listings.back();
+    }
+    if (!ready)
+        return;  // the generation moves once the rest is read
+
+    // a change notification bumps the generation before the re-read lands
+    if (!m_dirty && listings == m_built)
+        return;
+    m_dirty = false;
+    m_built = listings;
+    StartBuild(std::move(listings));
+}
+
+void CommandIndex::StartBuild(std::vector<std::shared_ptr<const DirListing>> listings)
+{
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(m_published->mutex);
+        id = ++m_published->buildId;
+    }
+    m_builds++;
+
+    std::shared_ptr<Published> published = m_published;
+    std::shared_ptr<const CommandList> base = m_base;
+    WorkerPool::Shared().Submit([published, base, id, listings = std::move(listings), dirs = m_dirPaths, exts = m_exts,
+                                 complete = !m_truncated, pathVar = m_pathVar, pathExt = m_pathExt] {
+        auto list = std::make_shared<CommandList>();
+        list->entries = base->entries;
+        list->complete = complete;
+        list->pathVar = pathVar;
+        list->pathExt = pathExt;
+        for (size_t i = 0; i < listings.size(); i++)
+        {
+            // a directory we couldn't read might well have the command in it
+            list->complete = list->complete && listings[i]->readable;
+            for (const auto& file : listings[i]->entries)
+            {
+                size_t stemLength;
+                if (file.isDir || !HasPathExt(file.name, exts, stemLength))
+                    continue;
+#ifndef _WIN32
+                if (access((dirs[i] + "/" + file.name).c_str(), X_OK) != 0)
+                    continue;
+#endif
+                CommandList::Entry entry;
+                entry.name = file.name.substr(0, stemLength);
+                entry.folded = file.folded.substr(0, stemLength);
+                entry.kind = CommandList::kExecutable;
+                list->entries.push_back(std::move(entry));
+            }
+        }
+        SortAndDedup(*list);
+
+        std::lock_guard<std::mutex> lock(published->mutex);
+        if (published->buildId != id)
+            return;
+        published->current = std::move(list);
+        published->generation++;
+    });
+}
+
+CommandIndex::Resolution CommandIndex::Resolve(std::string_view name, std::string_view pathVar, std::string_view pathExt, const std::string& cwd)
+{
+    if (name.empty() || name.find_first_of("\\/:") != std::string_view::npos)
+        return Resolution::kUnknown;  // a path, the shell can sort that out
+
+    // only "missing" if we've seen everything the shell is going to look at.
+    // m_exts goes with the last Update's PATHEXT, so that has to match too
+    std::shared_ptr<const CommandList> list = Current();
+    if (!list->complete || list->pathVar != pathVar || list->pathExt != pathExt || m_pathExt != pathExt)
+        return Resolution::kUnknown;
+
+    size_t stemLength = name.size();
+    bool hasExt = HasPathExt(name, m_exts, stemLength);
+#ifdef _WIN32
+    // "notes.txt" opens with whatever .txt is associated with, not our business
+    if (!hasExt && name.find('.') != std::string_view::npos)
+        return Resolution::kUnknown;
+#endif
+    (void)hasExt;
+
+    const CommandList::Entry* entry = list->Find(name.substr(0, stemLength));
+    if (entry && entry->kind != CommandList::kKnown)
+        return Resolution::kFound;
+
+#ifdef _WIN32
+    // cmd looks in the current directory before PATH
+    std::shared_ptr<const DirListing> here = m_cwdDirs.Lookup(cwd);
+    if (!here || !here->readable)
+        return Resolution::kUnknown;
+    std::string stem = Fold(name.substr(0, stemLength));
+    auto [first, last] = here->PrefixRange(stem);
+    for (size_t i = first; i < last; i++)
+    {
+        const DirListing::Entry& file = here->entries[i];
+        size_t fileStem;
+        if (!file.isDir && HasPathExt(file.name, m_exts, fileStem) && fileStem == stem.size())
+            return Resolution::kFound;
+    }
+#else
+    (void)cwd;
+#endif
+    return Resolution::kMissing;
+}
+
+std::string_view CommandIndex::CommandWord(std::string_view line)
+{
+    size_t start = line.find_first_not_of(" \t@");  // @ is cmd's "don't echo this"
+    if (start == std::string_view::npos)
+        return {};
+    size_t end = line.find_first_of(" \t&|<>()^\";=,", start);
+    if (end == std::string_view::npos)
+        end = line.size();
+    // quoting, escapes and assignments - leave those to the shell
+    if (end < line.size() && (line[end] == '"' || line[end] == '^' || line[end] == '='))
+        return {};
+    return line.substr(start, end - start);
+}
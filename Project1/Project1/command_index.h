@@ -0,0 +1,93 @@
+#pragma once
+
+#include "dir_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// every command name we know of, sorted on the lowercased name like a DirListing
+struct CommandList
+{
+    enum Kind : uint8_t
+    {
+        kKnown,       // from the completion list, might not be installed here
+        kBuiltin,     // the shell (or the terminal) handles it itself
+        kExecutable,  // found in a PATH directory
+    };
+
+    struct Entry
+    {
+        std::string name;     // without the PATHEXT extension on windows
+        std::string folded;
+        Kind kind = kKnown;
+    };
+
+    std::vector<Entry> entries;   // one per folded name
+    std::vector<uint64_t> masks;  // FuzzyCharMask of each entry
+    bool complete = false;        // every PATH directory made it in
+    std::string pathVar;          // the PATH / PATHEXT it was built from
+    std::string pathExt;
+
+    const Entry* Find(std::string_view name) const;
+};
+
+// the command names completion offers and ExecuteCommand checks against:
+// the built-in list plus whatever is executable in the PATH directories.
+// the PATH directories are read and watched through a DirCache, and the
+// merged list gets rebuilt on a worker whenever one of them changes - the
+// ui thread only ever swaps a shared_ptr
+class CommandIndex
+{
+public:
+    enum class Resolution { kFound, kMissing, kUnknown };
+
+    // known = the completion list, builtins = what the shell runs itself
+    CommandIndex(const std::vector<std::string>& known, const std::vector<std::string>& builtins);
+
+    // call once a frame with the active pane's PATH/PATHEXT and cwd - cheap when nothing changed
+    void Update(std::string_view pathVar, std::string_view pathExt, const std::string& cwd);
+
+    // only builtins until the first build lands, never null
+    std::shared_ptr<const CommandList> Current() const;
+
+    // bumps whenever Current() changes
+    uint64_t Generation() const;
+
+    // would a shell with this PATH/PATHEXT find this command? kUnknown when we
+    // can't say for sure (paths, file associations, the index built from some
+    // other PATH or still building, a PATH directory we couldn't read...) - then just run it
+    Resolution Resolve(std::string_view name, std::string_view pathVar, std::string_view pathExt, const std::string& cwd);
+
+    // the command word of a line, "" if there isn't a plain one
+    static std::string_view CommandWord(std::string_view line);
+
+    size_t Builds() const { return m_builds; }
+    size_t PathDirs() const { return m_dirPaths.size(); }
+
+    static constexpr size_t kMaxPathDirs = DirCache::kMaxWatched;
+
+private:
+    struct Published;
+
+    void StartBuild(std::vector<std::shared_ptr<const DirListing>> listings);
+
+    std::shared_ptr<const CommandList> m_base;     // known + builtins, what every build starts from
+    DirCache m_dirs;                               // PATH directories
+    DirCache m_cwdDirs;                            // cwds, so changing directory doesn't push PATH ones out
+
+    std::string m_pathVar;
+    std::string m_pathExt;
+    std::vector<std::string> m_dirPaths;
+    std::vector<std::string> m_exts;               // lowercased, with the dot
+    bool m_truncated = false;                      // PATH had more than kMaxPathDirs directories
+    uint64_t m_dirsGeneration = ~0ull;
+    bool m_dirty = false;                          // PATH changed since the last build started
+    std::vector<std::shared_ptr<const DirListing>> m_built;   // what the current build was made from
+    size_t m_builds = 0;
+
+    std::shared_ptr<Published> m_published;       // shared with builds in flight
+};
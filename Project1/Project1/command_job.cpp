@@ -0,0 +1,67 @@
+#include "command_job.h"
+
+// lines queued before the reader waits for the ui, a couple of ms of Append per frame
+static const size_t kMaxQueuedLines = 32 * 1024;
+
+static void (*g_notify)() = nullptr;
+
+void CommandJob::SetNotify(void (*notify)())
+{
+    g_notify = notify;
+}
+
+CommandJob::CommandJob(std::string command)
+    : m_command(std::move(command)), m_started(std::chrono::steady_clock::now())
+{
+}
+
+void CommandJob::TakeLines(LineBatch& out)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        out.Append(m_lines);
+    }
+    m_drained.notify_one();
+}
+
+double CommandJob::Seconds() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_started).count();
+}
+
+// hand a batch over to the ui thread, waiting first if it's fallen behind
+void CommandJob::Publish(LineBatch& lines)
+{
+    m_linesRead += lines.Size();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_drained.wait(lock, [this] { return m_lines.Size() < kMaxQueuedLines || m_cancelled; });
+    m_lines.Append(lines);
+    lock.unlock();
+    if (g_notify)
+        g_notify();
+}
+
+void CommandJob::Finish(int exitCode)
+{
+    m_exitCode = exitCode;
+    m_finished = true;
+    if (g_notify)
+        g_notify();
+}
+
+void CommandJob::Fail(int startError)
+{
+    m_startError = startError;
+    m_finished = true;
+    if (g_notify)
+        g_notify();
+}
+
+void CommandJob::MarkCancelled()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cancelled = true;
+    }
+    m_drained.notify_one();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "line_splitter.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+// one external command's output on its way from a reader thread to the ui.
+// the reader (see ShellSession) Publishes batches of lines as they come in and
+// Finishes the job when the command is done, the ui thread picks the lines up
+// with TakeLines() every frame - nothing in here touches imgui or the panes
+// if the queue fills up the reader stops until the ui catches up, which in turn
+// stalls the child on a full pipe, so a flood can't make a single frame hitch
+class CommandJob
+{
+public:
+    explicit CommandJob(std::string command);
+
+    CommandJob(const CommandJob&) = delete;
+    CommandJob& operator=(const CommandJob&) = delete;
+
+    const std::string& Command() const { return m_command; }
+
+    // move the lines read since the last call onto the end of out
+    void TakeLines(LineBatch& out);
+
+    // true once the command is done and all of its output has been published
+    // (there might still be lines waiting in TakeLines)
+    bool Finished() const { return m_finished; }
+    int ExitCode() const { return m_exitCode; }
+    int StartError() const { return m_startError; }  // os error if the shell never started
+    bool Cancelled() const { return m_cancelled; }
+    size_t LinesRead() const { return m_linesRead; }
+    double Seconds() const;
+
+    // runs on the reader thread whenever there's something new for TakeLines
+    // or the job finished, so the ui can wake up for it. set once at startup
+    static void SetNotify(void (*notify)());
+
+    // reader side
+    void Publish(LineBatch& lines);
+    void Finish(int exitCode);
+    void Fail(int startError);
+    void MarkCancelled();
+
+private:
+    std::string m_command;
+    std::chrono::steady_clock::time_point m_started;
+
+    std::mutex m_mutex;                   // guards m_lines
+    std::condition_variable m_drained;    // ui took the queued lines (or we got cancelled)
+    LineBatch m_lines;
+
+    std::atomic<bool> m_finished{ false };
+    std::atomic<bool> m_cancelled{ false };
+    std::atomic<size_t> m_linesRead{ 0 };
+    int m_exitCode = 0;                   // only read after m_finished
+    int m_startError = 0;
+};
@@ -0,0 +1,194 @@
+#include "completion.h"
+#include "fuzzy.h"
+
+#include <algorithm>
+
+namespace
+{
+    bool IsPathWord(std::string_view word)
+    {
+        return word.find_first_of("\\/:") != std::string_view::npos;
+    }
+
+    // split "C:\foo\ba" into "C:\foo\" and "ba" (after turning / into \)
+    void SplitPath(std::string path, std::string& dirPath, std::string& partialName)
+    {
+        std::replace(path.begin(), path.end(), '/', '\\');
+
+        size_t lastSlash = path.find_last_of('\\');
+        if (lastSlash != std::string::npos)
+        {
+            dirPath = path.substr(0, lastSlash + 1);
+            partialName = path.substr(lastSlash + 1);
+        }
+        else
+        {
+            // no slash, just a drive letter like "C:"
+            dirPath = path;
+            if (dirPath.back() != '\\' && dirPath.back() != ':')
+            {
+                // it's something like "C:Use" - split into "C:" and "Use"
+                size_t colonPos = dirPath.find(':');
+                if (colonPos != std::string::npos && colonPos == dirPath.length() - 1)
+                    dirPath += "\\";
+            }
+            partialName = "";
+        }
+
+        // ensure directory ends with backslash
+        if (!dirPath.empty() && dirPath.back() == ':')
+            dirPath += "\\";
+    }
+
+    // the directory dirPath (as typed) points at, relative paths are relative to the pane's cwd
+    std::string ResolveDir(const std::string& dirPath, const std::string& cwd)
+    {
+        bool absolute = dirPath.size() >= 2 && (dirPath[1] == ':' || (dirPath[0] == '\\' && dirPath[1] == '\\'));
+        if (absolute)
+            return dirPath;
+        if (!dirPath.empty() && dirPath[0] == '\\')
+            return cwd.substr(0, 2) + dirPath;  // root of the pane's drive
+        return cwd + "\\" + dirPath;
+    }
+}
+
+Completer::Completer(CommandIndex& commands)
+    : m_commands(commands)
+{
+}
+
+bool Completer::Update(std::string_view input, int caret, const std::string& cwd)
+{
+    m_stats.updates++;
+    // the word also goes stale when the list it was matched against changes
+    uint64_t generation = m_isPath ? m_dirs.Generation() : m_commands.Generation();
+    if (m_valid && generation == m_generation && caret == m_caret && input == m_input && cwd == m_cwd)
+        return false;
+
+    int wordStart = caret;
+    while (wordStart > 0 && input[wordStart - 1] != ' ')
+        wordStart--;
+    std::string word(input.substr(wordStart, caret - wordStart));
+
+    std::vector<std::string> previous;
+    previous.swap(m_suggestions);
+    m_matchCount = 0;
+    if (word.empty())
+    {
+        m_isPath = false;
+        m_generation = m_commands.Generation();
+    }
+    else
+    {
+        m_stats.recomputes++;
+        Recompute(word, cwd);
+    }
+
+    m_input.assign(input.data(), input.size());
+    m_caret = caret;
+    m_cwd = cwd;
+    m_valid = true;
+    return previous != m_suggestions;
+}
+
+void Completer::Recompute(const std::string& word, const std::string& cwd)
+{
+    m_isPath = IsPathWord(word);
+    if (m_isPath)
+    {
+        std::string dirPath, partialName;
+        SplitPath(word, dirPath, partialName);
+        MatchDirectory(dirPath, partialName, cwd);
+    }
+    else
+    {
+        MatchCommand(word);
+    }
+}
+
+void Completer::MatchCommand(const std::string& word)
+{
+    m_generation = m_commands.Generation();
+    Rank(m_commands.Current(), word, std::string());
+}
+
+void Completer::MatchDirectory(const std::string& dirPath, const std::string& partialName, const std::string& cwd)
+{
+    std::string dir = ResolveDir(dirPath, cwd);
+#ifndef _WIN32
+    std::replace(dir.begin(), dir.end(), '\\', '/');
+#endif
+    // generation first, so a listing that lands right after the lookup still gets picked up next frame
+    m_generation = m_dirs.Generation();
+    std::shared_ptr<const DirListing> listing = m_dirs.Lookup(dir);
+    if (!listing)
+        return;  // still being read
+
+    if (partialName.empty())
+    {
+        // nothing typed after the slash yet, just list it
+        m_rankedList.reset();
+        m_matchCount = listing->entries.size();
+        for (size_t i = 0; i < listing->entries.size() && m_suggestions.size() < kMaxSuggestions; i++)
+            m_suggestions.push_back(dirPath + listing->entries[i].name + (listing->entries[i].isDir ? "\\" : ""));
+        return;
+    }
+    Rank(listing, partialName, dirPath);
+}
+
+namespace
+{
+    bool IsDirEntry(const DirListing::Entry& entry) { return entry.isDir; }
+    bool IsDirEntry(const CommandList::Entry&) { return false; }
+}
+
+template <typename List>
+void Completer::Rank(const std::shared_ptr<const List>& list, std::string_view word, const std::string& prefix)
+{
+    FuzzyPattern pattern(word);
+
+    // same list and the pattern only got longer - anything that didn't match before can't now
+    const std::string& folded = pattern.Folded();
+    bool narrow = m_rankedList == list && !m_rankedPattern.empty() && folded.size() > m_rankedPattern.size() &&
+        folded.compare(0, m_rankedPattern.size(), m_rankedPattern) == 0;
+
+    m_candidates.clear();
+    if (narrow)
+    {
+        m_stats.narrowed++;
+        for (uint32_t idx : m_hits)
+        {
+            if (pattern.MayMatch(list->masks[idx]))
+                m_candidates.push_back(idx);
+        }
+    }
+    else
+    {
+        pattern.Prefilter(list->masks.data(), list->masks.size(), m_candidates);
+    }
+    m_stats.scored += m_candidates.size();
+
+    m_hits.clear();
+    FuzzyTopK top(kMaxSuggestions);
+    for (uint32_t idx : m_candidates)
+    {
+        const auto& entry = list->entries[idx];
+        int score = pattern.Score(entry.name, entry.folded);
+        if (score <= 0)
+            continue;
+        m_hits.push_back(idx);
+        top.Push(score, (uint32_t)entry.name.size(), idx);
+    }
+    m_rankedList = list;
+    m_rankedPattern = folded;
+    m_matchCount = m_hits.size();
+
+    top.Take(m_best);
+    for (uint32_t idx : m_best)
+    {
+        const auto& entry = list->entries[idx];
+        m_suggestions.push_back(prefix + entry.name);
+        if (IsDirEntry(entry))
+            m_suggestions.back() += "\\";
+    }
+}
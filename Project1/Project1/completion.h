@@ -0,0 +1,78 @@
+#pragma once
+
+#include "command_index.h"
+#include "dir_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// autocomplete for the word under the caret - commands out of the command index,
+// or entries of a directory once the word looks like a path
+//
+// matching is fuzzy (see fuzzy.h) and the dropdown gets the best kMaxSuggestions.
+// results are memoized on (input, caret, cwd), so an idle input costs a string
+// compare per frame. typing more of the same word only rescores what matched
+// before, the lists themselves are kept up to date in the background
+class Completer
+{
+public:
+    struct Stats
+    {
+        uint64_t updates = 0;         // Update calls
+        uint64_t recomputes = 0;      // ...that had to work something out
+        uint64_t narrowed = 0;        // ...by rescoring the previous matches only
+        uint64_t scored = 0;          // candidates that made it past the prefilter
+    };
+
+    explicit Completer(CommandIndex& commands);
+
+    // cheap if nothing changed since last time, returns true if Suggestions() changed
+    bool Update(std::string_view input, int caret, const std::string& cwd);
+
+    // the best kMaxSuggestions matches, best first - what the dropdown shows
+    const std::vector<std::string>& Suggestions() const { return m_suggestions; }
+    // all of them
+    size_t MatchCount() const { return m_matchCount; }
+
+    // throw the memo away, e.g. after a command ran and might have created files
+    // (watched directories notice that by themselves)
+    void Invalidate() { m_valid = false; m_dirs.RefreshUnwatched(); }
+
+    const Stats& GetStats() const { return m_stats; }
+    DirCache::Stats DirStats() const { return m_dirs.GetStats(); }
+
+    static constexpr size_t kMaxSuggestions = 30;
+
+private:
+    void Recompute(const std::string& word, const std::string& cwd);
+    void MatchCommand(const std::string& word);
+    void MatchDirectory(const std::string& dirPath, const std::string& partialName, const std::string& cwd);
+    template <typename List>
+    void Rank(const std::shared_ptr<const List>& list, std::string_view word, const std::string& prefix);
+
+    CommandIndex& m_commands;
+
+    // memo key
+    std::string m_input;
+    int m_caret = -1;
+    std::string m_cwd;
+    uint64_t m_generation = 0;        // generation of the list the matches came out of
+    bool m_isPath = false;            // ...m_dirs if set, otherwise m_commands
+    bool m_valid = false;
+
+    size_t m_matchCount = 0;
+
+    // what the last ranking matched, so a longer pattern only has to look at those
+    std::shared_ptr<const void> m_rankedList;
+    std::string m_rankedPattern;
+    std::vector<uint32_t> m_hits;
+    std::vector<uint32_t> m_candidates;   // scratch
+    std::vector<uint32_t> m_best;         // scratch
+
+    std::vector<std::string> m_suggestions;
+    DirCache m_dirs;
+    Stats m_stats;
+};
@@ -0,0 +1,673 @@
+#include "dir_cache.h"
+#include "fuzzy.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr size_t kScanChunk = 4096;   // entries per worker job
+
+    std::string Fold(std::string_view text)
+    {
+        std::string folded(text);
+        for (char& c : folded)
+            c = (char)tolower((unsigned char)c);
+        return folded;
+    }
+
+    // what a directory is cached under - windows paths don't care about case or slash direction
+    std::string KeyOf(const std::string& path)
+    {
+#ifdef _WIN32
+        std::string key = Fold(path);
+        std::replace(key.begin(), key.end(), '/', '\\');
+        if (!key.empty() && key.back() != '\\')
+            key += '\\';
+        return key;
+#else
+        return path;
+#endif
+    }
+}
+
+std::pair<size_t, size_t> DirListing::PrefixRange(std::string_view prefix) const
+{
+    std::string folded = Fold(prefix);
+    auto first = std::lower_bound(entries.begin(), entries.end(), folded, [](const Entry& e, const std::string& p) {
+        return e.folded < p;
+    });
+    auto last = std::upper_bound(first, entries.end(), folded, [](const std::string& p, const Entry& e) {
+        return e.folded.compare(0, p.size(), p) > 0;
+    });
+    return { (size_t)(first - entries.begin()), (size_t)(last - entries.begin()) };
+}
+
+// watches directories for entries being added, removed or renamed on a thread
+// of its own. onChange(key, stillWatched) runs on that thread, stillWatched is
+// false when the watch went away (directory deleted, share dropped...)
+class DirCache::Watcher
+{
+public:
+    using Callback = std::function<void(const std::string& key, bool stillWatched)>;
+
+    explicit Watcher(Callback onChange);
+    ~Watcher();
+
+    // false if this directory can't be watched, watching one twice is fine
+    bool Watch(const std::string& key, const std::string& path);
+    void Unwatch(const std::string& key);
+
+private:
+    void Run();
+
+    Callback m_onChange;
+    std::mutex m_mutex;
+    std::thread m_thread;
+
+#ifdef _WIN32
+    struct DirWatch
+    {
+        std::string key;
+        HANDLE dir = INVALID_HANDLE_VALUE;
+        HANDLE event = nullptr;
+        OVERLAPPED overlapped = {};
+        DWORD buffer[1024];   // we only care that something changed, not what
+
+        bool Issue();
+        void Close();
+    };
+
+    // watches get opened on the calling thread and handed to ours, which owns them after that
+    struct Op
+    {
+        std::string key;
+        std::unique_ptr<DirWatch> watch;  // null = unwatch
+    };
+
+    std::vector<std::string> m_keys;      // guarded by m_mutex
+    std::vector<Op> m_ops;                // guarded by m_mutex
+    bool m_stopping = false;
+    HANDLE m_wake = nullptr;
+    std::vector<std::unique_ptr<DirWatch>> m_watches;   // watcher thread only
+#else
+    std::vector<std::pair<int, std::string>> m_watches;   // (wd, key), guarded by m_mutex
+    int m_fd = -1;
+    int m_wake[2] = { -1, -1 };
+#endif
+};
+
+struct DirCache::State
+{
+    struct Dir
+    {
+        std::string path;
+        std::shared_ptr<const DirListing> listing;
+        uint64_t lastUsed = 0;
+        uint64_t scanId = 0;      // the read whose result we'll take
+        bool scanning = false;
+        bool stale = false;
+        bool watched = false;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Dir> dirs;   // by KeyOf(path)
+    size_t maxDirs = 0;
+    uint64_t clock = 0;
+    uint64_t nextScanId = 0;
+    Stats stats;
+    std::atomic<uint64_t> generation{ 0 };
+    std::unique_ptr<Watcher> watcher;             // destroyed first, its thread calls back into us
+
+    ~State() { watcher.reset(); }
+
+    void Changed(const std::string& key, bool stillWatched)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = dirs.find(key);
+        if (it == dirs.end())
+            return;
+        it->second.stale = true;
+        it->second.watched = stillWatched;
+        stats.changes++;
+        generation++;
+    }
+};
+
+struct DirCache::Scan
+{
+    std::weak_ptr<State> state;
+    std::string key;
+    std::string path;
+    uint64_t id = 0;
+    bool watch = false;       // set up change notifications before reading
+    std::vector<DirListing::Entry> entries;
+
+#ifdef _WIN32
+    HANDLE find = INVALID_HANDLE_VALUE;
+    WIN32_FIND_DATAA data;
+#else
+    DIR* dir = nullptr;
+#endif
+    bool opened = false;
+    bool failed = false;      // couldn't open it
+
+    ~Scan();
+    bool Read(size_t count);  // true once every entry has been read
+    void Add(const char* name, bool isDir);
+};
+
+DirCache::Scan::~Scan()
+{
+#ifdef _WIN32
+    if (find != INVALID_HANDLE_VALUE)
+        FindClose(find);
+#else
+    if (dir)
+        closedir(dir);
+#endif
+}
+
+void DirCache::Scan::Add(const char* name, bool isDir)
+{
+    if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+        return;
+    DirListing::Entry entry;
+    entry.name = name;
+    entry.folded = Fold(entry.name);
+    entry.isDir = isDir;
+    entries.push_back(std::move(entry));
+}
+
+bool DirCache::Scan::Read(size_t count)
+{
+#ifdef _WIN32
+    if (!opened)
+    {
+        opened = true;
+        std::string pattern = path;
+        if (!pattern.empty() && pattern.back() != '\\' && pattern.back() != '/')
+            pattern += '\\';
+        pattern += '*';
+        // basic info skips the 8.3 names, large fetch gets more entries per trip to the kernel
+        find = FindFirstFileExA(pattern.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE)
+        {
+            failed = true;  // even an empty directory has . and ..
+            return true;
+        }
+        Add(data.cFileName, (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!FindNextFileA(find, &data))
+            return true;
+        Add(data.cFileName, (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+    }
+    return false;
+#else
+    if (!opened)
+    {
+        opened = true;
+        dir = opendir(path.c_str());
+        failed = !dir;
+    }
+    if (!dir)
+        return true;
+    for (size_t i = 0; i < count; i++)
+    {
+        dirent* entry = readdir(dir);
+        if (!entry)
+            return true;
+        bool isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN)
+        {
+            struct stat st;
+            isDir = fstatat(dirfd(dir), entry->d_name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+        }
+        Add(entry->d_name, isDir);
+    }
+    return false;
+#endif
+}
+
+DirCache::DirCache(size_t maxDirs)
+    : m_state(std::make_shared<State>())
+{
+    m_state->maxDirs = std::clamp<size_t>(maxDirs, 1, kMaxWatched);
+    State* state = m_state.get();
+    m_state->watcher = std::make_unique<Watcher>([state](const std::string& key, bool stillWatched) {
+        state->Changed(key, stillWatched);
+    });
+}
+
+DirCache::~DirCache()
+{
+    // scans still in flight hold a weak_ptr and drop their results once this is gone
+    m_state.reset();
+}
+
+std::shared_ptr<const DirListing> DirCache::Lookup(const std::string& path)
+{
+    std::string key = KeyOf(path);
+    std::string evicted;
+    std::shared_ptr<Scan> scan;
+    std::shared_ptr<const DirListing> listing;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->stats.lookups++;
+
+        auto it = m_state->dirs.find(key);
+        if (it == m_state->dirs.end())
+        {
+            if (m_state->dirs.size() >= m_state->maxDirs)
+            {
+                // make room by dropping whichever one we haven't looked at the longest
+                auto oldest = std::min_element(m_state->dirs.begin(), m_state->dirs.end(), [](const auto& a, const auto& b) {
+                    return a.second.lastUsed < b.second.lastUsed;
+                });
+                evicted = oldest->first;
+                m_state->dirs.erase(oldest);
+            }
+            it = m_state->dirs.emplace(key, State::Dir()).first;
+            it->second.path = path;
+        }
+
+        State::Dir& dir = it->second;
+        dir.lastUsed = ++m_state->clock;
+        if (dir.listing && !dir.stale)
+        {
+            m_state->stats.hits++;
+        }
+        else if (!dir.scanning)
+        {
+            dir.scanning = true;
+            dir.stale = false;
+            dir.scanId = ++m_state->nextScanId;
+            m_state->stats.scans++;
+
+            scan = std::make_shared<Scan>();
+            scan->state = m_state;
+            scan->key = key;
+            scan->path = dir.path;
+            scan->id = dir.scanId;
+            scan->watch = !dir.watched;
+        }
+        listing = dir.listing;
+    }
+
+    if (!evicted.empty())
+        m_state->watcher->Unwatch(evicted);
+    if (scan)
+        WorkerPool::Shared().Submit([scan] { RunScanChunk(scan); });
+    return listing;
+}
+
+void DirCache::RunScanChunk(std::shared_ptr<Scan> scan)
+{
+    std::shared_ptr<State> state = scan->state.lock();
+    if (!state)
+        return;
+
+    if (scan->watch)
+    {
+        // before reading, so nothing that changes while we read gets missed.
+        // done here and not in Lookup because opening a directory on a dead
+        // network share can take a while
+        scan->watch = false;
+        bool watched = state->watcher->Watch(scan->key, scan->path);
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        auto it = state->dirs.find(scan->key);
+        if (it == state->dirs.end())
+        {
+            // got evicted in the meantime, the unwatch already happened
+            if (watched)
+                state->watcher->Unwatch(scan->key);
+            return;
+        }
+        it->second.watched = watched;
+    }
+
+    if (!scan->Read(kScanChunk))
+    {
+        // big directory, give other jobs a turn
+        WorkerPool::Shared().Submit([scan] { RunScanChunk(scan); });
+        return;
+    }
+
+    auto listing = std::make_shared<DirListing>();
+    listing->entries = std::move(scan->entries);
+    listing->readable = !scan->failed;
+    std::sort(listing->entries.begin(), listing->entries.end(), [](const DirListing::Entry& a, const DirListing::Entry& b) {
+        int c = a.folded.compare(b.folded);
+        return c != 0 ? c < 0 : a.name < b.name;
+    });
+    listing->masks.reserve(listing->entries.size());
+    for (const auto& entry : listing->entries)
+        listing->masks.push_back(FuzzyCharMask(entry.folded));
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    auto it = state->dirs.find(scan->key);
+    if (it == state->dirs.end() || it->second.scanId != scan->id)
+        return;
+    it->second.listing = std::move(listing);
+    it->second.scanning = false;
+    state->generation++;
+}
+
+uint64_t DirCache::Generation() const
+{
+    return m_state->generation.load();
+}
+
+void DirCache::RefreshUnwatched()
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    bool any = false;
+    for (auto& [key, dir] : m_state->dirs)
+    {
+        if (!dir.watched && dir.listing)
+        {
+            dir.stale = true;
+            any = true;
+        }
+    }
+    if (any)
+        m_state->generation++;
+}
+
+DirCache::Stats DirCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->stats;
+}
+
+#ifdef _WIN32
+
+bool DirCache::Watcher::DirWatch::Issue()
+{
+    ResetEvent(event);
+    overlapped = {};
+    overlapped.hEvent = event;
+    return ReadDirectoryChangesW(dir, buffer, sizeof(buffer), FALSE,
+        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME, nullptr, &overlapped, nullptr) != 0;
+}
+
+void DirCache::Watcher::DirWatch::Close()
+{
+    if (dir != INVALID_HANDLE_VALUE)
+    {
+        // the read has to be finished before the buffer and event can go
+        DWORD bytes;
+        CancelIoEx(dir, &overlapped);
+        GetOverlappedResult(dir, &overlapped, &bytes, TRUE);
+        CloseHandle(dir);
+        dir = INVALID_HANDLE_VALUE;
+    }
+    if (event)
+    {
+        CloseHandle(event);
+        event = nullptr;
+    }
+}
+
+DirCache::Watcher::Watcher(Callback onChange)
+    : m_onChange(std::move(onChange))
+{
+    m_wake = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+    m_thread = std::thread([this] { Run(); });
+}
+
+DirCache::Watcher::~Watcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    SetEvent(m_wake);
+    m_thread.join();
+
+    for (auto& watch : m_watches)
+        watch->Close();
+    for (auto& op : m_ops)
+    {
+        if (op.watch)
+            op.watch->Close();
+    }
+    CloseHandle(m_wake);
+}
+
+bool DirCache::Watcher::Watch(const std::string& key, const std::string& path)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (std::find(m_keys.begin(), m_keys.end(), key) != m_keys.end())
+            return true;
+    }
+
+    auto watch = std::make_unique<DirWatch>();
+    watch->key = key;
+    watch->dir = CreateFileA(path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (watch->dir == INVALID_HANDLE_VALUE)
+        return false;
+    watch->event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    if (!watch->event || !watch->Issue())
+    {
+        // e.g. a share that doesn't do change notifications
+        watch->Close();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (std::find(m_keys.begin(), m_keys.end(), key) != m_keys.end())
+    {
+        watch->Close();  // someone beat us to it
+        return true;
+    }
+    m_keys.push_back(key);
+    m_ops.push_back({ key, std::move(watch) });
+    SetEvent(m_wake);
+    return true;
+}
+
+void DirCache::Watcher::Unwatch(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::find(m_keys.begin(), m_keys.end(), key);
+    if (it == m_keys.end())
+        return;
+    m_keys.erase(it);
+    m_ops.push_back({ key, nullptr });
+    SetEvent(m_wake);
+}
+
+void DirCache::Watcher::Run()
+{
+    std::vector<HANDLE> handles;
+    for (;;)
+    {
+        handles.assign(1, m_wake);
+        for (auto& watch : m_watches)
+            handles.push_back(watch->event);
+
+        // kMaxWatched keeps this under MAXIMUM_WAIT_OBJECTS
+        DWORD result = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, INFINITE);
+        if (result == WAIT_OBJECT_0)
+        {
+            std::vector<Op> ops;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_stopping)
+                    return;
+                ops.swap(m_ops);
+            }
+            // in order, a key can get unwatched and watched again before we wake up
+            for (auto& op : ops)
+            {
+                if (op.watch)
+                {
+                    m_watches.push_back(std::move(op.watch));
+                    continue;
+                }
+                auto it = std::find_if(m_watches.begin(), m_watches.end(), [&](const auto& w) { return w->key == op.key; });
+                if (it != m_watches.end())
+                {
+                    (*it)->Close();
+                    m_watches.erase(it);
+                }
+            }
+            continue;
+        }
+
+        size_t idx = result - WAIT_OBJECT_0 - 1;
+        if (idx >= m_watches.size())
+            continue;
+
+        // an overflowed buffer completes with 0 bytes, which still means "something changed"
+        DirWatch& watch = *m_watches[idx];
+        DWORD bytes;
+        GetOverlappedResult(watch.dir, &watch.overlapped, &bytes, FALSE);
+        std::string key = watch.key;
+        bool stillWatched = watch.Issue();
+        if (!stillWatched)
+        {
+            watch.Close();
+            m_watches.erase(m_watches.begin() + idx);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = std::find(m_keys.begin(), m_keys.end(), key);
+            if (it != m_keys.end())
+                m_keys.erase(it);
+        }
+        m_onChange(key, stillWatched);
+    }
+}
+
+#else
+
+DirCache::Watcher::Watcher(Callback onChange)
+    : m_onChange(std::move(onChange))
+{
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0 || pipe2(m_wake, O_CLOEXEC) != 0)
+        return;
+    m_thread = std::thread([this] { Run(); });
+}
+
+DirCache::Watcher::~Watcher()
+{
+    if (m_thread.joinable())
+    {
+        char c = 0;
+        (void)write(m_wake[1], &c, 1);
+        m_thread.join();
+    }
+    for (int fd : { m_fd, m_wake[0], m_wake[1] })
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+bool DirCache::Watcher::Watch(const std::string& key, const std::string& path)
+{
+    if (!m_thread.joinable())
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [wd, watchedKey] : m_watches)
+    {
+        if (watchedKey == key)
+            return true;
+    }
+    // the same directory under two keys gets the same wd back, which is fine
+    int wd = inotify_add_watch(m_fd, path.c_str(),
+        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    if (wd < 0)
+        return false;
+    m_watches.push_back({ wd, key });
+    return true;
+}
+
+void DirCache::Watcher::Unwatch(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::find_if(m_watches.begin(), m_watches.end(), [&](const auto& w) { return w.second == key; });
+    if (it == m_watches.end())
+        return;
+    int wd = it->first;
+    m_watches.erase(it);
+    bool shared = std::any_of(m_watches.begin(), m_watches.end(), [&](const auto& w) { return w.first == wd; });
+    if (!shared)
+        inotify_rm_watch(m_fd, wd);
+}
+
+void DirCache::Watcher::Run()
+{
+    alignas(inotify_event) char buffer[4096];
+    std::vector<std::pair<std::string, bool>> changed;
+    for (;;)
+    {
+        pollfd fds[2] = { { m_fd, POLLIN, 0 }, { m_wake[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0)
+            continue;
+        if (fds[1].revents)
+            return;
+
+        changed.clear();
+        for (;;)
+        {
+            ssize_t got = read(m_fd, buffer, sizeof(buffer));
+            if (got <= 0)
+                break;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (ssize_t offset = 0; offset < got;)
+            {
+                const inotify_event* event = (const inotify_event*)(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+
+                // IN_IGNORED = the watch is gone, the directory got deleted or unmounted
+                bool gone = (event->mask & IN_IGNORED) != 0;
+                for (const auto& [wd, key] : m_watches)
+                {
+                    if (wd == event->wd)
+                        changed.push_back({ key, !gone });
+                }
+                if (gone)
+                {
+                    m_watches.erase(std::remove_if(m_watches.begin(), m_watches.end(), [&](const auto& w) {
+                        return w.first == event->wd;
+                    }), m_watches.end());
+                }
+            }
+        }
+
+        // a burst of events for one directory only needs one callback
+        // (outside our lock - the callback takes the cache's lock, and Unwatch can get called under that)
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end(), [](const auto& a, const auto& b) { return a.first == b.first; }), changed.end());
+        for (const auto& [key, stillWatched] : changed)
+            m_onChange(key, stillWatched);
+    }
+}
+
+#endif
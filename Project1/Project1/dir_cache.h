@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// one directory's entries, sorted on the lowercased name so "everything that
+// starts with x, ignoring case" is a binary search instead of a scan
+struct DirListing
+{
+    struct Entry
+    {
+        std::string name;     // as it is on disk
+        std::string folded;   // lowercased, what the list is sorted on
+        bool isDir = false;
+    };
+
+    std::vector<Entry> entries;   // no . or ..
+    std::vector<uint64_t> masks;  // FuzzyCharMask of each entry, for the fuzzy prefilter
+    bool readable = true;         // false if it couldn't be opened (missing, no access...) - it's empty then
+
+    // [first, last) of the entries whose name starts with prefix, ignoring case
+    std::pair<size_t, size_t> PrefixRange(std::string_view prefix) const;
+};
+
+// directory listings for path completion. a directory gets read on a worker
+// the first time it's asked for, and stays cached until a change notification
+// (inotify / ReadDirectoryChangesW) says its entries changed - so Lookup never
+// touches the disk on the calling thread
+//
+// only the last maxDirs directories are kept (and watched)
+class DirCache
+{
+public:
+    struct Stats
+    {
+        uint64_t lookups = 0;
+        uint64_t hits = 0;            // ...answered with an up to date listing
+        uint64_t scans = 0;           // directory reads started
+        uint64_t changes = 0;         // change notifications that made a listing stale
+    };
+
+    explicit DirCache(size_t maxDirs = kMaxDirs);
+    ~DirCache();
+
+    DirCache(const DirCache&) = delete;
+    DirCache& operator=(const DirCache&) = delete;
+
+    // the listing for dir if we have one - possibly an old one while a re-read
+    // is running. nullptr means it's being read, ask again once Generation() moves.
+    // a directory that can't be read comes back as an empty listing
+    std::shared_ptr<const DirListing> Lookup(const std::string& dir);
+
+    // bumps whenever a listing arrives or goes stale
+    uint64_t Generation() const;
+
+    // re-read directories we couldn't get change notifications for
+    void RefreshUnwatched();
+
+    Stats GetStats() const;
+
+    static constexpr size_t kMaxDirs = 32;
+    static constexpr size_t kMaxWatched = 63;   // windows waits on one handle per directory, plus a wake event
+
+private:
+    struct State;
+    struct Scan;
+    class Watcher;
+
+    static void RunScanChunk(std::shared_ptr<Scan> scan);
+
+    std::shared_ptr<State> m_state;   // shared with scans in flight
+};
@@ -0,0 +1,137 @@
+#include "environment.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+extern char** environ;
+#endif
+
+namespace
+{
+    // names are case insensitive on windows, "=C:" style entries start with '=' so skip that one
+    std::string_view NameOf(std::string_view var)
+    {
+        size_t eq = var.find('=', 1);
+        return var.substr(0, eq == std::string_view::npos ? var.size() : eq);
+    }
+
+    int CompareNames(std::string_view a, std::string_view b)
+    {
+        size_t n = std::min(a.size(), b.size());
+        for (size_t i = 0; i < n; i++)
+        {
+#ifdef _WIN32
+            int ca = toupper((unsigned char)a[i]);
+            int cb = toupper((unsigned char)b[i]);
+#else
+            int ca = (unsigned char)a[i];
+            int cb = (unsigned char)b[i];
+#endif
+            if (ca != cb)
+                return ca < cb ? -1 : 1;
+        }
+        return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+    }
+
+    bool NameLess(const std::string& a, const std::string& b)
+    {
+        return CompareNames(NameOf(a), NameOf(b)) < 0;
+    }
+}
+
+Environment Environment::FromProcess()
+{
+    Environment env;
+    env.m_data = std::make_shared<Data>();
+#ifdef _WIN32
+    char* strings = GetEnvironmentStringsA();
+    for (const char* p = strings; p && *p; p += strlen(p) + 1)
+        env.m_data->vars.emplace_back(p);
+    if (strings)
+        FreeEnvironmentStringsA(strings);
+#else
+    for (char** p = environ; *p; p++)
+        env.m_data->vars.emplace_back(*p);
+#endif
+    std::stable_sort(env.m_data->vars.begin(), env.m_data->vars.end(), NameLess);
+    Rebuild(*env.m_data);
+    return env;
+}
+
+Environment Environment::FromVars(std::vector<std::string> vars)
+{
+    vars.erase(std::remove_if(vars.begin(), vars.end(), [](const std::string& var) {
+        return NameOf(var).size() == var.size();
+    }), vars.end());
+
+    Environment env;
+    env.m_data = std::make_shared<Data>();
+    env.m_data->vars = std::move(vars);
+    std::stable_sort(env.m_data->vars.begin(), env.m_data->vars.end(), NameLess);
+    Rebuild(*env.m_data);
+    return env;
+}
+
+const char* Environment::Get(std::string_view name) const
+{
+    if (!m_data)
+        return nullptr;
+    auto& vars = m_data->vars;
+    auto it = std::lower_bound(vars.begin(), vars.end(), name, [](const std::string& var, std::string_view key) {
+        return CompareNames(NameOf(var), key) < 0;
+    });
+    if (it == vars.end() || CompareNames(NameOf(*it), name) != 0)
+        return nullptr;
+    return it->c_str() + name.size() + 1;
+}
+
+void Environment::Set(std::string_view name, std::string_view value)
+{
+    // copy on write - anyone still holding the old block keeps seeing it unchanged
+    if (!m_data)
+        m_data = std::make_shared<Data>();
+    else if (m_data.use_count() > 1)
+        m_data = std::make_shared<Data>(Data{ m_data->vars, {}, {} });
+
+    auto& vars = m_data->vars;
+    auto it = std::lower_bound(vars.begin(), vars.end(), name, [](const std::string& var, std::string_view key) {
+        return CompareNames(NameOf(var), key) < 0;
+    });
+    bool found = it != vars.end() && CompareNames(NameOf(*it), name) == 0;
+    if (value.empty())
+    {
+        if (found)
+            vars.erase(it);
+    }
+    else
+    {
+        std::string var;
+        var.reserve(name.size() + 1 + value.size());
+        var.append(name).append("=").append(value);
+        if (found)
+            *it = std::move(var);
+        else
+            vars.insert(it, std::move(var));
+    }
+    Rebuild(*m_data);
+}
+
+void Environment::Rebuild(Data& data)
+{
+    data.block.clear();
+    data.envp.clear();
+    for (auto& var : data.vars)
+    {
+        data.block.append(var);
+        data.block.push_back('\0');
+        data.envp.push_back(var.data());
+    }
+    // an empty block still needs its double terminator
+    data.block.push_back('\0');
+    if (data.vars.empty())
+        data.block.push_back('\0');
+    data.envp.push_back(nullptr);
+}
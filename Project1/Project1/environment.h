@@ -0,0 +1,50 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// a block of environment variables that panes share until one of them changes
+// it - copying one is a shared_ptr copy, and Set only copies the variables
+// when someone else can still see them. the spawn block gets rebuilt on every
+// change so handing it to CreateProcess / posix_spawn costs nothing
+//
+// a default constructed one is empty and means "inherit ours"
+class Environment
+{
+public:
+    static Environment FromProcess();
+
+    // from "NAME=value" lines, like cmd's set prints them - anything without a '=' is skipped
+    static Environment FromVars(std::vector<std::string> vars);
+
+    bool Empty() const { return !m_data; }
+    size_t Size() const { return m_data ? m_data->vars.size() : 0; }
+
+    // nullptr if it isn't set
+    const char* Get(std::string_view name) const;
+
+    // empty value removes it, same as cmd's "set NAME="
+    void Set(std::string_view name, std::string_view value);
+
+#ifdef _WIN32
+    // "NAME=value\0...\0\0" sorted the way CreateProcess wants it, nullptr to inherit
+    void* Block() const { return m_data ? (void*)m_data->block.data() : nullptr; }
+#else
+    // null terminated envp for posix_spawn, nullptr to inherit
+    char* const* Block() const { return m_data ? m_data->envp.data() : nullptr; }
+#endif
+
+private:
+    struct Data
+    {
+        std::vector<std::string> vars;    // "NAME=value", sorted by name
+        std::string block;
+        std::vector<char*> envp;
+    };
+
+    static void Rebuild(Data& data);
+
+    std::shared_ptr<Data> m_data;
+};
@@ -0,0 +1,194 @@
+#include "frame_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+std::atomic<bool> FrameProfiler::s_enabled{ false };
+
+namespace
+{
+    // gives the ring back when its thread exits, so threads that come and go
+    // don't each leave one behind
+    struct RingOwner
+    {
+        std::atomic<bool>* owned = nullptr;
+        ~RingOwner()
+        {
+            if (owned)
+                owned->store(false);
+        }
+    };
+}
+
+const char* FrameProfiler::StageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::kFrame: return "Frame";
+    case Stage::kPump: return "Pump";
+    case Stage::kAutocomplete: return "Autocomplete";
+    case Stage::kOutput: return "Output";
+    case Stage::kSettings: return "Settings";
+    case Stage::kRender: return "ImGui::Render";
+    case Stage::kDraw: return "Draw";
+    case Stage::kPresent: return "Present";
+    case Stage::kWorkerJob: return "Worker job";
+    default: return "?";
+    }
+}
+
+FrameProfiler& FrameProfiler::Shared()
+{
+    static FrameProfiler* profiler = new FrameProfiler();
+    return *profiler;
+}
+
+void FrameProfiler::SetEnabled(bool enabled)
+{
+    s_enabled.store(enabled);
+}
+
+int64_t FrameProfiler::Now()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count() + 1;
+}
+
+FrameProfiler::ThreadRing* FrameProfiler::RingForThisThread()
+{
+    thread_local ThreadRing* ring = nullptr;
+    thread_local RingOwner owner;
+    if (ring)
+        return ring;
+
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    for (const std::unique_ptr<ThreadRing>& candidate : m_rings)
+    {
+        bool expected = false;
+        if (candidate->owned.compare_exchange_strong(expected, true))
+        {
+            ring = candidate.get();
+            break;
+        }
+    }
+    if (!ring)
+    {
+        m_rings.push_back(std::make_unique<ThreadRing>());
+        ring = m_rings.back().get();
+    }
+    ring->thread = m_nextThread++;
+    owner.owned = &ring->owned;
+    return ring;
+}
+
+void FrameProfiler::Record(Stage stage, int64_t start, int64_t end)
+{
+    ThreadRing* ring = RingForThisThread();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= kRingSize)
+    {
+        // nobody's collecting fast enough, the newest sample loses
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring->samples[head % kRingSize] = Sample{ start, end - start, stage, ring->thread };
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void FrameProfiler::Collect()
+{
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    for (const std::unique_ptr<ThreadRing>& ring : m_rings)
+    {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail < head; tail++)
+        {
+            const Sample& sample = ring->samples[tail % kRingSize];
+            StageHistory& history = m_stages[(size_t)sample.stage];
+            double ms = sample.duration / 1e6;
+            history.recent.push_back_overwrite((float)ms);
+            history.count++;
+            history.totalMs += ms;
+            history.maxMs = std::max(history.maxMs, ms);
+            m_capture.push_back_overwrite(sample);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+}
+
+FrameProfiler::Summary FrameProfiler::Summarize(Stage stage) const
+{
+    const StageHistory& history = m_stages[(size_t)stage];
+    Summary summary;
+    summary.count = history.count;
+    summary.maxMs = history.maxMs;
+    if (history.count == 0)
+        return summary;
+    summary.meanMs = history.totalMs / history.count;
+
+    std::vector<float> sorted(history.recent.size());
+    for (size_t i = 0; i < sorted.size(); i++)
+        sorted[i] = history.recent[i];
+    auto percentile = [&](double p) {
+        size_t at = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+        std::nth_element(sorted.begin(), sorted.begin() + at, sorted.end());
+        return (double)sorted[at];
+    };
+    summary.p50Ms = percentile(0.50);
+    summary.p99Ms = percentile(0.99);
+    return summary;
+}
+
+const std::vector<float>& FrameProfiler::Recent(Stage stage)
+{
+    StageHistory& history = m_stages[(size_t)stage];
+    history.scratch.resize(history.recent.size());
+    for (size_t i = 0; i < history.recent.size(); i++)
+        history.scratch[i] = history.recent[i];
+    return history.scratch;
+}
+
+uint64_t FrameProfiler::Dropped() const
+{
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    uint64_t dropped = 0;
+    for (const std::unique_ptr<ThreadRing>& ring : m_rings)
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    return dropped;
+}
+
+void FrameProfiler::Reset()
+{
+    // whatever's still sitting in the rings belongs to before the reset too
+    Collect();
+    for (StageHistory& history : m_stages)
+    {
+        history.recent.clear();
+        history.count = 0;
+        history.totalMs = 0.0;
+        history.maxMs = 0.0;
+    }
+    m_capture.clear();
+}
+
+bool FrameProfiler::SaveCapture(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+        return false;
+
+    // complete events, microseconds, a track per thread
+    file << "{\"traceEvents\":[\n";
+    char event[160];
+    for (size_t i = 0; i < m_capture.size(); i++)
+    {
+        const Sample& sample = m_capture[i];
+        snprintf(event, sizeof(event), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}\n",
+            i ? "," : "", StageName(sample.stage), sample.thread, sample.start / 1e3, sample.duration / 1e3);
+        file << event;
+    }
+    file << "]}\n";
+    return (bool)file;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "ring_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// where a frame's time goes. code marks its stages with a Scope, each thread
+// records into a ring of its own without locking, and the ui thread collects
+// the rings once a frame into recent timings per stage - enough for p50/p99
+// and a histogram - plus a longer capture that can be saved as a trace
+//
+// off unless asked for. a Scope while it's off is a relaxed load and a branch
+class FrameProfiler
+{
+public:
+    enum class Stage : uint8_t
+    {
+        kFrame,           // the whole frame, from deciding to draw to present
+        kPump,            // window messages, command output, history log
+        kAutocomplete,    // command index, history and completer updates
+        kOutput,          // drawing the output rows of a pane
+        kSettings,        // the settings window
+        kRender,          // ImGui::Render
+        kDraw,            // the dx11 backend
+        kPresent,         // waiting on the swap chain
+        kWorkerJob,       // a job on the shared worker pool
+        kCount
+    };
+    static const char* StageName(Stage stage);
+
+    struct Summary
+    {
+        uint64_t count = 0;           // since the last reset
+        double meanMs = 0.0;
+        double p50Ms = 0.0;           // over the recent samples
+        double p99Ms = 0.0;
+        double maxMs = 0.0;
+    };
+
+    // times from construction to End() or going out of scope
+    class Scope
+    {
+    public:
+        explicit Scope(Stage stage) : m_stage(stage), m_start(Enabled() ? Now() : 0) {}
+        ~Scope() { End(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void End()
+        {
+            if (m_start)
+                Shared().Record(m_stage, m_start, Now());
+            m_start = 0;
+        }
+
+    private:
+        Stage m_stage;
+        int64_t m_start;
+    };
+
+    // never destroyed - worker threads can still be finishing a scope while
+    // statics are torn down
+    static FrameProfiler& Shared();
+
+    static bool Enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    void SetEnabled(bool enabled);
+
+    // any thread. nanoseconds since the profiler started, never 0
+    static int64_t Now();
+    void Record(Stage stage, int64_t start, int64_t end);
+
+    // ui thread only from here on. drains every thread's ring
+    void Collect();
+    Summary Summarize(Stage stage) const;
+    // the recent samples of a stage in ms, oldest first
+    const std::vector<float>& Recent(Stage stage);
+    uint64_t Dropped() const;         // samples lost to a full ring
+    size_t Captured() const { return m_capture.size(); }
+    void Reset();
+
+    // the capture as a chrome://tracing / perfetto json file
+    bool SaveCapture(const std::string& path) const;
+
+    static constexpr size_t kRingSize = 4096;         // per thread, between collects
+    static constexpr size_t kRecentSamples = 240;     // per stage
+    static constexpr size_t kCaptureSamples = 1 << 16;
+
+private:
+    struct Sample
+    {
+        int64_t start;
+        int64_t duration;
+        Stage stage;
+        uint32_t thread;
+    };
+    // one writer (its thread) and one reader (Collect)
+    struct ThreadRing
+    {
+        std::atomic<uint64_t> head{ 0 };
+        std::atomic<uint64_t> tail{ 0 };
+        std::atomic<uint64_t> dropped{ 0 };
+        std::atomic<bool> owned{ true };   // a thread is writing to it, or can again later
+        uint32_t thread = 0;
+        Sample samples[kRingSize];
+    };
+    struct StageHistory
+    {
+        RingBuffer<float> recent{ kRecentSamples };
+        std::vector<float> scratch;       // recent, flattened for plotting
+        uint64_t count = 0;
+        double totalMs = 0.0;
+        double maxMs = 0.0;
+    };
+
+    FrameProfiler() = default;
+    ThreadRing* RingForThisThread();
+
+    static std::atomic<bool> s_enabled;
+
+    mutable std::mutex m_ringsMutex;  // only taken when a thread first records, and to collect
+    std::vector<std::unique_ptr<ThreadRing>> m_rings;
+    uint32_t m_nextThread = 0;
+    StageHistory m_stages[(size_t)Stage::kCount];
+    RingBuffer<Sample> m_capture{ kCaptureSamples };
+};
@@ -0,0 +1,63 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+
+void FrameScheduler::Invalidate(int frames)
+{
+    m_pendingFrames = std::max(m_pendingFrames, frames);
+}
+
+void FrameScheduler::Signal()
+{
+    // only the first signal since the last frame needs to wake anyone up
+    if (m_signalled.exchange(true))
+        return;
+    m_signals++;
+    if (m_wakeHook)
+        m_wakeHook();
+}
+
+void FrameScheduler::RequestFrameAt(Clock::time_point when)
+{
+    m_deadline = std::min(m_deadline, when);
+}
+
+void FrameScheduler::RequestFrameIn(double seconds)
+{
+    RequestFrameAt(m_frameTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)));
+}
+
+FrameScheduler::Clock::duration FrameScheduler::TimeToNextFrame(Clock::time_point now) const
+{
+    if (m_pendingFrames > 0 || m_signalled.load())
+        return Clock::duration::zero();
+    if (m_deadline == Clock::time_point::max())
+        return Clock::duration::max();
+    return m_deadline > now ? m_deadline - now : Clock::duration::zero();
+}
+
+bool FrameScheduler::BeginFrame(Clock::time_point now)
+{
+    m_stats.wakeups++;
+    m_stats.signals = m_signals.load();
+
+    // cleared before drawing, so a signal that lands mid frame wakes us again
+    bool signalled = m_signalled.exchange(false);
+    bool deadline = m_deadline <= now;
+    if (m_pendingFrames == 0 && !signalled && !deadline)
+        return false;
+
+    if (m_pendingFrames > 0)
+        m_pendingFrames--;
+    if (deadline)
+        m_stats.deadlines++;
+    m_deadline = Clock::time_point::max();
+    m_frameTime = now;
+    m_stats.frames++;
+    return true;
+}
+
+void FrameScheduler::Waited(Clock::duration slept)
+{
+    m_stats.waitedSeconds += std::chrono::duration<double>(slept).count();
+}
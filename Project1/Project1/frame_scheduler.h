@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+// decides when the main loop draws. an idle terminal has nothing to show, so
+// instead of building a frame every vsync the loop sleeps until there's input,
+// a worker signals new output, or an animation's next frame is due
+//
+// animations ask for their next frame while they're being drawn and stop
+// asking once they settle. no windows or imgui in here - the loop does the
+// actual waiting, all this keeps track of is whether a frame is owed and when
+class FrameScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats
+    {
+        uint64_t wakeups = 0;         // times the loop asked whether to draw
+        uint64_t frames = 0;          // ...and got a yes
+        uint64_t signals = 0;         // wakeups posted from other threads
+        uint64_t deadlines = 0;       // frames an animation asked for
+        double waitedSeconds = 0.0;   // time spent asleep in between
+    };
+
+    // on screen state changed. input wants two frames, imgui only settles
+    // hover and release state on the one after the event
+    void Invalidate(int frames = 1);
+
+    // any thread. there's something for the ui, draw a frame soon - the wake
+    // hook runs once until that frame starts, so a flood of output posts one
+    // message not thousands
+    void Signal();
+    void SetWakeHook(std::function<void()> hook) { m_wakeHook = std::move(hook); }
+
+    // a frame by then. only the earliest request counts and the next frame
+    // drawn uses it up, so something still moving asks again every frame
+    void RequestFrameAt(Clock::time_point when);
+    // relative to the frame being drawn
+    void RequestFrameIn(double seconds);
+
+    // how long the loop can sleep before a frame is owed - zero if one is due
+    // now, Clock::duration::max() if nothing is pending at all
+    Clock::duration TimeToNextFrame(Clock::time_point now) const;
+
+    // the loop woke up at now. true if a frame should be drawn, which clears
+    // whatever made it due
+    bool BeginFrame(Clock::time_point now);
+
+    // time the loop spent blocked, for the stats
+    void Waited(Clock::duration slept);
+
+    Clock::time_point FrameTime() const { return m_frameTime; }
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    int m_pendingFrames = 2;                     // draw the first ones unasked
+    Clock::time_point m_deadline = Clock::time_point::max();
+    Clock::time_point m_frameTime = Clock::now();
+    std::atomic<bool> m_signalled{ false };
+    std::atomic<uint64_t> m_signals{ 0 };
+    std::function<void()> m_wakeHook;
+    Stats m_stats;
+};
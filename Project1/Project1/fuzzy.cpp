@@ -0,0 +1,214 @@
+#include "fuzzy.h"
+
+#include <algorithm>
+#include <cctype>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define FUZZY_SSE2 1
+#endif
+
+namespace
+{
+    // same numbers fzf uses
+    constexpr int kScoreMatch = 16;
+    constexpr int kScoreGapStart = -3;
+    constexpr int kScoreGapExtension = -1;
+    constexpr int kBonusBoundary = kScoreMatch / 2;
+    constexpr int kBonusBoundaryWhite = kBonusBoundary + 2;
+    constexpr int kBonusBoundaryDelimiter = kBonusBoundary + 1;
+    constexpr int kBonusNonWord = kScoreMatch / 2;
+    constexpr int kBonusCamel = kBonusBoundary + kScoreGapExtension;
+    constexpr int kBonusConsecutive = -(kScoreGapStart + kScoreGapExtension);
+    constexpr int kBonusFirstCharMultiplier = 2;
+
+    enum CharClass { kWhite, kDelimiter, kNonWord, kLower, kUpper, kDigit };
+
+    CharClass ClassOf(char c)
+    {
+        if (c >= 'a' && c <= 'z') return kLower;
+        if (c >= 'A' && c <= 'Z') return kUpper;
+        if (c >= '0' && c <= '9') return kDigit;
+        if (c == ' ' || c == '\t') return kWhite;
+        if (c == '/' || c == '\\' || c == ':' || c == ';' || c == ',' || c == '|') return kDelimiter;
+        return kNonWord;
+    }
+
+    int BonusFor(CharClass prev, CharClass cls)
+    {
+        if (cls > kNonWord)
+        {
+            if (prev == kWhite) return kBonusBoundaryWhite;
+            if (prev == kDelimiter) return kBonusBoundaryDelimiter;
+            if (prev == kNonWord) return kBonusBoundary;
+        }
+        if ((prev == kLower && cls == kUpper) || (prev != kDigit && cls == kDigit))
+            return kBonusCamel;
+        if (cls == kNonWord || cls == kDelimiter)
+            return kBonusNonWord;
+        if (cls == kWhite)
+            return kBonusBoundaryWhite;
+        return 0;
+    }
+
+    int MaskBit(unsigned char c)
+    {
+        c = (unsigned char)tolower(c);
+        if (c >= 'a' && c <= 'z') return c - 'a';
+        if (c >= '0' && c <= '9') return 26 + (c - '0');
+        return 36 + c % 28;
+    }
+}
+
+uint64_t FuzzyCharMask(std::string_view text)
+{
+    uint64_t mask = 0;
+    for (char c : text)
+        mask |= 1ull << MaskBit((unsigned char)c);
+    return mask;
+}
+
+FuzzyPattern::FuzzyPattern(std::string_view pattern)
+    : m_folded(pattern)
+{
+    for (char& c : m_folded)
+        c = (char)tolower((unsigned char)c);
+    m_mask = FuzzyCharMask(m_folded);
+}
+
+void FuzzyPattern::Prefilter(const uint64_t* masks, size_t count, std::vector<uint32_t>& out) const
+{
+    size_t i = 0;
+#ifdef FUZZY_SSE2
+    // 4 masks a go. no 64 bit compare in sse2, so compare 32 bit halves and need both
+    const __m128i need = _mm_set1_epi64x((long long)m_mask);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(masks + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(masks + i + 2));
+        unsigned hitA = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(a, need), need));
+        unsigned hitB = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(b, need), need));
+        unsigned hits = hitA | (hitB << 16);
+        if (hits == 0)
+            continue;
+        for (unsigned lane = 0; lane < 4; lane++)
+        {
+            if (((hits >> (lane * 8)) & 0xFF) == 0xFF)
+                out.push_back((uint32_t)(i + lane));
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        if ((masks[i] & m_mask) == m_mask)
+            out.push_back((uint32_t)i);
+    }
+}
+
+int FuzzyPattern::Score(std::string_view text, std::string_view folded) const
+{
+    const size_t m = m_folded.size();
+    const size_t n = folded.size();
+    if (m == 0)
+        return 1;
+    if (m > n)
+        return 0;
+
+    // forward: where does the first in-order occurrence end
+    size_t pi = 0, end = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (folded[i] == m_folded[pi] && ++pi == m)
+        {
+            end = i;
+            break;
+        }
+    }
+    if (pi < m)
+        return 0;
+
+    // backward from there: the shortest window that still has all of it
+    size_t start = end;
+    pi = m;
+    for (size_t i = end + 1; i-- > 0;)
+    {
+        if (folded[i] == m_folded[pi - 1] && --pi == 0)
+        {
+            start = i;
+            break;
+        }
+    }
+
+    int score = 0;
+    int consecutive = 0;
+    int firstBonus = 0;
+    bool inGap = false;
+    CharClass prev = start > 0 ? ClassOf(text[start - 1]) : kWhite;
+    pi = 0;
+    for (size_t i = start; i <= end; i++)
+    {
+        CharClass cls = ClassOf(text[i]);
+        if (pi < m && folded[i] == m_folded[pi])
+        {
+            int bonus = BonusFor(prev, cls);
+            if (consecutive == 0)
+            {
+                firstBonus = bonus;
+            }
+            else
+            {
+                // a run keeps the bonus it started with
+                if (bonus >= kBonusBoundary && bonus > firstBonus)
+                    firstBonus = bonus;
+                bonus = std::max({ bonus, firstBonus, kBonusConsecutive });
+            }
+            score += kScoreMatch + (pi == 0 ? bonus * kBonusFirstCharMultiplier : bonus);
+            consecutive++;
+            inGap = false;
+            pi++;
+        }
+        else
+        {
+            score += inGap ? kScoreGapExtension : kScoreGapStart;
+            consecutive = 0;
+            firstBonus = 0;
+            inGap = true;
+        }
+        prev = cls;
+    }
+    return std::max(score, 1);
+}
+
+bool FuzzyTopK::Better(const Hit& a, const Hit& b)
+{
+    if (a.score != b.score)
+        return a.score > b.score;
+    if (a.length != b.length)
+        return a.length < b.length;
+    return a.index < b.index;
+}
+
+void FuzzyTopK::Push(int score, uint32_t length, uint32_t index)
+{
+    Hit hit = { score, length, index };
+    if (m_heap.size() < m_k)
+    {
+        m_heap.push_back(hit);
+        std::push_heap(m_heap.begin(), m_heap.end(), Better);
+    }
+    else if (m_k > 0 && Better(hit, m_heap.front()))
+    {
+        std::pop_heap(m_heap.begin(), m_heap.end(), Better);
+        m_heap.back() = hit;
+        std::push_heap(m_heap.begin(), m_heap.end(), Better);
+    }
+}
+
+void FuzzyTopK::Take(std::vector<uint32_t>& out)
+{
+    std::sort_heap(m_heap.begin(), m_heap.end(), Better);
+    out.clear();
+    for (const Hit& hit : m_heap)
+        out.push_back(hit.index);
+    m_heap.clear();
+}
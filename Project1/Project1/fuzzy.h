@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// fzf style fuzzy matching for completion: the pattern's characters have to
+// show up in order (ignoring case), and matches right after a separator, at a
+// camelCase hump or in a run score higher than ones scattered through the middle
+
+// one bit per character class text contains - letters and digits get a bit each,
+// everything else shares the rest. lists keep one per entry so the prefilter
+// can throw out most candidates with an and + compare
+uint64_t FuzzyCharMask(std::string_view text);
+
+class FuzzyPattern
+{
+public:
+    explicit FuzzyPattern(std::string_view pattern);
+
+    bool Empty() const { return m_folded.empty(); }
+    const std::string& Folded() const { return m_folded; }
+
+    // append the indices of the masks that have every class the pattern needs
+    void Prefilter(const uint64_t* masks, size_t count, std::vector<uint32_t>& out) const;
+    bool MayMatch(uint64_t mask) const { return (mask & m_mask) == m_mask; }
+
+    // 0 if it doesn't match, higher is better. folded is text lowercased
+    int Score(std::string_view text, std::string_view folded) const;
+
+private:
+    std::string m_folded;
+    uint64_t m_mask = 0;
+};
+
+// the best k candidates seen so far - ties go to the shorter one, then the earlier one
+class FuzzyTopK
+{
+public:
+    explicit FuzzyTopK(size_t k) : m_k(k) {}
+
+    void Push(int score, uint32_t length, uint32_t index);
+
+    // indices, best first. leaves it empty
+    void Take(std::vector<uint32_t>& out);
+
+private:
+    struct Hit
+    {
+        int score;
+        uint32_t length;
+        uint32_t index;
+    };
+
+    static bool Better(const Hit& a, const Hit& b);
+
+    size_t m_k;
+    std::vector<Hit> m_heap;   // worst on top
+};
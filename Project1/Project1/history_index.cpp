@@ -0,0 +1,156 @@
+#include "history_index.h"
+
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+
+namespace
+{
+    std::string Fold(std::string_view text)
+    {
+        std::string folded(text);
+        for (char& c : folded)
+            c = (char)tolower((unsigned char)c);
+        return folded;
+    }
+}
+
+// zoxide style buckets - a command run a lot last month still loses to one
+// run a few times this morning
+double HistoryIndex::Frecency(const Entry& entry, int64_t now)
+{
+    int64_t age = now - entry.last;
+    double recency = age < 3600 ? 4.0 : age < 86400 ? 2.0 : age < 7 * 86400 ? 0.5 : 0.25;
+    return entry.count * recency;
+}
+
+void HistoryIndex::Add(std::string_view command, int64_t when)
+{
+    if (command.empty())
+        return;
+    m_generation++;
+
+    std::string folded = Fold(command);
+    auto it = std::lower_bound(m_sorted.begin(), m_sorted.end(), folded, [&](uint32_t idx, const std::string& key) {
+        return m_entries[idx].folded < key;
+    });
+
+    // "Git Status" and "git status" fold the same but are kept apart
+    for (auto at = it; at != m_sorted.end() && m_entries[*at].folded == folded; ++at)
+    {
+        Entry& entry = m_entries[*at];
+        if (entry.text == command)
+        {
+            entry.count++;
+            entry.last = std::max(entry.last, when);
+            return;
+        }
+    }
+
+    Entry entry;
+    entry.text.assign(command.data(), command.size());
+    entry.folded = std::move(folded);
+    entry.count = 1;
+    entry.last = when;
+    m_sorted.insert(it, (uint32_t)m_entries.size());
+    m_entries.push_back(std::move(entry));
+}
+
+void HistoryIndex::AddMany(const std::vector<std::pair<std::string_view, int64_t>>& commands)
+{
+    if (commands.empty())
+        return;
+    m_generation++;
+
+    std::unordered_map<std::string_view, uint32_t> byText;
+    byText.reserve(m_entries.size() + commands.size());
+    m_entries.reserve(m_entries.size() + commands.size());
+    for (uint32_t i = 0; i < (uint32_t)m_entries.size(); i++)
+        byText.emplace(m_entries[i].text, i);
+
+    // views into m_entries would dangle when it grows, so new ones are keyed on the caller's text
+    for (const auto& [command, when] : commands)
+    {
+        if (command.empty())
+            continue;
+        auto [it, added] = byText.emplace(command, (uint32_t)m_entries.size());
+        if (!added)
+        {
+            Entry& entry = m_entries[it->second];
+            entry.count++;
+            entry.last = std::max(entry.last, when);
+            continue;
+        }
+        Entry entry;
+        entry.text.assign(command.data(), command.size());
+        entry.folded = Fold(command);
+        entry.count = 1;
+        entry.last = when;
+        m_entries.push_back(std::move(entry));
+    }
+
+    m_sorted.resize(m_entries.size());
+    for (uint32_t i = 0; i < (uint32_t)m_sorted.size(); i++)
+        m_sorted[i] = i;
+    std::sort(m_sorted.begin(), m_sorted.end(), [&](uint32_t a, uint32_t b) {
+        return m_entries[a].folded < m_entries[b].folded;
+    });
+}
+
+bool HistoryIndex::Update(std::string_view input, int64_t now)
+{
+    if (m_memoGeneration == m_generation && input == m_input)
+        return false;
+    m_input.assign(input.data(), input.size());
+    m_memoGeneration = m_generation;
+
+    std::vector<std::string> previous;
+    previous.swap(m_predictions);
+    m_ghost.clear();
+
+    if (!input.empty())
+    {
+        m_stats.lookups++;
+        std::string prefix = Fold(input);
+        auto first = std::lower_bound(m_sorted.begin(), m_sorted.end(), prefix, [&](uint32_t idx, const std::string& key) {
+            return m_entries[idx].folded < key;
+        });
+        auto last = std::upper_bound(first, m_sorted.end(), prefix, [&](const std::string& key, uint32_t idx) {
+            return m_entries[idx].folded.compare(0, key.size(), key) > 0;
+        });
+        m_stats.scanned += last - first;
+
+        // best few by frecency, newest first on ties. kMaxPredictions is tiny so
+        // an insertion sort into a fixed array beats a heap
+        struct Pick { double score; int64_t last; uint32_t idx; };
+        Pick best[kMaxPredictions];
+        size_t picked = 0;
+        for (auto it = first; it != last; ++it)
+        {
+            const Entry& entry = m_entries[*it];
+            if (entry.text.size() == input.size())
+                continue;  // that's just what's typed already
+            Pick pick = { Frecency(entry, now), entry.last, *it };
+            auto better = [](const Pick& a, const Pick& b) { return a.score != b.score ? a.score > b.score : a.last > b.last; };
+            if (picked == kMaxPredictions && !better(pick, best[picked - 1]))
+                continue;
+            size_t pos = picked < kMaxPredictions ? picked++ : picked - 1;
+            while (pos > 0 && better(pick, best[pos - 1]))
+            {
+                best[pos] = best[pos - 1];
+                pos--;
+            }
+            best[pos] = pick;
+        }
+
+        for (size_t i = 0; i < picked; i++)
+        {
+            const std::string& text = m_entries[best[i].idx].text;
+            m_predictions.push_back(text);
+            // the ghost has to line up with what's typed, so it needs the same case too
+            if (m_ghost.empty() && text.compare(0, input.size(), input) == 0)
+                m_ghost = text.substr(input.size());
+        }
+    }
+    return previous != m_predictions;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// every command run so far, for guessing what's being typed. each distinct
+// command is kept once with how often and when it last ran, sorted on the
+// lowercased text so everything starting with the input is one binary search
+// away. ranking is frecency: run count weighted by how recently it ran
+class HistoryIndex
+{
+public:
+    struct Stats
+    {
+        uint64_t lookups = 0;
+        uint64_t scanned = 0;         // entries looked at by those lookups
+    };
+
+    // when is unix time
+    void Add(std::string_view command, int64_t when);
+
+    // same as calling Add for each, but sorts once at the end instead of
+    // inserting one at a time - for loading a whole log
+    void AddMany(const std::vector<std::pair<std::string_view, int64_t>>& commands);
+    size_t Size() const { return m_entries.size(); }
+
+    // cheap if the input didn't change since last time, returns true if Predictions() changed
+    bool Update(std::string_view input, int64_t now);
+
+    // past commands that start with the input, best first
+    const std::vector<std::string>& Predictions() const { return m_predictions; }
+
+    // what the best prediction adds after the input, for the ghost text - "" if nothing
+    std::string_view Ghost() const { return m_ghost; }
+
+    const Stats& GetStats() const { return m_stats; }
+
+    static constexpr size_t kMaxPredictions = 5;
+
+private:
+    struct Entry
+    {
+        std::string text;
+        std::string folded;
+        uint32_t count = 0;
+        int64_t last = 0;
+    };
+
+    static double Frecency(const Entry& entry, int64_t now);
+
+    std::vector<Entry> m_entries;         // in the order they first ran
+    std::vector<uint32_t> m_sorted;       // m_entries indices, by folded text
+    uint64_t m_generation = 0;            // bumps on every Add
+
+    // memo
+    std::string m_input;
+    uint64_t m_memoGeneration = ~0ull;
+
+    std::vector<std::string> m_predictions;
+    std::string m_ghost;
+    Stats m_stats;
+};
@@ -0,0 +1,303 @@
+#include "history_log.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    template <typename T>
+    bool ParseNumber(std::string_view text, T& value)
+    {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size();
+    }
+
+    void AppendClean(std::string& out, std::string_view text)
+    {
+        for (char c : text)
+            out += (unsigned char)c < 32 ? ' ' : c;
+    }
+}
+
+HistoryLog::~HistoryLog()
+{
+    Unmap();
+#ifdef _WIN32
+    if (m_appendFile)
+        CloseHandle(m_appendFile);
+#else
+    if (m_appendFile >= 0)
+        close(m_appendFile);
+#endif
+}
+
+uint32_t HistoryLog::CurrentPid()
+{
+#ifdef _WIN32
+    return (uint32_t)GetCurrentProcessId();
+#else
+    return (uint32_t)getpid();
+#endif
+}
+
+bool HistoryLog::Open(const std::string& path)
+{
+    m_path = path;
+#ifdef _WIN32
+    // append only access - every WriteFile lands at the end no matter who else is writing.
+    // read access is just for peeking at the last byte
+    HANDLE file = CreateFileA(path.c_str(), FILE_APPEND_DATA | FILE_READ_DATA | SYNCHRONIZE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE)
+        m_appendFile = file;
+    bool canAppend = m_appendFile != nullptr;
+#else
+    m_appendFile = open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    bool canAppend = m_appendFile >= 0;
+#endif
+    return Map() || canAppend;
+}
+
+bool HistoryLog::Map()
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return size.QuadPart == 0;  // nothing to map yet isn't a failure
+    }
+    // the mapping keeps the file open, the handle isn't needed past this
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+    m_data = (const char*)view;
+    m_size = (uint64_t)size.QuadPart;
+#else
+    int fd = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return st.st_size == 0;
+    }
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+    m_data = (const char*)view;
+    m_size = (uint64_t)st.st_size;
+#endif
+
+    // a line still being written (or torn by a crash) waits until it has its newline
+    uint64_t end = m_size;
+    while (end > 0 && m_data[end - 1] != '\n')
+        end--;
+    m_complete = std::max(m_complete, end);
+    m_stats.bytes = m_size;
+    return true;
+}
+
+void HistoryLog::Unmap()
+{
+    if (!m_data)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+#else
+    munmap((void*)m_data, (size_t)m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool HistoryLog::Refresh()
+{
+    if (m_path.empty())
+        return false;
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(m_path.c_str(), GetFileExInfoStandard, &info))
+        return false;
+    uint64_t size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+#else
+    struct stat st;
+    if (stat(m_path.c_str(), &st) != 0)
+        return false;
+    uint64_t size = (uint64_t)st.st_size;
+#endif
+    if (size <= m_size)
+        return false;
+
+    uint64_t complete = m_complete;
+    Unmap();
+    if (!Map())
+        return false;
+    if (m_complete == complete)
+        return false;
+    m_stats.refreshes++;
+    return true;
+}
+
+bool HistoryLog::Append(std::string_view command, int64_t when, std::string_view cwd, int exitCode, uint32_t durationMs)
+{
+    std::string line;
+    line.reserve(command.size() + cwd.size() + 48);
+    line += std::to_string(when);
+    line += '\t';
+    line += std::to_string(CurrentPid());
+    line += '\t';
+    line += std::to_string(exitCode);
+    line += '\t';
+    line += std::to_string(durationMs);
+    line += '\t';
+    AppendClean(line, cwd);
+    line += '\t';
+    AppendClean(line, command);
+    line += '\n';
+
+    bool ok = false;
+#ifdef _WIN32
+    if (!m_appendFile)
+        return false;
+    // a byte way past anything real works as a lock between terminals without
+    // getting in the way of anyone reading or mapping the actual data
+    OVERLAPPED lockAt = {};
+    lockAt.Offset = 0xFFFFFFFF;
+    lockAt.OffsetHigh = 0x7FFFFFFF;
+    if (!LockFileEx(m_appendFile, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &lockAt))
+        return false;
+
+    // if the last writer died mid-line start a fresh one, so only its line is lost
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(m_appendFile, &size) && size.QuadPart > 0)
+    {
+        OVERLAPPED at = {};
+        at.Offset = (DWORD)(size.QuadPart - 1);
+        at.OffsetHigh = (DWORD)((size.QuadPart - 1) >> 32);
+        char last = '\n';
+        DWORD read = 0;
+        if (ReadFile(m_appendFile, &last, 1, &read, &at) && read == 1 && last != '\n')
+            line.insert(line.begin(), '\n');
+    }
+
+    DWORD written = 0;
+    ok = WriteFile(m_appendFile, line.data(), (DWORD)line.size(), &written, NULL) && written == line.size();
+    UnlockFileEx(m_appendFile, 0, 1, 0, &lockAt);
+#else
+    if (m_appendFile < 0)
+        return false;
+    if (flock(m_appendFile, LOCK_EX) != 0)
+        return false;
+
+    struct stat st;
+    char last = '\n';
+    if (fstat(m_appendFile, &st) == 0 && st.st_size > 0 && pread(m_appendFile, &last, 1, st.st_size - 1) == 1 && last != '\n')
+        line.insert(line.begin(), '\n');
+
+    ok = write(m_appendFile, line.data(), line.size()) == (ssize_t)line.size();
+    flock(m_appendFile, LOCK_UN);
+#endif
+    if (ok)
+        m_stats.appended++;
+    return ok;
+}
+
+bool HistoryLog::Parse(std::string_view line, HistoryRecord& record)
+{
+    std::string_view fields[5];
+    for (auto& field : fields)
+    {
+        size_t tab = line.find('\t');
+        if (tab == std::string_view::npos)
+            return false;
+        field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+    }
+    record.cwd = fields[4];
+    record.command = line;
+    return !record.command.empty() && ParseNumber(fields[0], record.when) && ParseNumber(fields[1], record.pid) &&
+        ParseNumber(fields[2], record.exitCode) && ParseNumber(fields[3], record.durationMs);
+}
+
+void HistoryLog::IndexTo(uint64_t end)
+{
+    HistoryRecord record;
+    while (m_indexed < end)
+    {
+        const char* start = m_data + m_indexed;
+        const char* newline = (const char*)memchr(start, '\n', (size_t)(end - m_indexed));
+        size_t length = (size_t)(newline - start);
+        if (length > 0)
+        {
+            if (Parse(std::string_view(start, length), record))
+                m_lines.push_back(m_indexed);
+            else
+                m_stats.skipped++;
+        }
+        m_indexed += length + 1;
+    }
+    m_stats.indexed = m_lines.size();
+}
+
+size_t HistoryLog::Size()
+{
+    IndexTo(m_complete);
+    return m_lines.size();
+}
+
+HistoryRecord HistoryLog::Record(size_t idx)
+{
+    IndexTo(m_complete);
+    uint64_t start = m_lines[idx];
+    const char* newline = (const char*)memchr(m_data + start, '\n', (size_t)(m_complete - start));
+    HistoryRecord record;
+    Parse(std::string_view(m_data + start, (size_t)(newline - (m_data + start))), record);
+    return record;
+}
+
+std::vector<HistoryRecord> HistoryLog::Tail(size_t count) const
+{
+    std::vector<HistoryRecord> records;
+    uint64_t end = m_complete;
+    while (end > 0 && records.size() < count)
+    {
+        // end sits just past a newline, the line runs back to the one before it
+        uint64_t start = end - 1;
+        while (start > 0 && m_data[start - 1] != '\n')
+            start--;
+        HistoryRecord record;
+        if (Parse(std::string_view(m_data + start, (size_t)(end - 1 - start)), record))
+            records.push_back(record);
+        end = start;
+    }
+    std::reverse(records.begin(), records.end());
+    return records;
+}
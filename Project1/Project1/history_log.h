@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// one command as it was written to the log. the views point into the mapped
+// file and are only good until the next Refresh()
+struct HistoryRecord
+{
+    int64_t when = 0;             // unix time it started
+    uint32_t pid = 0;             // terminal that ran it
+    int exitCode = 0;
+    uint32_t durationMs = 0;
+    std::string_view cwd;
+    std::string_view command;
+};
+
+// every command any terminal ran, in a plain text file next to settings.cfg -
+// one tab separated line per command: when, pid, exit code, duration, cwd, command
+//
+// the file only ever gets appended to. every terminal keeps a handle open for
+// appending and writes each line with a single write under a lock, so several
+// of them can share one log. reading maps the file instead of parsing it up
+// front: Tail() walks back from the end for the last few commands, and the
+// line index behind Size()/Record() only gets built the first time it's needed
+class HistoryLog
+{
+public:
+    struct Stats
+    {
+        uint64_t bytes = 0;           // mapped so far
+        uint64_t indexed = 0;         // lines the index has been built over
+        uint64_t skipped = 0;         // lines that didn't parse (torn writes, hand edits)
+        uint64_t appended = 0;
+        uint64_t refreshes = 0;       // times another terminal's writes were picked up
+    };
+
+    HistoryLog() = default;
+    ~HistoryLog();
+
+    HistoryLog(const HistoryLog&) = delete;
+    HistoryLog& operator=(const HistoryLog&) = delete;
+
+    // maps whatever's there already and opens it for appending, false if neither worked
+    bool Open(const std::string& path);
+
+    // writes one record to the end of the file. control characters in cwd and
+    // command become spaces, they'd break the line format
+    bool Append(std::string_view command, int64_t when, std::string_view cwd, int exitCode, uint32_t durationMs);
+
+    // remaps if the file grew (our own appends or another terminal's),
+    // returns true if there are new lines
+    bool Refresh();
+
+    // the last count commands, oldest first - doesn't need the index
+    std::vector<HistoryRecord> Tail(size_t count) const;
+
+    // these build the line index on first use
+    size_t Size();
+    HistoryRecord Record(size_t idx);
+
+    static uint32_t CurrentPid();
+
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    bool Map();
+    void Unmap();
+    void IndexTo(uint64_t end);
+    static bool Parse(std::string_view line, HistoryRecord& record);
+
+    std::string m_path;
+    const char* m_data = nullptr;
+    uint64_t m_size = 0;               // bytes mapped
+    uint64_t m_complete = 0;           // up to the last newline, a line still being written is past this
+    std::vector<uint64_t> m_lines;     // start of each good line up to m_indexed
+    uint64_t m_indexed = 0;
+
+#ifdef _WIN32
+    void* m_mapping = nullptr;
+    void* m_appendFile = nullptr;
+#else
+    int m_appendFile = -1;
+#endif
+    Stats m_stats;
+};
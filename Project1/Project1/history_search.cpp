@@ -0,0 +1,248 @@
+#include "history_search.h"
+#include "fuzzy.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <unordered_set>
+
+namespace
+{
+    constexpr size_t kBlockSize = 64 * 1024;
+
+    std::string Fold(std::string_view text)
+    {
+        std::string folded(text);
+        for (char& c : folded)
+            c = (char)tolower((unsigned char)c);
+        return folded;
+    }
+
+    constexpr int64_t kScanBlock = 4096;
+
+    // 6 bits a character - letters and digits get their own, the rest share.
+    // two runs landing on one slot just means an extra candidate to check
+    uint32_t Bucket(unsigned char c)
+    {
+        if (c >= 'a' && c <= 'z') return c - 'a';
+        if (c >= '0' && c <= '9') return 26 + (c - '0');
+        return 36 + c % 28;
+    }
+
+    uint32_t Trigram(const char* at)
+    {
+        return Bucket((unsigned char)at[0]) | (Bucket((unsigned char)at[1]) << 6) | (Bucket((unsigned char)at[2]) << 12);
+    }
+}
+
+const char* HistorySearch::Store(std::string_view text, std::string_view folded)
+{
+    size_t size = text.size() + folded.size();
+    char* at;
+    if (size > kBlockSize / 4)
+    {
+        // something huge gets a block of its own, the current one stays open
+        std::unique_ptr<char[]> block(new char[size]);
+        at = block.get();
+        m_blocks.insert(m_blocks.empty() ? m_blocks.end() : m_blocks.end() - 1, std::move(block));
+        if (m_blocks.size() == 1)
+            m_blockUsed = kBlockSize;
+    }
+    else
+    {
+        if (m_blocks.empty() || m_blockUsed + size > kBlockSize)
+        {
+            m_blocks.emplace_back(new char[kBlockSize]);
+            m_blockUsed = 0;
+        }
+        at = m_blocks.back().get() + m_blockUsed;
+        m_blockUsed += size;
+    }
+    memcpy(at, text.data(), text.size());
+    memcpy(at + text.size(), folded.data(), folded.size());
+    return at;
+}
+
+void HistorySearch::Append(std::string_view command)
+{
+    std::string folded = Fold(command);
+    const char* text = Store(command, folded);
+    uint32_t id = (uint32_t)m_docs.size();
+    m_docs.push_back({ text, (uint32_t)command.size(), true });
+
+    // run before - the old one stops counting. its text stays put until
+    // Compact, so the key can keep pointing at it
+    auto [it, added] = m_byText.try_emplace(std::string_view(text, command.size()), id);
+    if (!added)
+    {
+        m_docs[it->second].live = false;
+        m_live--;
+        it->second = id;
+    }
+    m_masks.push_back(FuzzyCharMask(folded));
+    if (id % kScanBlock == 0)
+        m_blockMasks.push_back(0);
+    m_blockMasks.back() |= m_masks.back();
+    m_live++;
+    if (m_slots.empty())
+        m_slots.assign(kTrigramSlots, kNoList);
+
+    // a command repeating a trigram only goes on its list once
+    static std::vector<uint32_t> grams;
+    grams.clear();
+    for (size_t i = 0; i + 3 <= folded.size(); i++)
+        grams.push_back(Trigram(folded.data() + i));
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    for (uint32_t gram : grams)
+    {
+        if (m_slots[gram] == kNoList)
+        {
+            m_slots[gram] = (uint32_t)m_postings.size();
+            m_postings.emplace_back();
+        }
+        m_postings[m_slots[gram]].push_back(id);
+    }
+}
+
+void HistorySearch::Add(std::string_view command)
+{
+    if (!command.empty())
+        Append(command);
+}
+
+void HistorySearch::AddMany(const std::vector<std::string_view>& commands)
+{
+    std::unordered_set<std::string_view> seen;
+    seen.reserve(commands.size());
+    std::vector<std::string_view> latest;
+    for (size_t i = commands.size(); i-- > 0;)
+    {
+        if (!commands[i].empty() && seen.insert(commands[i]).second)
+            latest.push_back(commands[i]);
+    }
+    m_docs.reserve(m_docs.size() + latest.size());
+    m_masks.reserve(m_masks.size() + latest.size());
+    m_byText.reserve(m_byText.size() + latest.size());
+    for (size_t i = latest.size(); i-- > 0;)
+        Add(latest[i]);
+}
+
+int64_t HistorySearch::Find(std::string_view query, int64_t from)
+{
+    m_stats.finds++;
+    from = std::min(from, Newest());
+    if (from < 0)
+        return -1;
+    std::string folded = Fold(query);
+
+    // too short for a trigram - the masks still rule out most of it cheaply.
+    // a block at a time, so the newest hit doesn't need the whole lot
+    // prefiltered and a character nobody typed skips everything
+    if (folded.size() < 3)
+    {
+        FuzzyPattern pattern(folded);
+        static std::vector<uint32_t> hits;
+        for (int64_t block = from / kScanBlock; block >= 0; block--)
+        {
+            if (!pattern.MayMatch(m_blockMasks[block]))
+                continue;  // nothing in this block has all the characters
+            int64_t start = block * kScanBlock;
+            int64_t end = std::min(from + 1, start + kScanBlock);
+            hits.clear();
+            pattern.Prefilter(m_masks.data() + start, (size_t)(end - start), hits);
+            for (size_t i = hits.size(); i-- > 0;)
+            {
+                uint32_t id = (uint32_t)start + hits[i];
+                if (!m_docs[id].live)
+                    continue;
+                m_stats.checked++;
+                if (Folded(id).find(folded) != std::string_view::npos)
+                    return id;
+            }
+        }
+        return -1;
+    }
+
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (size_t i = 0; i + 3 <= folded.size(); i++)
+    {
+        uint32_t slot = m_slots.empty() ? kNoList : m_slots[Trigram(folded.data() + i)];
+        if (slot == kNoList)
+            return -1;  // some part of it was never typed at all
+        lists.push_back(&m_postings[slot]);
+    }
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+        return a->size() != b->size() ? a->size() < b->size() : a < b;
+    });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+    // walk the rarest list down from `from`. ids only go down, so the window
+    // searched in every other list only ever shrinks
+    const std::vector<uint32_t>& driver = *lists[0];
+    std::vector<size_t> ends(lists.size());
+    for (size_t i = 1; i < lists.size(); i++)
+        ends[i] = lists[i]->size();
+    auto at = std::upper_bound(driver.begin(), driver.end(), (uint32_t)from);
+    while (at != driver.begin())
+    {
+        uint32_t id = *--at;
+        bool inAll = true;
+        for (size_t i = 1; i < lists.size() && inAll; i++)
+        {
+            const std::vector<uint32_t>& list = *lists[i];
+            ends[i] = std::upper_bound(list.begin(), list.begin() + ends[i], id) - list.begin();
+            inAll = ends[i] > 0 && list[ends[i] - 1] == id;
+        }
+        if (!inAll || !m_docs[id].live)
+            continue;
+        // the trigrams being there doesn't mean they're in a row
+        m_stats.checked++;
+        if (Folded(id).find(folded) != std::string_view::npos)
+            return id;
+    }
+    return -1;
+}
+
+std::string_view HistorySearch::Text(int64_t id) const
+{
+    if (id < 0 || id > Newest())
+        return {};
+    return std::string_view(m_docs[id].text, m_docs[id].length);
+}
+
+size_t HistorySearch::MatchOffset(int64_t id, std::string_view query) const
+{
+    if (id < 0 || id > Newest())
+        return 0;
+    size_t at = Folded((uint32_t)id).find(Fold(query));
+    return at == std::string_view::npos ? 0 : at;
+}
+
+bool HistorySearch::Compact()
+{
+    size_t dead = m_docs.size() - m_live;
+    if (dead < 1024 || dead < m_live)
+        return false;
+
+    std::vector<std::string> texts;
+    texts.reserve(m_live);
+    for (const Doc& doc : m_docs)
+    {
+        if (doc.live)
+            texts.emplace_back(doc.text, doc.length);
+    }
+    m_docs.clear();
+    m_masks.clear();
+    m_blockMasks.clear();
+    m_byText.clear();
+    m_postings.clear();
+    m_slots.clear();
+    m_blocks.clear();
+    m_blockUsed = 0;
+    m_live = 0;
+    for (const std::string& text : texts)
+        Append(text);
+    m_stats.compactions++;
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// substring search over history for ctrl+r, newest match first, ignoring case
+//
+// every distinct command gets an id, and running one again moves it to a new,
+// higher id - so newer is always a higher id and walking back through history
+// is counting down. each 3 character run of a command's lowercased text has a
+// list of the ids containing it. a query only has to look at the ids in its
+// rarest run's list, and a search that carries on from the current match
+// never looks at anything newer than it again
+class HistorySearch
+{
+public:
+    struct Stats
+    {
+        uint64_t finds = 0;
+        uint64_t checked = 0;         // candidates that got a real substring test
+        uint64_t compactions = 0;
+    };
+
+    void Add(std::string_view command);
+
+    // oldest first. only the last run of each command gets an id, so a whole
+    // log loads without leaving a trail of superseded entries behind
+    void AddMany(const std::vector<std::string_view>& commands);
+
+    // newest entry with an id <= from that contains query, -1 if there isn't one.
+    // from = Newest() starts at the top, from = match - 1 gets the next older one
+    int64_t Find(std::string_view query, int64_t from);
+    int64_t Newest() const { return (int64_t)m_docs.size() - 1; }
+
+    std::string_view Text(int64_t id) const;
+    // where query starts in Text(id), for putting the caret on it
+    size_t MatchOffset(int64_t id, std::string_view query) const;
+
+    size_t Size() const { return m_live; }
+
+    // renumbers ids to drop superseded entries once they pile up, so don't
+    // hold on to ids across it. true if it did anything
+    bool Compact();
+
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    static constexpr uint32_t kTrigramSlots = 1u << 18;
+    static constexpr uint32_t kNoList = ~0u;
+
+    struct Doc
+    {
+        const char* text;             // folded copy right after it
+        uint32_t length;
+        bool live;
+    };
+
+    void Append(std::string_view command);
+    std::string_view Folded(uint32_t id) const { return std::string_view(m_docs[id].text + m_docs[id].length, m_docs[id].length); }
+    const char* Store(std::string_view text, std::string_view folded);
+
+    std::vector<Doc> m_docs;
+    std::vector<uint64_t> m_masks;                      // FuzzyCharMask of each, for queries too short for trigrams
+    std::vector<uint64_t> m_blockMasks;                 // all of m_masks or'd together, a block at a time
+    std::unordered_map<std::string_view, uint32_t> m_byText;   // live id of each command
+    std::vector<uint32_t> m_slots;                      // trigram -> index into m_postings
+    std::vector<std::vector<uint32_t>> m_postings;      // ids with that trigram, ascending
+    size_t m_live = 0;
+
+    // text lives in fixed blocks so the views above never move
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    size_t m_blockUsed = 0;
+
+    Stats m_stats;
+};
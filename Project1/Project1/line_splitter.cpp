@@ -0,0 +1,56 @@
+#include "line_splitter.h"
+
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LINE_SPLITTER_SSE2 1
+#endif
+
+const char* FindLineBreak(const char* p, const char* end)
+{
+#ifdef LINE_SPLITTER_SSE2
+    // 32 bytes a go, compare against both bytes and or the masks
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (end - p >= 32)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)p);
+        __m128i b = _mm_loadu_si128((const __m128i*)(p + 16));
+        unsigned maskA = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(a, nl), _mm_cmpeq_epi8(a, cr)));
+        unsigned maskB = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(b, nl), _mm_cmpeq_epi8(b, cr)));
+        unsigned mask = maskA | (maskB << 16);
+        if (mask)
+            return p + std::countr_zero(mask);
+        p += 32;
+    }
+    if (end - p >= 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)p);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(a, nl), _mm_cmpeq_epi8(a, cr)));
+        if (mask)
+            return p + std::countr_zero(mask);
+        p += 16;
+    }
+#endif
+    for (; p < end; p++)
+    {
+        if (*p == '\n' || *p == '\r')
+            return p;
+    }
+    return end;
+}
+
+void LineBatch::Append(LineBatch& other)
+{
+    if (m_ends.empty())
+    {
+        Swap(other);
+        return;
+    }
+    size_t base = m_bytes.size();
+    m_bytes.append(other.m_bytes);
+    for (size_t end : other.m_ends)
+        m_ends.push_back(base + end);
+    other.Clear();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// first '\n' or '\r' in [p, end), or end. sse2 where we have it
+const char* FindLineBreak(const char* p, const char* end);
+
+// cuts a byte stream into lines as it arrives in chunks. lines that sit whole
+// inside a chunk get handed to the sink as a view straight into that chunk -
+// only lines split across two reads (or with a stray '\r' in them) get copied.
+// '\r' is dropped wherever it shows up, same as the old getline + remove pass
+class LineSplitter
+{
+public:
+    // sink(std::string_view line) gets called once per complete line
+    template <typename Sink>
+    void Feed(const char* data, size_t size, Sink&& sink)
+    {
+        const char* p = data;
+        const char* end = data + size;
+        for (;;)
+        {
+            const char* hit = FindLineBreak(p, end);
+            if (hit == end)
+                break;
+
+            if (*hit == '\n' || (hit + 1 < end && hit[1] == '\n'))
+            {
+                // end of a line, "\r\n" included
+                if (m_partial.empty())
+                {
+                    sink(std::string_view(p, hit - p));
+                }
+                else
+                {
+                    m_partial.append(p, hit);
+                    sink(std::string_view(m_partial));
+                    m_partial.clear();
+                }
+                p = hit + (*hit == '\r' ? 2 : 1);
+            }
+            else
+            {
+                // lone '\r' (or one at the very end of the chunk), keep what's before it
+                m_partial.append(p, hit);
+                p = hit + 1;
+            }
+        }
+        m_partial.append(p, end);
+    }
+
+    // stream ended, flush whatever didn't get a newline
+    template <typename Sink>
+    void Finish(Sink&& sink)
+    {
+        if (!m_partial.empty())
+            sink(std::string_view(m_partial));
+        m_partial.clear();
+    }
+
+private:
+    std::string m_partial;    // start of a line carried over from the previous chunk
+};
+
+// lines packed back to back in one buffer, so a read with a thousand lines in
+// it costs one append instead of a thousand little strings
+class LineBatch
+{
+public:
+    size_t Size() const { return m_ends.size(); }
+    bool Empty() const { return m_ends.empty(); }
+
+    std::string_view operator[](size_t idx) const
+    {
+        size_t begin = idx ? m_ends[idx - 1] : 0;
+        return std::string_view(m_bytes.data() + begin, m_ends[idx] - begin);
+    }
+
+    void Add(std::string_view line)
+    {
+        m_bytes.append(line.data(), line.size());
+        m_ends.push_back(m_bytes.size());
+    }
+
+    // move other's lines onto the end of this one
+    void Append(LineBatch& other);
+
+    // keeps the capacity, batches get reused
+    void Clear()
+    {
+        m_bytes.clear();
+        m_ends.clear();
+    }
+
+    void Swap(LineBatch& other)
+    {
+        m_bytes.swap(other.m_bytes);
+        m_ends.swap(other.m_ends);
+    }
+
+private:
+    std::string m_bytes;
+    std::vector<size_t> m_ends;
+};
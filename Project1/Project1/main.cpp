@@ -3,6 +3,28 @@
 #include "imgui/imgui_impl_win32.h"
 #include "imgui/imgui_impl_dx11.h"
 
+// terminal internals
+#include "scrollback.h"
+#include "output_layout.h"
+#include "chrome.h"
+#include "command_job.h"
+#include "frame_profiler.h"
+#include "frame_scheduler.h"
+#include "shell_session.h"
+#include "command_index.h"
+#include "completion.h"
+#include "fuzzy.h"
+#include "history_index.h"
+#include "history_log.h"
+#include "history_search.h"
+#include "output_index.h"
+#include "output_search.h"
+#include "ring_buffer.h"
+#include "row_cache.h"
+#include "soft_renderer.h"
+#include "text_grid.h"
+#include "worker_pool.h"
+
 // windows and graphics stuff
 #include <d3d11.h>
 #include <tchar.h>
@@ -16,6 +38,8 @@
 #include <memory>
 #include <fstream>
 #include <shlobj.h>
+#include <ctime>
+#include <thread>
 
 // gotta link these libraries or nothing works
 #pragma comment(lib, "shell32.lib")
@@ -32,17 +56,40 @@ static ID3D11RenderTargetView* g_mainRenderTargetView = nullptr;
 // terminal pane struct - holds state for the terminal
 struct TerminalPane
 {
-    std::vector<std::string> outputLines;
+    Scrollback outputLines;
+    OutputSearch outputSearch;     // ctrl+f hits, kept in step with the query and the output
+    OutputIndex outputIndex;       // opt in (settings index on), lets ctrl+f skip lines that can't match
+    OutputLayout outputLayout;     // wrapped row index so we only draw what's visible
+    RowCache rowCache;             // vertices of rows drawn recently, replayed while they stay on screen
+    uint64_t contextLineId;        // line the right-click menu was opened on
+    bool jumpPending;              // search navigation asked for the view to go to...
+    uint64_t jumpLineId;           // ...this line...
+    uint32_t jumpOffset;           // ...at this byte, worked out against the layout when it's drawn
     char inputBuffer[256];
-    std::string currentDir;
+    std::string currentDir;        // passed to the shell at spawn, completion resolves against it
+    Environment env;               // copy on write, both panes share one until someone sets something
     float caretTime;
     int caretPos;
-    std::vector<std::string> commandHistory;
+    RingBuffer<std::string> commandHistory;   // what ctrl+z walks back through, oldest drops off
     int historyIndex;
     bool isActive;
 
+    // ctrl+r reverse search - while it's on the input line shows the match
+    struct SearchStep
+    {
+        size_t queryLength;
+        int64_t match;                 // g_historySearch id, -1 before anything matched
+        bool failed;
+    };
+    bool searching;
+    std::string searchQuery;
+    std::string searchSaved;           // the input from before, escape puts it back
+    std::vector<SearchStep> searchSteps;   // one per key, backspace steps back
+    ShellSession shell;                // cmd.exe this pane's commands get piped into
+    std::shared_ptr<CommandJob> job;   // external command running in this pane, if any
+
     TerminalPane()
-        : currentDir("C:\\Users\\User"), caretTime(0.0f), caretPos(0), historyIndex(-1), isActive(false)
+        : contextLineId(0), jumpPending(false), jumpLineId(0), jumpOffset(0), currentDir("C:\\Users\\User"), caretTime(0.0f), caretPos(0), historyIndex(-1), isActive(false), searching(false)
     {
         inputBuffer[0] = '\0';
     }
@@ -60,8 +107,11 @@ void CleanupRenderTarget();
 void ProcessCommand(const std::string& cmd);
 void RenderBlur(HWND hwnd);
 void AddOutputLine(const std::string& line);
-void AddOutputLineToPane(int paneIdx, const std::string& line);
+void AddOutputLineToPane(int paneIdx, std::string_view line);
+void ExecuteCommand(int paneIdx, const std::string& cmd);
+void PumpCommandJobs();
 void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io);
+void RenderPerfOverlay(ImGuiIO& io);
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 // window dragging
@@ -76,6 +126,7 @@ static ImVec4 g_bgColor = ImVec4(0.02f, 0.02f, 0.031f, 1.0f);     // dark blue-b
 static ImVec4 g_textColor = ImVec4(0.9f, 0.9f, 0.9f, 1.0f);       // white-ish
 static ImVec4 g_blurTintColor = ImVec4(0.15f, 0.17f, 0.22f, 0.3f); // blue-tinted blur
 static bool g_showSettingsWindow = false;
+static bool g_showPerfOverlay = false;  // perf overlay - frame stage timings, turns the profiler on
 
 // temporary settings (for preview before saving)
 static bool g_tempBlurEnabled = true;
@@ -99,7 +150,10 @@ static int g_previewCharIndex = 0;
 static std::string g_previewCurrentText = "";
 static float g_previewSmoothCaretX = 0.0f;  // for smooth caret movement
 
-// how many commands to remember in history
+// per pane scrollback budget - oldest output gets dropped past this
+static int g_scrollbackMB = 32;
+
+// how many commands ctrl+z can walk back through per pane - the log on disk keeps everything
 static int g_maxHistorySize = 50;
 
 // font stuff - consolas looks like a proper terminal
@@ -116,14 +170,16 @@ static int g_maxTrailLength = 8;  // max number of trail dots
 
 // search stuff for finding text in output
 static bool g_showSearch = false;
+static bool g_focusSearch = false;      // put the caret in the search box next frame
 static char g_searchBuffer[256] = "";
-static std::vector<int> g_searchResults;  // which lines matched
-static int g_currentSearchResult = -1;  // currently highlighted match
+static int g_currentSearchResult = -1;  // index into the active pane's outputSearch hits
+static bool g_searchRegex = false;      // the query is a regex instead of plain text
+static bool g_searchFilter = false;     // output only shows the lines with hits
 
 // autocomplete - all the windows commands we know about
 static std::vector<std::string> g_commonCommands = {
     // custom terminal commands
-    "cmds", "cls", "quit", "version", "system", "settings", "time", "clear",
+    "cmds", "cls", "quit", "version", "system", "settings", "time", "stats", "snapshot", "perf", "clear",
     
     // a
     "append", "arp", "assoc", "at", "atmadm", "attrib", "auditpol", "autoconv", "autofmt",
@@ -245,9 +301,32 @@ static std::vector<std::string> g_commonCommands = {
     // help
     "help", "/?", "?"
 };
+// what cmd runs itself, plus our own builtins - these never show up on PATH
+static std::vector<std::string> g_shellBuiltins = {
+    "cmds", "cls", "quit", "version", "system", "settings", "time", "stats", "snapshot", "perf", "clear", "help", "exit",
+    "assoc", "break", "call", "cd", "chdir", "color", "copy", "date", "del", "dir", "dpath", "echo",
+    "endlocal", "erase", "for", "ftype", "goto", "if", "keys", "md", "mkdir", "mklink", "move", "path",
+    "pause", "popd", "prompt", "pushd", "rd", "rem", "ren", "rename", "rmdir", "set", "setlocal", "shift",
+    "start", "title", "type", "ver", "verify", "vol"
+};
+static CommandIndex g_commandIndex(g_commonCommands, g_shellBuiltins);
 static std::vector<std::string> g_suggestions;
+static size_t g_suggestionTotal = 0;   // all matches, g_suggestions is just the first few
+static size_t g_historySuggestions = 0; // the first this many of g_suggestions are whole lines from history
+static HistoryIndex g_history;          // every command run, for the ghost text and the dropdown - go through History()
+static HistoryLog g_historyLog;         // the same on disk, shared with the other terminal windows
+static HistorySearch g_historySearch;   // substring index over it for ctrl+r, loads along with g_history
+static bool g_historyLoaded = false;    // g_history gets built from the log the first time it's needed
+static size_t g_historyIngested = 0;    // log records already in g_history
+static int g_commandStatus = 0;         // exit code for the log when a command never reaches the shell
 static int g_selectedSuggestion = -1;
 static bool g_showSuggestions = false;
+static Completer g_completer(g_commandIndex);
+static int g_lastDirScanFrame = 0;     // for the stats command
+static FrameScheduler g_frameScheduler; // frames only get drawn when something changed or is animating
+static ChromeCache g_chromeCache;       // title bar buttons and the caret, tessellated once per look
+static TextGrid g_textGrid;             // draws the output rows, a quad per character
+static std::string g_snapshotPath;      // snapshot asked for, drawn in software once this frame is rendered
 
 // helper function to add output with optional timestamp (adds to active pane)
 void AddOutputLine(const std::string& line)
@@ -259,17 +338,17 @@ void AddOutputLine(const std::string& line)
         GetLocalTime(&st);
         char timestamp[32];
         sprintf_s(timestamp, "[%02d:%02d:%02d] ", st.wHour, st.wMinute, st.wSecond);
-        pane.outputLines.push_back(std::string(timestamp) + line);
+        pane.outputLines.Append(timestamp, line);
     }
     else
     {
-        pane.outputLines.push_back(line);
+        pane.outputLines.Append(line);
     }
 }
 
 // helper function to add output to a specific pane
 // add a line of text to a specific pane's output
-void AddOutputLineToPane(int paneIdx, const std::string& line)
+void AddOutputLineToPane(int paneIdx, std::string_view line)
 {
     if (paneIdx < 0 || paneIdx > 1) return;  // safety check
     TerminalPane& pane = g_panes[paneIdx];
@@ -280,14 +359,26 @@ void AddOutputLineToPane(int paneIdx, const std::string& line)
         GetLocalTime(&st);
         char timestamp[32];
         sprintf_s(timestamp, "[%02d:%02d:%02d] ", st.wHour, st.wMinute, st.wSecond);
-        pane.outputLines.push_back(std::string(timestamp) + line);
+        pane.outputLines.Append(timestamp, line);
     }
     else
     {
-        pane.outputLines.push_back(line);
+        pane.outputLines.Append(line);
     }
 }
 
+// glue all of a pane's output together for the clipboard
+std::string JoinOutput(const TerminalPane& pane)
+{
+    std::string allOutput;
+    for (size_t i = 0; i < pane.outputLines.Size(); i++)
+    {
+        allOutput += pane.outputLines[i];
+        allOutput += "\n";
+    }
+    return allOutput;
+}
+
 // figure out where to save settings on this computer
 std::string GetSettingsPath()
 {
@@ -302,6 +393,81 @@ std::string GetSettingsPath()
     return "settings.cfg";  // fallback to current dir
 }
 
+// the command log lives next to the settings
+std::string GetHistoryPath()
+{
+    std::string path = GetSettingsPath();
+    size_t slash = path.find_last_of('\\');
+    return (slash == std::string::npos ? std::string() : path.substr(0, slash + 1)) + "history.log";
+}
+
+// g_history, loaded from the log on first use - startup only maps the file
+static HistoryIndex& History()
+{
+    if (!g_historyLoaded)
+    {
+        g_historyLoaded = true;
+        size_t count = g_historyLog.Size();
+        std::vector<std::pair<std::string_view, int64_t>> commands;
+        std::vector<std::string_view> texts;
+        commands.reserve(count);
+        texts.reserve(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            HistoryRecord record = g_historyLog.Record(i);
+            commands.emplace_back(record.command, record.when);
+            texts.push_back(record.command);
+        }
+        g_history.AddMany(commands);
+        g_historySearch.AddMany(texts);
+        g_historyIngested = count;
+    }
+    return g_history;
+}
+
+// pick up commands the other terminal windows ran. ours are already in g_history
+static void PollHistoryLog()
+{
+    static ULONGLONG lastPoll = 0;
+    ULONGLONG now = GetTickCount64();
+    if (now - lastPoll < 1000)
+        return;
+    lastPoll = now;
+    if (!g_historyLog.Refresh() || !g_historyLoaded)
+        return;  // not loaded yet means the first History() reads them anyway
+
+    uint32_t pid = HistoryLog::CurrentPid();
+    size_t count = g_historyLog.Size();
+    for (; g_historyIngested < count; g_historyIngested++)
+    {
+        HistoryRecord record = g_historyLog.Record(g_historyIngested);
+        if (record.pid != pid)
+        {
+            g_history.Add(record.command, record.when);
+            g_historySearch.Add(record.command);
+        }
+    }
+}
+
+// the index lives inside the pane's budget, so the scrollback gives up what it
+// uses - never more than half though, the output itself comes first
+static void ApplyScrollbackBudget(TerminalPane& pane)
+{
+    size_t budget = (size_t)g_scrollbackMB * 1024 * 1024;
+    pane.outputLines.SetByteBudget(budget - std::min(pane.outputIndex.MemoryBytes(), budget / 2));
+}
+
+// index whatever came in since last frame, a few MB at most so a flood of
+// output doesn't stall it - ctrl+f scans the part it hasn't caught up on
+static void UpdateOutputIndexes()
+{
+    for (auto& pane : g_panes)
+    {
+        if (pane.outputIndex.Update(pane.outputLines, 4 * 1024 * 1024))
+            ApplyScrollbackBudget(pane);
+    }
+}
+
 // save all the user preferences to a file
 void SaveSettings()
 {
@@ -328,6 +494,9 @@ void SaveSettings()
         file << "font_size=" << g_fontSize << std::endl;
         file << "caret_anim_speed=" << g_caretAnimSpeed << std::endl;
         file << "cursor_trail=" << (g_cursorTrailEnabled ? "1" : "0") << std::endl;
+        file << "scrollback_mb=" << g_scrollbackMB << std::endl;
+        file << "index_pane0=" << (g_panes[0].outputIndex.Enabled() ? "1" : "0") << std::endl;
+        file << "index_pane1=" << (g_panes[1].outputIndex.Enabled() ? "1" : "0") << std::endl;
         file.close();
     }
 }
@@ -367,6 +536,21 @@ void LoadSettings()
                 else if (key == "font_size") g_fontSize = std::stof(value);
                 else if (key == "caret_anim_speed") g_caretAnimSpeed = std::stof(value);
                 else if (key == "cursor_trail") g_cursorTrailEnabled = (value == "1");
+                else if (key == "scrollback_mb")
+                {
+                    // same rule as settings scrollback, a bad value keeps the default
+                    try
+                    {
+                        int mb = std::stoi(value);
+                        if (mb > 0)
+                            g_scrollbackMB = mb;
+                    }
+                    catch (const std::exception&)
+                    {
+                    }
+                }
+                else if (key == "index_pane0") g_panes[0].outputIndex.SetEnabled(value == "1");
+                else if (key == "index_pane1") g_panes[1].outputIndex.SetEnabled(value == "1");
             }
         }
         file.close();
@@ -404,6 +588,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
 
     // show the window
     ::ShowWindow(hwnd, SW_SHOWDEFAULT);
+
+    // output and background results arrive on other threads, they poke the
+    // main loop awake with an empty message
+    g_frameScheduler.SetWakeHook([hwnd] { ::PostMessageW(hwnd, WM_NULL, 0, 0); });
+    CommandJob::SetNotify([] { g_frameScheduler.Signal(); });
+    WorkerPool::Shared().SetOnJobDone([] { g_frameScheduler.Signal(); });
     ::UpdateWindow(hwnd);
 
     // apply that nice blur effect to the window background
@@ -445,12 +635,39 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
     // apply font size from settings
     ImGui::GetIO().FontGlobalScale = g_fontSize / 16.0f;
 
+    // apply scrollback budget from settings
+    for (auto& pane : g_panes)
+        ApplyScrollbackBudget(pane);
+
+    // panes start where we were launched, with our environment
+    char startDir[MAX_PATH];
+    GetCurrentDirectoryA(MAX_PATH, startDir);
+    Environment startEnv = Environment::FromProcess();
+    for (auto& pane : g_panes)
+    {
+        pane.currentDir = startDir;
+        pane.env = startEnv;
+    }
+
+    // ctrl+z picks up where the last session left off
+    g_historyLog.Open(GetHistoryPath());
+    std::vector<HistoryRecord> recent = g_historyLog.Tail(g_maxHistorySize);
+    for (auto& pane : g_panes)
+    {
+        pane.commandHistory.reserve(g_maxHistorySize);
+        for (const HistoryRecord& record : recent)
+        {
+            if (pane.commandHistory.empty() || pane.commandHistory.back() != record.command)
+                pane.commandHistory.push_back_overwrite(std::string(record.command));
+        }
+    }
+
     // show the welcome message in the first pane
-    g_panes[0].outputLines.push_back("Linux Terminal v2.0 - by @ducky6163");
-    g_panes[0].outputLines.push_back("Type '$help' for custom commands, 'help' for Windows commands");
-    g_panes[0].outputLines.push_back("Type 'settings' to configure terminal options");
-    g_panes[0].outputLines.push_back("Click the + button to open another terminal window");
-    g_panes[0].outputLines.push_back("");
+    g_panes[0].outputLines.Append("Linux Terminal v2.0 - by @ducky6163");
+    g_panes[0].outputLines.Append("Type '$help' for custom commands, 'help' for Windows commands");
+    g_panes[0].outputLines.Append("Type 'settings' to configure terminal options");
+    g_panes[0].outputLines.Append("Click the + button to open another terminal window");
+    g_panes[0].outputLines.Append("");
     
     // pane 0 is active by default
     g_panes[0].isActive = true;
@@ -460,7 +677,19 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
     bool done = false;
     while (!done)
     {
+        // sleep until there's input, a worker signals, or an animation wants its
+        // next frame - but wake up at least once a second for the history log
+        FrameScheduler::Clock::time_point waitStart = FrameScheduler::Clock::now();
+        FrameScheduler::Clock::duration wait = g_frameScheduler.TimeToNextFrame(waitStart);
+        if (wait > FrameScheduler::Clock::duration::zero())
+        {
+            long long waitMs = std::chrono::ceil<std::chrono::milliseconds>(std::min<FrameScheduler::Clock::duration>(wait, std::chrono::seconds(1))).count();
+            ::MsgWaitForMultipleObjectsEx(0, nullptr, (DWORD)waitMs, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+            g_frameScheduler.Waited(FrameScheduler::Clock::now() - waitStart);
+        }
+
         // handle windows messages
+        FrameProfiler::Scope pumpScope(FrameProfiler::Stage::kPump);
         MSG msg;
         while (::PeekMessage(&msg, nullptr, 0U, 0U, PM_REMOVE))
         {
@@ -468,14 +697,34 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
             ::DispatchMessage(&msg);
             if (msg.message == WM_QUIT)
                 done = true;
+            // WM_NULL is just a worker waking us, it already asked for its frame
+            if (msg.message != WM_NULL)
+                g_frameScheduler.Invalidate(2);
         }
         if (done)
             break;
 
+        // pull in whatever the running commands printed since last frame
+        PumpCommandJobs();
+        PollHistoryLog();
+        UpdateOutputIndexes();
+        pumpScope.End();
+
+        if (!g_frameScheduler.BeginFrame(FrameScheduler::Clock::now()))
+            continue;
+        // lasts until the frame is presented
+        FrameProfiler::Scope frameScope(FrameProfiler::Stage::kFrame);
+        if (FrameProfiler::Enabled())
+            FrameProfiler::Shared().Collect();
+
         // start a new imgui frame
         ImGui_ImplDX11_NewFrame();
         ImGui_ImplWin32_NewFrame();
+        // after a long sleep the first frame would see one huge step and the
+        // lerps below would overshoot
+        io.DeltaTime = std::min(io.DeltaTime, 0.05f);
         ImGui::NewFrame();
+        g_chromeCache.NewFrame();
 
         // create fullscreen window that covers everything
         ImGui::SetNextWindowPos(ImVec2(0, 0));
@@ -559,42 +808,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
             float target_hover = is_hovering ? 1.0f : 0.0f;
             hover_states[button_idx] += (target_hover - hover_states[button_idx]) * 12.0f * io.DeltaTime;
             float hover_t = hover_states[button_idx];
+            if (std::abs(target_hover - hover_t) > 0.002f)
+                g_frameScheduler.RequestFrameIn(0.0);
 
-            // blend between normal and hover colors
-            int base_r = (base_color >> 0) & 0xFF;
-            int base_g = (base_color >> 8) & 0xFF;
-            int base_b = (base_color >> 16) & 0xFF;
-            int hover_r = (hover_color >> 0) & 0xFF;
-            int hover_g = (hover_color >> 8) & 0xFF;
-            int hover_b = (hover_color >> 16) & 0xFF;
-            
-            int r = base_r + (int)((hover_r - base_r) * hover_t);
-            int g = base_g + (int)((hover_g - base_g) * hover_t);
-            int b = base_b + (int)((hover_b - base_b) * hover_t);
-
-            // draw that nice glow effect around the button
-            const float base_glow_radius = 6.0f;
-            const float hover_glow_radius = 16.0f;
-            float glow_radius = base_glow_radius + (hover_glow_radius - base_glow_radius) * hover_t;
-            
-            // multiple layers for the glow - makes it look soft
-            const int glow_layers = 8;
-            for (int i = glow_layers; i >= 0; i--) {
-                float t = (float)i / glow_layers;
-                float radius = 8 + t * glow_radius;
-                
-                // fade out as we go further from the center
-                float alpha_f = expf(-t * t * 3.0f) * (0.06f + 0.22f * hover_t);
-                int alpha = (int)(alpha_f * 255.0f);
-                if (alpha < 2) continue;
-                
-                draw_list->AddCircleFilled(center, radius, IM_COL32(r, g, b, alpha), 64);
-            }
-
-            // draw the actual button circle
-            draw_list->AddCircleFilled(center, 8, IM_COL32(r, g, b, 255), 64);
-            // add a little shine effect inside
-            draw_list->AddCircleFilled(ImVec2(center.x - 2, center.y - 2), 3, IM_COL32(255, 255, 255, 50 + (int)(40 * hover_t)), 32);
+            // glow and all, out of the chrome cache once it's been drawn at this hover
+            ::DrawGlowButton(draw_list, &g_chromeCache, center, base_color, hover_color, hover_t);
             };
 
         // new window button - opens another terminal
@@ -690,72 +908,127 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
         
                 // search bar - searches in active pane
         TerminalPane& activePane = g_panes[g_activePane];
+        if (ImGui::IsKeyDown(ImGuiKey_LeftCtrl) && ImGui::IsKeyPressed(ImGuiKey_F))
+        {
+            g_showSearch = !g_showSearch;
+            g_focusSearch = g_showSearch;
+        }
         if (g_showSearch)
         {
             ImGui::PushStyleColor(ImGuiCol_FrameBg, ImVec4(0.15f, 0.16f, 0.18f, 1.0f));
-            ImGui::SetNextItemWidth(window_size.x - 180);
-            if (ImGui::InputText("##search", g_searchBuffer, sizeof(g_searchBuffer), ImGuiInputTextFlags_EnterReturnsTrue))
+            ImGui::SetNextItemWidth(window_size.x - 270);
+            if (g_focusSearch)
             {
-                // search for matches in active pane
-                g_searchResults.clear();
-                std::string searchStr = g_searchBuffer;
-                std::transform(searchStr.begin(), searchStr.end(), searchStr.begin(), ::tolower);
-                
-                for (int i = 0; i < (int)activePane.outputLines.size(); i++)
-                {
-                    std::string lineLower = activePane.outputLines[i];
-                    std::transform(lineLower.begin(), lineLower.end(), lineLower.begin(), ::tolower);
-                    if (lineLower.find(searchStr) != std::string::npos)
-                    {
-                        g_searchResults.push_back(i);
-                    }
-                }
-                
-                if (!g_searchResults.empty())
-                {
+                ImGui::SetKeyboardFocusHere();
+                g_focusSearch = false;
+            }
+            bool enterPressed = ImGui::InputText("##search", g_searchBuffer, sizeof(g_searchBuffer), ImGuiInputTextFlags_EnterReturnsTrue);
+            
+            // search as you type - the hits follow the query and new output every frame
+            // (no copies, and a longer query only re-checks the lines that matched).
+            // a big scrollback is searched on the workers, hits stream in as chunks finish
+            OutputSearch& search = activePane.outputSearch;
+            if (search.Update(activePane.outputLines, g_searchBuffer, &activePane.outputIndex, g_searchRegex))
+            {
+                if (search.HitCount() == 0)
+                    g_currentSearchResult = -1;
+                else if (g_currentSearchResult < 0 || g_currentSearchResult >= (int)search.HitCount())
                     g_currentSearchResult = 0;
-                    // scroll to first result
-                    ImGui::SetScrollY(g_searchResults[0] * ImGui::GetTextLineHeight());
+            }
+            int hitCount = (int)search.HitCount();
+            // the output view does the scrolling, it's the one that knows where
+            // the hit's row is once everything above it has been wrapped
+            auto scrollToResult = [&]() {
+                const OutputSearch::Hit& hit = search.HitAt(g_currentSearchResult);
+                activePane.jumpPending = true;
+                activePane.jumpLineId = hit.lineId;
+                activePane.jumpOffset = hit.offset;
+            };
+            if (enterPressed)
+            {
+                // enter goes to the next one, shift+enter back, and the box keeps the caret
+                if (hitCount > 0)
+                {
+                    g_currentSearchResult = (g_currentSearchResult + (io.KeyShift ? hitCount - 1 : 1)) % hitCount;
+                    scrollToResult();
                 }
+                g_focusSearch = true;
             }
             ImGui::PopStyleColor();
             ImGui::SameLine();
             
             if (ImGui::Button("Prev", ImVec2(50, 0)))
             {
-                if (!g_searchResults.empty() && g_currentSearchResult > 0)
+                if (hitCount > 0 && g_currentSearchResult > 0)
                 {
                     g_currentSearchResult--;
-                    ImGui::SetScrollY(g_searchResults[g_currentSearchResult] * ImGui::GetTextLineHeight());
+                    scrollToResult();
                 }
             }
             ImGui::SameLine();
             
             if (ImGui::Button("Next", ImVec2(50, 0)))
             {
-                if (!g_searchResults.empty() && g_currentSearchResult < (int)g_searchResults.size() - 1)
+                if (hitCount > 0 && g_currentSearchResult < hitCount - 1)
                 {
                     g_currentSearchResult++;
-                    ImGui::SetScrollY(g_searchResults[g_currentSearchResult] * ImGui::GetTextLineHeight());
+                    scrollToResult();
                 }
             }
             ImGui::SameLine();
             
+            // toggles light up while they're on
+            auto toggleButton = [](const char* label, bool& on, float width) {
+                if (on)
+                    ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.25f, 0.45f, 0.30f, 1.0f));
+                bool pressed = ImGui::Button(label, ImVec2(width, 0));
+                if (on)
+                    ImGui::PopStyleColor();
+                if (pressed)
+                {
+                    on = !on;
+                    g_focusSearch = true;
+                }
+            };
+            toggleButton(".*", g_searchRegex, 30);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Regex");
+            ImGui::SameLine();
+            toggleButton("Filter", g_searchFilter, 50);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Only show lines that match");
+            ImGui::SameLine();
+            
             if (ImGui::Button("X", ImVec2(30, 0)))
             {
                 g_showSearch = false;
-                g_searchBuffer[0] = '\0';
-                g_searchResults.clear();
             }
             
-            if (!g_searchResults.empty())
+            if (!search.Error().empty())
             {
                 ImGui::SameLine();
-                ImGui::Text("%d/%d", g_currentSearchResult + 1, (int)g_searchResults.size());
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", search.Error().c_str());
+            }
+            else if (search.Searching())
+            {
+                ImGui::SameLine();
+                ImGui::Text("%d/%d  %d%%", g_currentSearchResult + 1, hitCount, (int)(search.Progress() * 100.0f));
+            }
+            else if (hitCount > 0)
+            {
+                ImGui::SameLine();
+                ImGui::Text("%d/%d", g_currentSearchResult + 1, hitCount);
             }
             
             ImGui::Spacing();
         }
+        if (!g_showSearch && g_searchBuffer[0] != '\0')
+        {
+            // closed - drop the hits so nothing stays highlighted
+            g_searchBuffer[0] = '\0';
+            activePane.outputSearch.Update(activePane.outputLines, g_searchBuffer);
+            g_currentSearchResult = -1;
+        }
         
         float contentHeight = g_showSearch ? window_size.y - 105 : window_size.y - 65;
         float paneWidth = window_size.x - 30;
@@ -769,6 +1042,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
         // clean Settings Modal - No blur, solid colors
         if (g_showSettingsWindow)
         {
+            FrameProfiler::Scope settingsScope(FrameProfiler::Stage::kSettings);
+
             // initialize temp settings on first open
             static bool settingsInitialized = false;
             if (!settingsInitialized)
@@ -783,6 +1058,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
                 settingsInitialized = true;
             }
             
+            // the toggles and the typing preview never really stop, keep
+            // drawing for as long as the window's open
+            g_frameScheduler.RequestFrameIn(0.0);
+
             // update animations based on temp settings
             float dt = io.DeltaTime;
             float speed = 12.0f;
@@ -1164,13 +1443,44 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
             ImGui::PopStyleVar();
         }
 
+        if (g_showPerfOverlay)
+            RenderPerfOverlay(io);
+
         // rendering
+        FrameProfiler::Scope renderScope(FrameProfiler::Stage::kRender);
         ImGui::Render();
+        renderScope.End();
+        if (!g_snapshotPath.empty())
+        {
+            // the frame that's about to go to the gpu, drawn again on the cpu
+            ImDrawData* drawData = ImGui::GetDrawData();
+            SoftRenderer renderer;
+            renderer.Resize((int)drawData->DisplaySize.x, (int)drawData->DisplaySize.y);
+            renderer.Clear(IM_COL32(0, 0, 0, 255));
+            auto start = std::chrono::steady_clock::now();
+            renderer.RenderDrawData(drawData);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (renderer.SaveBmp(g_snapshotPath))
+            {
+                char line[160];
+                sprintf_s(line, "%dx%d, %d vertices drawn in %.2f ms, hash %016llx", renderer.Width(), renderer.Height(),
+                    drawData->TotalVtxCount, ms, (unsigned long long)renderer.Hash());
+                AddOutputLine("Snapshot saved to " + g_snapshotPath);
+                AddOutputLine(line);
+            }
+            else
+                AddOutputLine("Error: Couldn't write " + g_snapshotPath);
+            g_snapshotPath.clear();
+            g_frameScheduler.Invalidate();
+        }
+        FrameProfiler::Scope drawScope(FrameProfiler::Stage::kDraw);
         const float clear_color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
         g_pd3dDeviceContext->OMSetRenderTargets(1, &g_mainRenderTargetView, nullptr);
         g_pd3dDeviceContext->ClearRenderTargetView(g_mainRenderTargetView, clear_color);
         ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+        drawScope.End();
 
+        FrameProfiler::Scope presentScope(FrameProfiler::Stage::kPresent);
         g_pSwapChain->Present(1, 0);
     }
 
@@ -1186,6 +1496,133 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
     return 0;
 }
 
+// put suggestion idx into the input - history ones replace the whole line,
+// the rest replace the word under the caret
+static void AcceptSuggestion(TerminalPane& pane, int idx)
+{
+    const std::string& suggestion = g_suggestions[idx];
+    int wordStart = 0;
+    std::string newText;
+    if (idx < (int)g_historySuggestions)
+    {
+        newText = suggestion;
+    }
+    else
+    {
+        wordStart = pane.caretPos;
+        while (wordStart > 0 && pane.inputBuffer[wordStart - 1] != ' ')
+            wordStart--;
+        newText = std::string(pane.inputBuffer, wordStart) + suggestion;
+        if (pane.caretPos < (int)strlen(pane.inputBuffer))
+            newText += std::string(pane.inputBuffer + pane.caretPos);
+    }
+
+    strncpy_s(pane.inputBuffer, newText.c_str(), sizeof(pane.inputBuffer) - 1);
+    pane.caretPos = std::min(wordStart + (int)suggestion.length(), (int)strlen(pane.inputBuffer));
+    pane.caretTime = 0.0f;
+    g_showSuggestions = false;
+}
+
+// look for the query from `from` down and put what it finds on the input line.
+// once a query has failed, typing more of it can't make it match
+static void StepHistorySearch(TerminalPane& pane, int64_t from)
+{
+    TerminalPane::SearchStep step = pane.searchSteps.back();
+    step.queryLength = pane.searchQuery.size();
+    int64_t match = step.failed ? -1 : g_historySearch.Find(pane.searchQuery, from);
+    step.failed = match < 0;
+    if (match >= 0)
+    {
+        step.match = match;
+        std::string_view text = g_historySearch.Text(match);
+        strncpy_s(pane.inputBuffer, std::string(text).c_str(), sizeof(pane.inputBuffer) - 1);
+        pane.caretPos = std::min((int)g_historySearch.MatchOffset(match, pane.searchQuery), (int)strlen(pane.inputBuffer));
+    }
+    pane.searchSteps.push_back(step);
+    pane.caretTime = 0.0f;
+}
+
+static void EndHistorySearch(TerminalPane& pane)
+{
+    pane.searching = false;
+    pane.searchSteps.clear();
+    g_historySearch.Compact();  // ids move, nothing's holding one now
+}
+
+// ctrl+r reverse search, bash style. returns true if it used this frame's keys
+static bool HandleHistorySearch(TerminalPane& pane, ImGuiIO& io)
+{
+    bool ctrl = ImGui::IsKeyDown(ImGuiKey_LeftCtrl) || ImGui::IsKeyDown(ImGuiKey_RightCtrl);
+    bool ctrlR = ctrl && ImGui::IsKeyPressed(ImGuiKey_R);
+    if (!pane.searching)
+    {
+        if (!ctrlR)
+            return false;
+        History();  // loads the search index too
+        pane.searching = true;
+        pane.searchQuery.clear();
+        pane.searchSaved = pane.inputBuffer;
+        pane.searchSteps.assign(1, { 0, -1, false });
+        g_showSuggestions = false;
+        return true;
+    }
+
+    TerminalPane::SearchStep current = pane.searchSteps.back();
+    if (ctrlR)
+    {
+        // again for the next older one
+        StepHistorySearch(pane, current.match >= 0 ? current.match - 1 : g_historySearch.Newest());
+        return true;
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_Escape) || (ctrl && ImGui::IsKeyPressed(ImGuiKey_G)))
+    {
+        strncpy_s(pane.inputBuffer, pane.searchSaved.c_str(), sizeof(pane.inputBuffer) - 1);
+        pane.caretPos = strlen(pane.inputBuffer);
+        EndHistorySearch(pane);
+        return true;
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_Backspace))
+    {
+        if (pane.searchSteps.size() > 1)
+        {
+            pane.searchSteps.pop_back();
+            const TerminalPane::SearchStep& back = pane.searchSteps.back();
+            pane.searchQuery.resize(back.queryLength);
+            std::string_view text = back.match >= 0 ? g_historySearch.Text(back.match) : std::string_view(pane.searchSaved);
+            strncpy_s(pane.inputBuffer, std::string(text).c_str(), sizeof(pane.inputBuffer) - 1);
+            pane.caretPos = std::min((int)(back.match >= 0 ? g_historySearch.MatchOffset(back.match, pane.searchQuery) : text.size()), (int)strlen(pane.inputBuffer));
+        }
+        return true;
+    }
+    // moving around keeps the match to edit and then does what it normally does
+    if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow) || ImGui::IsKeyPressed(ImGuiKey_RightArrow) || ImGui::IsKeyPressed(ImGuiKey_Home) ||
+        ImGui::IsKeyPressed(ImGuiKey_End) || ImGui::IsKeyPressed(ImGuiKey_Tab))
+    {
+        EndHistorySearch(pane);
+        return false;
+    }
+
+    for (int i = 0; i < io.InputQueueCharacters.Size; i++)
+    {
+        ImWchar c = io.InputQueueCharacters[i];
+        if (c == '\r' || c == '\n')
+        {
+            // enter runs the match - hand the rest of the queue to the normal input handling
+            io.InputQueueCharacters.erase(io.InputQueueCharacters.begin(), io.InputQueueCharacters.begin() + i);
+            EndHistorySearch(pane);
+            return false;
+        }
+        if (c >= 32 && c < 128)
+        {
+            pane.searchQuery += (char)c;
+            const TerminalPane::SearchStep& back = pane.searchSteps.back();
+            // the current match is the newest one the longer query could still be in
+            StepHistorySearch(pane, back.match >= 0 ? back.match : g_historySearch.Newest());
+        }
+    }
+    return true;
+}
+
 // render a single terminal pane
 void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
 {
@@ -1220,51 +1657,183 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
     ImGui::BeginChild(outputId.c_str(), ImVec2(0, outputHeight), false);
     ImGui::PushStyleColor(ImGuiCol_Text, g_textColor);
     
-    for (const auto& line : pane.outputLines)
+    // only lay out the rows that are on screen - the row index maps the
+    // clipper's visible row range back to output lines
+    std::string lineCtxId = "LineContext" + std::to_string(paneIdx);
+    std::string outputCtxId = "OutputContext" + std::to_string(paneIdx);
+    pane.outputLayout.Sync(pane.outputLines, ImGui::GetFont(), ImGui::GetFontSize(), ImGui::GetContentRegionAvail().x);
+    
+    // after a resize/font change the rest gets re-wrapped in the background,
+    // but whatever is on screen has to be exact this frame
+    float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    bool stuckToBottom = ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
+    bool filtering = g_showSearch && g_searchFilter && isActive && !pane.outputSearch.Query().empty();
+    if (!filtering)
     {
-        ImGui::TextWrapped("%s", line.c_str());
-        
-        // right-click context menu
-        if (ImGui::BeginPopupContextItem(("line_ctx_" + std::to_string(paneIdx) + "_" + std::to_string(reinterpret_cast<uintptr_t>(&line))).c_str()))
+        pane.outputLayout.EnsureVisible(pane.outputLines, ImGui::GetScrollY(), ImGui::GetWindowHeight(), rowHeight, stuckToBottom);
+        int64_t scrollShift = pane.outputLayout.TakeScrollShift();
+        if (scrollShift != 0 && !stuckToBottom)
+            ImGui::SetScrollY(ImGui::GetScrollY() + scrollShift * rowHeight);
+    }
+    bool lineRightClicked = false;
+    
+    // jump to a search hit - its row comes out of the row index, so wrapped
+    // lines above it are accounted for however much scrollback there is
+    bool jumped = false;
+    if (pane.jumpPending)
+    {
+        pane.jumpPending = false;
+        if (pane.jumpLineId >= pane.outputLines.FirstLineId() && pane.jumpLineId < pane.outputLines.EndLineId())
         {
-            if (ImGui::MenuItem("Copy Line"))
+            uint64_t row;
+            if (filtering)
             {
-                ImGui::SetClipboardText(line.c_str());
+                // filtered, only lines with hits are rows
+                const std::vector<uint64_t>& hitLines = pane.outputSearch.HitLines();
+                row = std::lower_bound(hitLines.begin(), hitLines.end(), pane.jumpLineId) - hitLines.begin();
             }
-            if (ImGui::MenuItem("Copy All Output"))
+            else
             {
-                std::string allOutput;
-                for (const auto& l : pane.outputLines)
-                {
-                    allOutput += l + "\n";
-                }
-                ImGui::SetClipboardText(allOutput.c_str());
+                row = pane.outputLayout.RowOfOffset(pane.outputLines, (size_t)(pane.jumpLineId - pane.outputLines.FirstLineId()), pane.jumpOffset);
+                // wrapping it may have shifted rows, but the scroll is set outright here
+                pane.outputLayout.TakeScrollShift();
+            }
+            // middle of the view. imgui keeps the scroll as a float, so past 2^24
+            // pixels (around a million rows) it lands a few pixels off - the row
+            // still ends up near the middle, just not exactly
+            double target = (double)row * rowHeight - (ImGui::GetWindowHeight() - rowHeight) * 0.5;
+            ImGui::SetScrollY((float)std::max(0.0, target));
+            jumped = true;
+        }
+    }
+    
+    // rows go through the text grid instead of TextUnformatted - no text
+    // measuring, the item is just a dummy the width of the view for the
+    // clipper and the context menu. search hits are background runs, the
+    // current one brighter. rows without any come out of the pane's row cache
+    FrameProfiler::Scope outputScope(FrameProfiler::Stage::kOutput);
+    g_textGrid.Begin(ImGui::GetWindowDrawList(), ImGui::GetFont(), ImGui::GetFontSize());
+    ImU32 textColor = ImGui::GetColorU32(ImGuiCol_Text);
+    pane.rowCache.Begin(&g_textGrid, textColor);
+    float rowWidth = ImGui::GetContentRegionAvail().x;
+    static std::vector<CellRun> hitRuns;
+    auto drawRow = [&](uint64_t lineId, std::string_view lineText, const char* begin, const char* end, std::pair<size_t, size_t> hits) {
+        hitRuns.clear();
+        size_t rowStart = begin - lineText.data();
+        size_t rowEnd = end - lineText.data();
+        for (size_t h = hits.first; h < hits.second; h++)
+        {
+            const OutputSearch::Hit& hit = pane.outputSearch.HitAt(h);
+            size_t from = std::max<size_t>(hit.offset, rowStart);
+            size_t to = std::min<size_t>(hit.offset + hit.length, rowEnd);
+            if (from >= to)
+                continue;
+            ImU32 color = (int)h == g_currentSearchResult ? IM_COL32(255, 150, 40, 170) : IM_COL32(230, 200, 60, 90);
+            hitRuns.push_back(CellRun{ (uint32_t)(from - rowStart), (uint32_t)(to - rowStart), 0, color });
+        }
+        std::string_view rowText(begin, end - begin);
+        if (hitRuns.empty())
+            pane.rowCache.DrawRow(ImGui::GetCursorScreenPos(), lineId, (uint32_t)rowStart, rowText);
+        else
+            g_textGrid.DrawRow(ImGui::GetCursorScreenPos(), rowText, textColor, hitRuns.data(), hitRuns.size());
+        ImGui::Dummy(ImVec2(rowWidth, ImGui::GetTextLineHeight()));
+    };
+    auto lineContextMenu = [&](uint64_t lineId) {
+        if (ImGui::IsItemHovered() && ImGui::IsMouseReleased(ImGuiMouseButton_Right))
+        {
+            pane.contextLineId = lineId;
+            lineRightClicked = true;
+            ImGui::OpenPopup(lineCtxId.c_str());
+        }
+    };
+    
+    ImGuiListClipper clipper;
+    if (filtering)
+    {
+        // grep view - a row per line with a hit on it, long ones run off the edge
+        const std::vector<uint64_t>& hitLines = pane.outputSearch.HitLines();
+        clipper.Begin((int)hitLines.size(), rowHeight);
+        while (clipper.Step())
+        {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+            {
+                uint64_t lineId = hitLines[row];
+                std::string_view lineText = pane.outputLines[(size_t)(lineId - pane.outputLines.FirstLineId())];
+                drawRow(lineId, lineText, lineText.data(), lineText.data() + lineText.size(), pane.outputSearch.HitsOn(lineId));
+                lineContextMenu(lineId);
             }
-            ImGui::EndPopup();
         }
     }
+    else
+    {
+        clipper.Begin((int)pane.outputLayout.TotalRows(), rowHeight);
+        while (clipper.Step())
+        {
+            size_t lineIdx = pane.outputLayout.LineAtRow(clipper.DisplayStart);
+            int row = (int)pane.outputLayout.RowOf(lineIdx);
+            while (row < clipper.DisplayEnd && lineIdx < pane.outputLines.Size())
+            {
+                std::string_view lineText = pane.outputLines[lineIdx];
+                std::pair<size_t, size_t> hits(0, 0);
+                if (g_showSearch && isActive)
+                    hits = pane.outputSearch.HitsOn(pane.outputLines.FirstLineId() + lineIdx);
+                pane.outputLayout.ForEachRow(lineIdx, lineText, [&](const char* begin, const char* end) {
+                    // rows of this line that are above the visible range
+                    if (row++ < clipper.DisplayStart || row > clipper.DisplayEnd)
+                        return;
+                    drawRow(pane.outputLines.FirstLineId() + lineIdx, lineText, begin, end, hits);
+                    lineContextMenu(pane.outputLines.FirstLineId() + lineIdx);
+                });
+                lineIdx++;
+            }
+        }
+    }
+    outputScope.End();
     ImGui::PopStyleColor();
     
+    if (ImGui::BeginPopup(lineCtxId.c_str()))
+    {
+        // the line might have scrolled out of the budget while the menu was open
+        bool lineAlive = pane.contextLineId >= pane.outputLines.FirstLineId() && pane.contextLineId < pane.outputLines.EndLineId();
+        if (ImGui::MenuItem("Copy Line", nullptr, false, lineAlive))
+        {
+            std::string line(pane.outputLines[(size_t)(pane.contextLineId - pane.outputLines.FirstLineId())]);
+            ImGui::SetClipboardText(line.c_str());
+        }
+        if (ImGui::MenuItem("Copy All Output"))
+        {
+            ImGui::SetClipboardText(JoinOutput(pane).c_str());
+        }
+        ImGui::EndPopup();
+    }
+    
     // context menu for empty space
-    if (ImGui::BeginPopupContextWindow(("OutputContext" + std::to_string(paneIdx)).c_str()))
+    if (!lineRightClicked && ImGui::IsWindowHovered() && ImGui::IsMouseReleased(ImGuiMouseButton_Right))
+        ImGui::OpenPopup(outputCtxId.c_str());
+    if (ImGui::BeginPopup(outputCtxId.c_str()))
     {
         if (ImGui::MenuItem("Copy All Output"))
         {
-            std::string allOutput;
-            for (const auto& l : pane.outputLines)
-            {
-                allOutput += l + "\n";
-            }
-            ImGui::SetClipboardText(allOutput.c_str());
+            ImGui::SetClipboardText(JoinOutput(pane).c_str());
         }
         if (ImGui::MenuItem("Clear Output"))
         {
-            pane.outputLines.clear();
+            pane.outputLines.Clear();
         }
         ImGui::EndPopup();
     }
     
-    if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
+    if (pane.outputLayout.Reflowing())
+    {
+        // small hint in the corner while the background re-wrap is still going
+        ImVec2 pos = ImGui::GetWindowPos();
+        ImVec2 size = ImGui::GetWindowSize();
+        const char* hint = "reflowing...";
+        ImVec2 hintSize = ImGui::CalcTextSize(hint);
+        ImGui::GetWindowDrawList()->AddText(ImVec2(pos.x + size.x - hintSize.x - 8, pos.y + 4), IM_COL32(160, 160, 160, 200), hint);
+    }
+    
+    if (!jumped && ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
         ImGui::SetScrollHereY(1.0f);
     ImGui::EndChild();
     
@@ -1277,7 +1846,10 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
     GetComputerNameA(computerName, &computerNameLen);
     
     ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.4f, 1.0f, 0.6f, 1.0f));
-    ImGui::Text("%s@%s:~$ ", username, computerName);
+    if (pane.searching)
+        ImGui::Text("(%sreverse-i-search)'%s': ", pane.searchSteps.back().failed ? "failed " : "", pane.searchQuery.c_str());
+    else
+        ImGui::Text("%s@%s:~$ ", username, computerName);
     ImGui::PopStyleColor();
     ImGui::SameLine();
     
@@ -1308,9 +1880,45 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
         display_text.c_str()
     );
     
+    // ghost text - the rest of the best history match, Right at the end of the line takes it
+    std::string_view ghost = g_history.Ghost();
+    if (isActive && !pane.searching && !ghost.empty() && pane.caretPos == (int)display_text.size())
+    {
+        float ghost_x = input_pos.x + ImGui::CalcTextSize(display_text.c_str()).x;
+        ImGui::GetWindowDrawList()->AddText(
+            ImVec2(ghost_x, input_pos.y),
+            IM_COL32(130, 130, 130, 160),
+            ghost.data(), ghost.data() + ghost.size()
+        );
+    }
+    
+    // running command indicator on the right of the input line
+    if (pane.job)
+    {
+        static const char spinner[] = "|/-\\";
+        double seconds = pane.job->Seconds();
+        char status[128];
+        sprintf_s(status, "%c running %.1fs (Ctrl+C to stop)", spinner[(int)(seconds * 8) % 4], seconds);
+        ImVec2 statusSize = ImGui::CalcTextSize(status);
+        ImGui::GetWindowDrawList()->AddText(
+            ImVec2(input_pos.x + input_size.x - statusSize.x - 8, input_pos.y),
+            IM_COL32(160, 160, 160, 200),
+            status
+        );
+        // the spinner moves every 1/8s whether or not output comes in, and the caret pulse may be resting
+        g_frameScheduler.RequestFrameIn(0.125);
+    }
+    
+    // ctrl+r search gets the keys first while it's on
+    bool searchTookKeys = item_focused && isActive && HandleHistorySearch(pane, io);
+    
     // handle keyboard input for this pane
-    if (item_focused && isActive)
+    if (item_focused && isActive && !searchTookKeys)
     {
+        // ctrl+c stops whatever's running in this pane
+        if (pane.job && ImGui::IsKeyDown(ImGuiKey_LeftCtrl) && ImGui::IsKeyPressed(ImGuiKey_C))
+            pane.shell.Cancel();
+        
         // handle text input
         if (io.InputQueueCharacters.Size > 0)
         {
@@ -1338,19 +1946,25 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
                             sprintf_s(timestamp, "[%02d:%02d:%02d] ", st.wHour, st.wMinute, st.wSecond);
                             fullLine = std::string(timestamp) + fullLine;
                         }
-                        pane.outputLines.push_back(fullLine);
+                        pane.outputLines.Append(fullLine);
                         
+                        int64_t started = (int64_t)time(nullptr);
+                        std::string startDir = pane.currentDir;
+                        std::shared_ptr<CommandJob> prevJob = pane.job;
+                        g_commandStatus = 0;
+                        
                         int prevActive = g_activePane;
                         g_activePane = paneIdx;
                         ProcessCommand(cmd);
                         g_activePane = prevActive;
                         
+                        // shell commands get logged when they finish, with their exit code
+                        if (!pane.job || pane.job == prevJob)
+                            g_historyLog.Append(cmd, started, startDir, g_commandStatus, 0);
+                        History().Add(cmd, started);
+                        g_historySearch.Add(cmd);
                         if (pane.commandHistory.empty() || pane.commandHistory.back() != cmd)
-                        {
-                            pane.commandHistory.push_back(cmd);
-                            if (pane.commandHistory.size() > g_maxHistorySize)
-                                pane.commandHistory.erase(pane.commandHistory.begin());
-                        }
+                            pane.commandHistory.push_back_overwrite(cmd);
                         pane.historyIndex = -1;
                         
                         pane.inputBuffer[0] = '\0';
@@ -1404,6 +2018,19 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
                 pane.caretPos++;
                 pane.caretTime = 0.0f;
             }
+            else
+            {
+                // at the end of the line it takes the ghost text
+                // (refreshed first, anything typed this frame isn't in it yet)
+                History().Update(pane.inputBuffer, (int64_t)time(nullptr));
+                if (!g_history.Ghost().empty())
+                {
+                    std::string line = std::string(pane.inputBuffer) + std::string(g_history.Ghost());
+                    strncpy_s(pane.inputBuffer, line.c_str(), sizeof(pane.inputBuffer) - 1);
+                    pane.caretPos = strlen(pane.inputBuffer);
+                    pane.caretTime = 0.0f;
+                }
+            }
         }
         
         // handle command history with ctrl+z (back) and ctrl+x (forward)
@@ -1452,22 +2079,8 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
         // autocomplete with tab
         if (ImGui::IsKeyPressed(ImGuiKey_Tab) && g_showSuggestions && !g_suggestions.empty())
         {
-            std::string suggestion = (g_selectedSuggestion >= 0 && g_selectedSuggestion < (int)g_suggestions.size()) 
-                ? g_suggestions[g_selectedSuggestion] 
-                : g_suggestions[0];
-            
-            int wordStart = pane.caretPos;
-            while (wordStart > 0 && pane.inputBuffer[wordStart - 1] != ' ')
-                wordStart--;
-            
-            std::string newText = std::string(pane.inputBuffer, wordStart) + suggestion;
-            if (pane.caretPos < (int)strlen(pane.inputBuffer))
-                newText += std::string(pane.inputBuffer + pane.caretPos);
-            
-            strncpy_s(pane.inputBuffer, newText.c_str(), sizeof(pane.inputBuffer) - 1);
-            pane.caretPos = wordStart + suggestion.length();
-            pane.caretTime = 0.0f;
-            g_showSuggestions = false;
+            int idx = (g_selectedSuggestion >= 0 && g_selectedSuggestion < (int)g_suggestions.size()) ? g_selectedSuggestion : 0;
+            AcceptSuggestion(pane, idx);
         }
         
         // navigate autocomplete suggestions with up/down arrows
@@ -1496,6 +2109,8 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
     static float smooth_caret_x = target_caret_x;
     float lerp_speed = 18.0f;
     smooth_caret_x += (target_caret_x - smooth_caret_x) * lerp_speed * io.DeltaTime;
+    if (std::abs(target_caret_x - smooth_caret_x) > 0.25f)
+        g_frameScheduler.RequestFrameIn(0.0);
     
     // cursor trail effect
     if (g_cursorTrailEnabled)
@@ -1511,6 +2126,8 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
         for (auto& t : cursor_trail) t.second -= io.DeltaTime * 3.0f;
         cursor_trail.erase(std::remove_if(cursor_trail.begin(), cursor_trail.end(), 
             [](auto& t) { return t.second <= 0; }), cursor_trail.end());
+        if (!cursor_trail.empty())
+            g_frameScheduler.RequestFrameIn(0.0);
         
         int cr = (int)(g_caretColor.x * 255), cg = (int)(g_caretColor.y * 255), cb = (int)(g_caretColor.z * 255);
         for (size_t i = 0; i < cursor_trail.size(); i++)
@@ -1523,67 +2140,29 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
         }
     }
     
-    // draw smooth animated caret
+    // draw smooth animated caret. it pulses for a while after the last key,
+    // then rests at full brightness on a peak so an idle terminal stops
+    // drawing - 30 frames a second is plenty for a pulse this gentle
     float caret_alpha = 0.9f + 0.1f * sinf(pane.caretTime * 3.14159f * g_caretAnimSpeed);
-    float caret_width = 3.0f;
+    if (g_caretAnimSpeed > 0.0f)
+    {
+        const float kCaretPulseSeconds = 10.0f;
+        float restAt = (0.5f + 2.0f * ceilf((kCaretPulseSeconds * g_caretAnimSpeed - 0.5f) / 2.0f)) / g_caretAnimSpeed;
+        if (pane.caretTime >= restAt)
+            caret_alpha = 1.0f;
+        else
+            g_frameScheduler.RequestFrameIn(std::min(1.0f / 30.0f, restAt - pane.caretTime));
+    }
     float line_height = ImGui::GetTextLineHeight();
     float padding = 2.0f;
     float caret_height = line_height + padding * 2.0f;
     float caret_top = input_pos.y - padding;
-    float caret_center_x = smooth_caret_x + caret_width * 0.5f;
-    float caret_center_y = caret_top + caret_height * 0.5f;
     
+    // glow and body come out of the chrome cache, one shape per pulse step
     int cr = (int)(g_caretColor.x * 255);
     int cg = (int)(g_caretColor.y * 255);
     int cb = (int)(g_caretColor.z * 255);
-    
-    // draw caret glow
-    const float glow_radius = 4.0f;
-    const int glow_layers = 6;
-    for (int i = glow_layers; i >= 0; i--) {
-        float t = (float)i / glow_layers;
-        float radius = t * glow_radius;
-        float alpha_f = expf(-t * t * 4.0f) * 0.15f * caret_alpha;
-        int alpha = (int)(alpha_f * 255.0f);
-        if (alpha < 1) continue;
-        
-        float x1 = caret_center_x - caret_width * 0.5f - radius;
-        float y1 = caret_center_y - caret_height * 0.5f - radius;
-        float x2 = caret_center_x + caret_width * 0.5f + radius;
-        float y2 = caret_center_y + caret_height * 0.5f + radius;
-        
-        ImGui::GetWindowDrawList()->AddRectFilled(
-            ImVec2(x1, y1), ImVec2(x2, y2),
-            IM_COL32(cr, cg, cb, alpha),
-            radius + 2.0f
-        );
-    }
-    
-    // draw main caret body
-    float caret_bottom = caret_top + caret_height;
-    float radius = caret_width * 0.5f;
-    float center_x = smooth_caret_x + radius;
-    
-    ImGui::GetWindowDrawList()->AddRectFilled(
-        ImVec2(smooth_caret_x, caret_top + radius),
-        ImVec2(smooth_caret_x + caret_width, caret_bottom - radius),
-        IM_COL32(cr, cg, cb, (int)(caret_alpha * 255)),
-        0.0f
-    );
-    
-    ImGui::GetWindowDrawList()->AddCircleFilled(
-        ImVec2(center_x, caret_top + radius),
-        radius,
-        IM_COL32(cr, cg, cb, (int)(caret_alpha * 255)),
-        24
-    );
-    
-    ImGui::GetWindowDrawList()->AddCircleFilled(
-        ImVec2(center_x, caret_bottom - radius),
-        radius,
-        IM_COL32(cr, cg, cb, (int)(caret_alpha * 255)),
-        24
-    );
+    DrawCaret(ImGui::GetWindowDrawList(), &g_chromeCache, smooth_caret_x, caret_top, caret_height, IM_COL32(cr, cg, cb, 255), caret_alpha);
     
     // draw autocomplete suggestions dropdown
     if (g_showSuggestions && !g_suggestions.empty())
@@ -1600,9 +2179,16 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
         }
         if (maxTextWidth > 400.0f) maxTextWidth = 400.0f;
         
+        // only the first few get listed, say how many there are in total
+        std::string hint = "Tab = Accept  |  \xe2\x86\x91\xe2\x86\x93 = Navigate";
+        if (g_suggestionTotal > g_suggestions.size())
+            hint += "  |  " + std::to_string(g_suggestions.size()) + " of " + std::to_string(g_suggestionTotal);
+        
         float padding = 12.0f;
         float itemHeight = ImGui::GetTextLineHeight() + 8.0f;
         float dropdownWidth = maxTextWidth + padding * 2;
+        float hintWidth = font->CalcTextSizeA(fontSize, FLT_MAX, 0.0f, hint.c_str()).x + 16.0f;
+        if (dropdownWidth < hintWidth) dropdownWidth = hintWidth;
         float maxDropdownHeight = 200.0f;
         float dropdownHeight = (g_suggestions.size() * itemHeight + padding < maxDropdownHeight) ? (g_suggestions.size() * itemHeight + padding) : maxDropdownHeight;
         float hintBarHeight = 20.0f;
@@ -1623,7 +2209,7 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
         draw_list->AddText(
             ImVec2(hintBarPos.x + 8, hintBarPos.y + 2),
             IM_COL32(180, 180, 180, 255),
-            "Tab = Accept  |  \xe2\x86\x91\xe2\x86\x93 = Navigate");
+            hint.c_str());
         
         // dropdown
         ImVec2 listPos(dropdownPos.x, hintBarPos.y + hintBarHeight + 4);
@@ -1663,7 +2249,14 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
             
             bool isDir = (g_suggestions[i].length() > 0 && g_suggestions[i].back() == '\\');
             
-            if (isDir)
+            if (i < (int)g_historySuggestions)
+            {
+                // a past command, takes the whole line
+                draw_list->AddCircle(
+                    ImVec2(listPos.x + padding + 4, y + itemHeight * 0.5f),
+                    4.0f, IM_COL32(120, 170, 255, 255), 12, 1.5f);
+            }
+            else if (isDir)
             {
                 draw_list->AddRectFilled(
                     ImVec2(listPos.x + padding, y + itemHeight * 0.35f),
@@ -1704,20 +2297,7 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
                 if (ImGui::IsMouseClicked(0))
                 {
                     g_selectedSuggestion = i;
-                    std::string suggestion = g_suggestions[g_selectedSuggestion];
-                    
-                    int wordStart = pane.caretPos;
-                    while (wordStart > 0 && pane.inputBuffer[wordStart - 1] != ' ')
-                        wordStart--;
-                    
-                    std::string newText = std::string(pane.inputBuffer, wordStart) + suggestion;
-                    if (pane.caretPos < (int)strlen(pane.inputBuffer))
-                        newText += std::string(pane.inputBuffer + pane.caretPos);
-                    
-                    strncpy_s(pane.inputBuffer, newText.c_str(), sizeof(pane.inputBuffer) - 1);
-                    pane.caretPos = wordStart + suggestion.length();
-                    pane.caretTime = 0.0f;
-                    g_showSuggestions = false;
+                    AcceptSuggestion(pane, i);
                 }
             }
             
@@ -1731,221 +2311,157 @@ void RenderTerminalPane(int paneIdx, float width, float height, ImGuiIO& io)
         ImGui::SetKeyboardFocusHere(-1);
     }
     
-    // generate autocomplete suggestions
-    if (strlen(pane.inputBuffer) > 0)
-    {
-        int wordStart = pane.caretPos;
-        while (wordStart > 0 && pane.inputBuffer[wordStart - 1] != ' ')
-            wordStart--;
-        std::string currentWord(pane.inputBuffer + wordStart, pane.caretPos - wordStart);
-        
-        // clear previous suggestions
-        g_suggestions.clear();
-        
-        if (currentWord.length() > 0)
-        {
-                // check if it's a path (contains \ or : or /)
-                bool isPath = (currentWord.find('\\') != std::string::npos || 
-                               currentWord.find('/') != std::string::npos || 
-                               currentWord.find(':') != std::string::npos);
-                
-                if (isPath)
-                {
-                    // directory autocomplete
-                    std::string pathToComplete = currentWord;
-                    
-                    // normalize path separators
-                    std::replace(pathToComplete.begin(), pathToComplete.end(), '/', '\\');
-                    
-                    // extract the directory part and the partial filename
-                    std::string dirPath;
-                    std::string partialName;
-                    
-                    size_t lastSlash = pathToComplete.find_last_of('\\');
-                    if (lastSlash != std::string::npos)
-                    {
-                        dirPath = pathToComplete.substr(0, lastSlash + 1);
-                        partialName = pathToComplete.substr(lastSlash + 1);
-                    }
-                    else
-                    {
-                        // no slash, just a drive letter like "C:"
-                        dirPath = pathToComplete;
-                        if (dirPath.back() != '\\' && dirPath.back() != ':')
-                        {
-                            // it's something like "C:Use" - split into "C:" and "Use"
-                            size_t colonPos = dirPath.find(':');
-                            if (colonPos != std::string::npos && colonPos == dirPath.length() - 1)
-                            {
-                                dirPath += "\\";
-                            }
-                        }
-                        partialName = "";
-                    }
-                    
-                    // ensure directory ends with backslash
-                    if (!dirPath.empty() && dirPath.back() != '\\')
-                    {
-                        if (dirPath.back() == ':')
-                            dirPath += "\\";
-                    }
-                    
-                    // search in the directory
-                    std::string searchPath = dirPath + "*";
-                    
-                    WIN32_FIND_DATAA findData;
-                    HANDLE hFind = FindFirstFileA(searchPath.c_str(), &findData);
-                    
-                    if (hFind != INVALID_HANDLE_VALUE)
-                    {
-                        do
-                        {
-                            std::string name = findData.cFileName;
-                            
-                            // skip . and ..
-                            if (name == "." || name == "..")
-                                continue;
-                            
-                            // check if it starts with partial name (case-insensitive)
-                            if (partialName.empty() || _strnicmp(name.c_str(), partialName.c_str(), partialName.length()) == 0)
-                            {
-                                std::string fullPath = dirPath + name;
-                                
-                                // add \ for directories
-                                if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-                                {
-                                    fullPath += "\\";
-                                }
-                                
-                                // only add if not already in list
-                                bool exists = false;
-                                for (const auto& s : g_suggestions)
-                                {
-                                    if (_stricmp(s.c_str(), fullPath.c_str()) == 0)
-                                    {
-                                        exists = true;
-                                        break;
-                                    }
-                                }
-                                if (!exists)
-                                    g_suggestions.push_back(fullPath);
-                            }
-                        } while (FindNextFileA(hFind, &findData) && g_suggestions.size() < 50);
-                        
-                        FindClose(hFind);
-                    }
-                }
-                else
-                {
-                    // command autocomplete
-                    for (const auto& cmd : g_commonCommands)
-                    {
-                        if (cmd.length() >= currentWord.length() && 
-                            _strnicmp(cmd.c_str(), currentWord.c_str(), currentWord.length()) == 0)
-                        {
-                            g_suggestions.push_back(cmd);
-                        }
-                    }
-            }
-        }
-        
-        // limit suggestions (allow more for directories)
-        if (g_suggestions.size() > 30)
-            g_suggestions.resize(30);
-        
-        g_showSuggestions = !g_suggestions.empty();
-        if (g_selectedSuggestion >= (int)g_suggestions.size())
-            g_selectedSuggestion = 0;
-    }
-    else
+    // keep the command index on this pane's PATH, rebuilds happen on a worker
+    FrameProfiler::Scope autocompleteScope(FrameProfiler::Stage::kAutocomplete);
+    const char* pathVar = pane.env.Get("PATH");
+    const char* pathExt = pane.env.Get("PATHEXT");
+    g_commandIndex.Update(pathVar ? pathVar : "", pathExt ? pathExt : "", pane.currentDir);
+
+    // generate autocomplete suggestions - memoized on input/caret/cwd, so an
+    // idle input doesn't rescan anything
+    // history goes on top, whole lines that start with what's typed
+    uint64_t dirScans = g_completer.DirStats().scans;
+    // an empty input has no predictions, so it doesn't need the log loaded yet
+    bool historyChanged = (pane.inputBuffer[0] != '\0' || g_historyLoaded) && History().Update(pane.inputBuffer, (int64_t)time(nullptr));
+    bool completionsChanged = g_completer.Update(pane.inputBuffer, pane.caretPos, pane.currentDir);
+    if (historyChanged || completionsChanged)
     {
-        g_showSuggestions = false;
-        g_suggestions.clear();
+        g_suggestions = g_history.Predictions();
+        g_historySuggestions = g_suggestions.size();
+        g_suggestions.insert(g_suggestions.end(), g_completer.Suggestions().begin(), g_completer.Suggestions().end());
     }
+    g_suggestionTotal = g_historySuggestions + g_completer.MatchCount();
+    if (g_completer.DirStats().scans != dirScans)
+        g_lastDirScanFrame = ImGui::GetFrameCount();
+    
+    g_showSuggestions = !g_suggestions.empty() && !pane.searching;
+    if (g_selectedSuggestion >= (int)g_suggestions.size())
+        g_selectedSuggestion = 0;
+    autocompleteScope.End();
 
     ImGui::EndChild();
 }
 
-std::string ExecuteCommand(const std::string& cmd)
+// start an external command in a pane. it goes to the pane's shell and the
+// output streams in through PumpCommandJobs, so a long build doesn't freeze the ui
+void ExecuteCommand(int paneIdx, const std::string& cmd)
 {
-    SECURITY_ATTRIBUTES sa;
-    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
-    sa.bInheritHandle = TRUE;
-    sa.lpSecurityDescriptor = NULL;
-
-    HANDLE hRead, hWrite;
-    if (!CreatePipe(&hRead, &hWrite, &sa, 0))
-        return "Error: Failed to create pipe";
-
-    STARTUPINFOA si = { sizeof(STARTUPINFOA) };
-    si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-    si.hStdOutput = hWrite;
-    si.hStdError = hWrite;
-    si.wShowWindow = SW_HIDE;
-
-    PROCESS_INFORMATION pi = { 0 };
-
-    // build command line
-    std::string fullCmd = "cmd.exe /c " + cmd;
-    char cmdLine[1024];
-    strncpy_s(cmdLine, fullCmd.c_str(), sizeof(cmdLine) - 1);
-    cmdLine[sizeof(cmdLine) - 1] = '\0';
-
-    BOOL success = CreateProcessA(
-        NULL,
-        cmdLine,
-        NULL,
-        NULL,
-        TRUE,
-        0,
-        NULL,
-        NULL,
-        &si,
-        &pi
-    );
+    TerminalPane& pane = g_panes[paneIdx];
 
-    if (!success)
+    // no point starting (or waking) the shell just to hear it doesn't know the command.
+    // pane.env is what the shell reported after its last command, so this is its real PATH
+    std::string_view word = CommandIndex::CommandWord(cmd);
+    const char* pathVar = pane.env.Get("PATH");
+    const char* pathExt = pane.env.Get("PATHEXT");
+    if (g_commandIndex.Resolve(word, pathVar ? pathVar : "", pathExt ? pathExt : "", pane.currentDir) == CommandIndex::Resolution::kMissing)
     {
-        CloseHandle(hWrite);
-        CloseHandle(hRead);
-        DWORD error = GetLastError();
-        if (error == 2)
-            return "'" + cmd + "' is not recognized as an internal or external command";
-        return "Error: Failed to execute command (code " + std::to_string(error) + ")";
+        AddOutputLineToPane(paneIdx, "'" + std::string(word) + "' is not recognized as an internal or external command,");
+        AddOutputLineToPane(paneIdx, "operable program or batch file.");
+        AddOutputLineToPane(paneIdx, "");
+        g_commandStatus = 9009;  // what cmd would have exited with
+        return;
     }
 
-    CloseHandle(hWrite);
+    SpawnContext context;
+    context.cwd = pane.currentDir;
+    context.env = pane.env;
+    pane.job = pane.shell.Run(cmd, context);
+}
 
-    // read output
-    std::string output;
-    char buffer[4096];
-    DWORD bytesRead;
-    
-    while (ReadFile(hRead, buffer, sizeof(buffer) - 1, &bytesRead, NULL) && bytesRead > 0)
+// called once a frame - moves finished lines from the running commands into their panes
+void PumpCommandJobs()
+{
+    static LineBatch lines;
+    for (int paneIdx = 0; paneIdx < 2; paneIdx++)
     {
-        buffer[bytesRead] = '\0';
-        output += buffer;
-    }
-
-    CloseHandle(hRead);
-    WaitForSingleObject(pi.hProcess, INFINITE);
-    
-    DWORD exitCode;
-    GetExitCodeProcess(pi.hProcess, &exitCode);
-    
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
-
-    // trim trailing newlines
-    while (!output.empty() && (output.back() == '\n' || output.back() == '\r'))
-        output.pop_back();
+        TerminalPane& pane = g_panes[paneIdx];
+        if (!pane.job)
+            continue;
+
+        // check before taking, so no lines can sneak in after the last take
+        bool finished = pane.job->Finished();
+        pane.job->TakeLines(lines);
+        if (!lines.Empty() || finished)
+            g_frameScheduler.Invalidate();
+        if (!lines.Empty())
+        {
+            // one timestamp and one scrollback lock for the whole batch
+            char timestamp[32] = "";
+            if (g_showTimestamp)
+            {
+                SYSTEMTIME st;
+                GetLocalTime(&st);
+                sprintf_s(timestamp, "[%02d:%02d:%02d] ", st.wHour, st.wMinute, st.wSecond);
+            }
+            pane.outputLines.Append(timestamp, lines);
+            lines.Clear();
+        }
 
-    if (output.empty() && exitCode != 0)
-        return "'" + cmd + "' is not recognized as an internal or external command";
+        if (!finished)
+            continue;
+
+        // the shell reports unknown commands itself now, we only have to cover it not starting
+        CommandJob& job = *pane.job;
+        if (job.StartError() != 0)
+            AddOutputLineToPane(paneIdx, "Error: Failed to start cmd.exe (code " + std::to_string(job.StartError()) + ")");
+        else if (job.Cancelled())
+            AddOutputLineToPane(paneIdx, "^C");
+        AddOutputLineToPane(paneIdx, "");
+        double seconds = job.Seconds();
+        g_historyLog.Append(job.Command(), (int64_t)time(nullptr) - (int64_t)seconds, pane.currentDir, job.ExitCode(), (uint32_t)(seconds * 1000.0));
+        pane.job.reset();
+
+        // the command might have created or deleted files we'd complete
+        g_completer.Invalidate();
+
+        // cd and set happen inside the shell, the pane follows them - so a shell
+        // restarted after ctrl+c or exit gets the same cwd and environment back
+        std::string cwd = pane.shell.Cwd();
+        if (!cwd.empty())
+            pane.currentDir = cwd;
+        Environment env = pane.shell.Env();
+        if (!env.Empty())
+            pane.env = env;
+    }
+}
 
-    return output;
+// files the builtins write - relative names go in the active pane's directory
+static std::string PathInPaneDir(const std::string& name)
+{
+    bool absolute = (name.size() > 1 && name[1] == ':') || name[0] == '\\' || name[0] == '/';
+    return absolute ? name : g_panes[g_activePane].currentDir + "\\" + name;
 }
 
+// a histogram of each stage's recent timings, p50 and p99 on top. the
+// profiler collects every frame while it's on, this only shows it
+void RenderPerfOverlay(ImGuiIO& io)
+{
+    FrameProfiler& profiler = FrameProfiler::Shared();
+    ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 20.0f, 50.0f), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    ImGuiWindowFlags flags = ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+    if (!ImGui::Begin("Perf", &g_showPerfOverlay, flags))
+    {
+        ImGui::End();
+        return;
+    }
+    for (int s = 0; s < (int)FrameProfiler::Stage::kCount; s++)
+    {
+        FrameProfiler::Stage stage = (FrameProfiler::Stage)s;
+        FrameProfiler::Summary summary = profiler.Summarize(stage);
+        if (summary.count == 0)
+            continue;
+        const std::vector<float>& recent = profiler.Recent(stage);
+        char overlay[64];
+        sprintf_s(overlay, "p50 %.2f  p99 %.2f ms", summary.p50Ms, summary.p99Ms);
+        ImGui::PlotHistogram(FrameProfiler::StageName(stage), recent.data(), (int)recent.size(), 0, overlay,
+            0.0f, std::max(0.01f, (float)summary.p99Ms * 1.25f), ImVec2(260.0f, 36.0f));
+    }
+    if (uint64_t dropped = profiler.Dropped())
+        ImGui::Text("%llu samples dropped", (unsigned long long)dropped);
+    ImGui::End();
+}
+
 void ProcessCommand(const std::string& cmd)
 {
     if (cmd == "$help")
@@ -1959,14 +2475,21 @@ void ProcessCommand(const std::string& cmd)
         AddOutputLine("  system    - Display real system information");
         AddOutputLine("  settings  - Configure terminal (blur, timestamps, etc)");
         AddOutputLine("  time      - Show current date and time");
-        AddOutputLine("  <any cmd> - Execute real Windows commands");
+        AddOutputLine("  stats     - Show autocomplete counters");
+        AddOutputLine("  snapshot  - Save the window as a bmp, drawn without the gpu");
+        AddOutputLine("  perf      - Frame stage timings (perf on/off/overlay/reset/save)");
+        AddOutputLine("  <any cmd> - Execute real Windows commands");
         AddOutputLine("");
         AddOutputLine("Keyboard Shortcuts:");
         AddOutputLine("  Ctrl+Z    - Go back in command history");
         AddOutputLine("  Ctrl+X    - Go forward in command history");
         AddOutputLine("  Up/Down   - Navigate autocomplete suggestions");
         AddOutputLine("  Tab       - Accept autocomplete suggestion");
-        AddOutputLine("  Ctrl+F    - Toggle search");
+        AddOutputLine("  Right     - Take the grey history prediction (at end of line)");
+        AddOutputLine("  Ctrl+R    - Search history (again for older, Esc to cancel)");
+        AddOutputLine("  Ctrl+F    - Toggle search (Enter next match, Shift+Enter previous)");
+        AddOutputLine("              .* searches with a regex, Filter hides lines that don't match");
+        AddOutputLine("  Ctrl+C    - Stop the running command");
     }
     else if (cmd == "cmds")
     {
@@ -1978,11 +2501,14 @@ void ProcessCommand(const std::string& cmd)
         AddOutputLine("  system    - Display real system information");
         AddOutputLine("  settings  - Configure terminal (blur, timestamps, etc)");
         AddOutputLine("  time      - Show current date and time");
+        AddOutputLine("  stats     - Show autocomplete counters");
+        AddOutputLine("  snapshot  - Save the window as a bmp, drawn without the gpu");
+        AddOutputLine("  perf      - Frame stage timings (perf on/off/overlay/reset/save)");
         AddOutputLine("  <any cmd> - Execute real Windows commands");
     }
     else if (cmd == "cls")
     {
-        g_panes[g_activePane].outputLines.clear();
+        g_panes[g_activePane].outputLines.Clear();
     }
     else if (cmd == "quit")
     {
@@ -2085,6 +2611,31 @@ void ProcessCommand(const std::string& cmd)
                 SaveSettings();
                 AddOutputLine(std::string("Timestamps set to: ") + (enable ? "ON" : "OFF"));
             }
+            else if (setting == "scrollback")
+            {
+                int mb = atoi(value.c_str());
+                if (mb > 0)
+                {
+                    g_scrollbackMB = mb;
+                    for (auto& pane : g_panes)
+                        ApplyScrollbackBudget(pane);
+                    SaveSettings();
+                    AddOutputLine("Scrollback budget set to: " + std::to_string(mb) + " MB per pane");
+                }
+                else
+                {
+                    AddOutputLine("Usage: settings scrollback <megabytes>");
+                }
+            }
+            else if (setting == "index")
+            {
+                // per pane, it costs memory out of that pane's scrollback budget
+                TerminalPane& pane = g_panes[g_activePane];
+                pane.outputIndex.SetEnabled(enable);
+                ApplyScrollbackBudget(pane);
+                SaveSettings();
+                AddOutputLine(std::string("Search index for this pane set to: ") + (enable ? "ON" : "OFF"));
+            }
             else
             {
                 AddOutputLine("Unknown setting: " + setting);
@@ -2107,48 +2658,155 @@ void ProcessCommand(const std::string& cmd)
         sprintf_s(timeStr, "Time: %02d:%02d:%02d", st.wHour, st.wMinute, st.wSecond);
         AddOutputLine(timeStr);
     }
-    else if (cmd.substr(0, 3) == "cd ")
+    else if (cmd == "stats")
     {
-        // handle cd command specially - it's a shell builtin
-        std::string path = cmd.substr(3);
-        // remove quotes if present
-        if (!path.empty() && path[0] == '"' && path.back() == '"')
+        const Completer::Stats& stats = g_completer.GetStats();
+        AddOutputLine("Autocomplete: " + std::to_string(stats.updates) + " updates, " + std::to_string(stats.recomputes) +
+            " recomputed (" + std::to_string(stats.narrowed) + " by narrowing), " + std::to_string(stats.scored) + " candidates scored");
+        const HistoryIndex::Stats& historyStats = g_history.GetStats();
+        AddOutputLine("History: " + std::to_string(g_history.Size()) + " distinct commands, " + std::to_string(historyStats.lookups) +
+            " lookups, " + std::to_string(historyStats.scanned) + " entries scanned" + (g_historyLoaded ? "" : " (log not loaded yet)"));
+        const HistorySearch::Stats& searchStats = g_historySearch.GetStats();
+        AddOutputLine("History search: " + std::to_string(g_historySearch.Size()) + " entries, " + std::to_string(searchStats.finds) +
+            " finds, " + std::to_string(searchStats.checked) + " candidates checked, " + std::to_string(searchStats.compactions) + " compactions");
+        const OutputSearch::Stats& outputSearchStats = g_panes[g_activePane].outputSearch.GetStats();
+        AddOutputLine("Output search: " + std::to_string(outputSearchStats.updates) + " updates, " + std::to_string(outputSearchStats.rescans) +
+            " full scans, " + std::to_string(outputSearchStats.narrowed) + " narrowed, " + std::to_string(outputSearchStats.linesScanned) +
+            " lines / " + std::to_string(outputSearchStats.bytesScanned / 1024) + " KB searched, " +
+            std::to_string(outputSearchStats.background) + " in the background (" + std::to_string(outputSearchStats.cancelled) + " cancelled), " +
+            std::to_string(outputSearchStats.indexed) + " through the index");
+        const OutputIndex& outputIndex = g_panes[g_activePane].outputIndex;
+        if (outputIndex.Enabled())
         {
-            path = path.substr(1, path.length() - 2);
+            const OutputIndex::Stats& indexStats = outputIndex.GetStats();
+            AddOutputLine("Output index: " + std::to_string(indexStats.linesIndexed) + " lines / " + std::to_string(indexStats.bytesIndexed / 1024) +
+                " KB indexed in " + std::to_string(outputIndex.MemoryBytes() / 1024) + " KB, " + std::to_string(indexStats.queries) + " queries, " +
+                std::to_string(indexStats.candidates) + " candidate lines");
         }
-        
-        if (SetCurrentDirectoryA(path.c_str()))
+        const HistoryLog::Stats& logStats = g_historyLog.GetStats();
+        AddOutputLine("History log: " + std::to_string(logStats.bytes / 1024) + " KB mapped, " + std::to_string(logStats.indexed) + " lines indexed, " +
+            std::to_string(logStats.skipped) + " skipped, " + std::to_string(logStats.appended) + " appended, " +
+            std::to_string(logStats.refreshes) + " refreshes");
+        AddOutputLine("Command index: " + std::to_string(g_commandIndex.Current()->entries.size()) + " commands from " +
+            std::to_string(g_commandIndex.PathDirs()) + " PATH directories, " + std::to_string(g_commandIndex.Builds()) + " builds");
+        DirCache::Stats dirStats = g_completer.DirStats();
+        AddOutputLine("Directory cache: " + std::to_string(dirStats.lookups) + " lookups, " + std::to_string(dirStats.hits) +
+            " hits, " + std::to_string(dirStats.changes) + " change notifications");
+        AddOutputLine("Directory scans: " + std::to_string(dirStats.scans) + " total, last one " +
+            std::to_string(ImGui::GetFrameCount() - g_lastDirScanFrame) + " frames ago");
+        const ChromeCache::Stats& chromeStats = g_chromeCache.GetStats();
+        ImDrawData* drawData = ImGui::GetDrawData();
+        AddOutputLine("Chrome: " + std::to_string(g_chromeCache.Shapes()) + " shapes cached, " + std::to_string(chromeStats.recorded) + " recorded, " +
+            std::to_string(chromeStats.replayed) + " replayed, " + std::to_string(chromeStats.resets) + " resets; last frame " +
+            std::to_string(chromeStats.frameVertices) + " chrome vertices (" + std::to_string(chromeStats.frameTessellated) + " tessellated) of " +
+            std::to_string(drawData ? drawData->TotalVtxCount : 0));
+        const TextGrid::Stats& gridStats = g_textGrid.GetStats();
+        AddOutputLine("Text grid: " + std::to_string(gridStats.rows) + " rows, " + std::to_string(gridStats.cells) + " cells walked, " +
+            std::to_string(gridStats.quads) + " quads, " + std::to_string(gridStats.rebuilds) + " glyph table rebuilds");
+        const RowCache& rowCache = g_panes[g_activePane].rowCache;
+        const RowCache::Stats& rowStats = rowCache.GetStats();
+        AddOutputLine("Row cache: " + std::to_string(rowCache.Rows()) + " rows (" + std::to_string(rowCache.Vertices() * sizeof(ImDrawVert) / 1024) +
+            " KB), " + std::to_string(rowStats.replayed) + " replayed, " + std::to_string(rowStats.recorded) + " recorded, " +
+            std::to_string(rowStats.evicted) + " evicted, " + std::to_string(rowStats.resets) + " resets; last frame " +
+            std::to_string(rowStats.frameReplayed) + " of " + std::to_string(rowStats.frameRows) + " rows replayed");
+        const FrameScheduler::Stats& frameStats = g_frameScheduler.GetStats();
+        AddOutputLine("Frames: " + std::to_string(frameStats.frames) + " drawn in " + std::to_string(frameStats.wakeups) + " wakeups, " +
+            std::to_string(frameStats.deadlines) + " for animations, " + std::to_string(frameStats.signals) + " woken by workers, " +
+            std::to_string((int)frameStats.waitedSeconds) + " s asleep");
+        // what the process cost since stats last ran - leave the terminal alone
+        // in between to see what idling costs
+        static ULONGLONG lastCpu = 0, lastWall = 0;
+        static uint64_t lastFrames = 0;
+        FILETIME created, exited, kernel, user;
+        GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+        ULONGLONG cpu = (((ULONGLONG)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) + (((ULONGLONG)user.dwHighDateTime << 32) | user.dwLowDateTime);
+        ULONGLONG wall = GetTickCount64();
+        if (lastWall != 0 && wall > lastWall)
+        {
+            char line[160];
+            sprintf_s(line, "Since the last stats: %.1f s, %llu frames, %.2f%% of a core",
+                (wall - lastWall) / 1000.0, (unsigned long long)(frameStats.frames - lastFrames), (cpu - lastCpu) / 100.0 / (wall - lastWall));
+            AddOutputLine(line);
+        }
+        lastCpu = cpu;
+        lastWall = wall;
+        lastFrames = frameStats.frames;
+    }
+    else if (cmd == "snapshot" || cmd.substr(0, 9) == "snapshot ")
+    {
+        // saved once the frame is rendered
+        std::string name = cmd.size() > 9 ? cmd.substr(9) : "";
+        g_snapshotPath = PathInPaneDir(name.empty() ? "snapshot.bmp" : name);
+    }
+    else if (cmd == "perf" || cmd.substr(0, 5) == "perf ")
+    {
+        FrameProfiler& profiler = FrameProfiler::Shared();
+        std::string args = cmd.size() > 5 ? cmd.substr(5) : "";
+        if (args == "on" || args == "off")
+        {
+            profiler.SetEnabled(args == "on");
+            AddOutputLine(args == "on" ? "Profiler on - 'perf' for timings, 'perf overlay' to watch them" : "Profiler off");
+        }
+        else if (args == "overlay")
+        {
+            g_showPerfOverlay = !g_showPerfOverlay;
+            if (g_showPerfOverlay)
+                profiler.SetEnabled(true);
+            AddOutputLine(g_showPerfOverlay ? "Perf overlay shown" : "Perf overlay hidden, the profiler keeps recording ('perf off' to stop)");
+        }
+        else if (args == "reset")
+        {
+            profiler.Reset();
+            AddOutputLine("Profiler timings cleared");
+        }
+        else if (args == "save" || args.substr(0, 5) == "save ")
+        {
+            profiler.Collect();
+            std::string name = args.size() > 5 ? args.substr(5) : "";
+            std::string path = PathInPaneDir(name.empty() ? "perf_capture.json" : name);
+            if (profiler.SaveCapture(path))
+                AddOutputLine("Saved " + std::to_string(profiler.Captured()) + " samples to " + path + " (open in chrome://tracing or Perfetto)");
+            else
+                AddOutputLine("Error: Couldn't write " + path);
+        }
+        else if (!args.empty())
         {
-            // update current directory display for active pane
-            char currentPath[MAX_PATH];
-            GetCurrentDirectoryA(MAX_PATH, currentPath);
-            g_panes[g_activePane].currentDir = currentPath;
+            AddOutputLine("Usage: perf [on|off|overlay|reset|save [file]]");
+        }
+        else if (!FrameProfiler::Enabled() && profiler.Summarize(FrameProfiler::Stage::kFrame).count == 0)
+        {
+            AddOutputLine("Profiler is off - 'perf on' to start recording, 'perf overlay' to watch");
         }
         else
         {
-            AddOutputLine("cd: " + path + ": No such file or directory");
+            profiler.Collect();
+            AddOutputLine(std::string("Frame stages, ms") + (FrameProfiler::Enabled() ? "" : " (profiler off)") + ":");
+            AddOutputLine("  stage             count      mean       p50       p99       max");
+            for (int s = 0; s < (int)FrameProfiler::Stage::kCount; s++)
+            {
+                FrameProfiler::Stage stage = (FrameProfiler::Stage)s;
+                FrameProfiler::Summary summary = profiler.Summarize(stage);
+                if (summary.count == 0)
+                    continue;
+                char line[160];
+                sprintf_s(line, "  %-14s %8llu %9.3f %9.3f %9.3f %9.3f", FrameProfiler::StageName(stage), (unsigned long long)summary.count,
+                    summary.meanMs, summary.p50Ms, summary.p99Ms, summary.maxMs);
+                AddOutputLine(line);
+            }
+            if (uint64_t dropped = profiler.Dropped())
+                AddOutputLine("  " + std::to_string(dropped) + " samples dropped, rings filled up between frames");
         }
     }
-    else if (cmd == "cd")
+    else if (g_panes[g_activePane].job)
     {
-        // just cd with no args - show current directory
-        AddOutputLine(g_panes[g_activePane].currentDir);
+        AddOutputLine("A command is already running in this terminal (Ctrl+C to stop it)");
     }
     else
     {
-        // execute real cmd command and display output
-        std::string result = ExecuteCommand(cmd);
-        
-        // split output into lines
-        std::istringstream stream(result);
-        std::string line;
-        while (std::getline(stream, line))
-        {
-            // remove carriage returns
-            line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
-            if (!line.empty())
-                AddOutputLine(line);
-        }
+        // execute real cmd command, output shows up as it comes in
+        // and the blank line after it gets added once it finishes
+        ExecuteCommand(g_activePane, cmd);
+        return;
     }
     AddOutputLine("");
 }
@@ -2270,6 +2928,7 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
     switch (msg)
     {
     case WM_SIZE:
+        g_frameScheduler.Invalidate(2);
         if (g_pd3dDevice != nullptr && wParam != SIZE_MINIMIZED)
         {
             CleanupRenderTarget();
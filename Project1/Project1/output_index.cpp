@@ -0,0 +1,304 @@
+#include "output_index.h"
+#include "output_search.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+    // lines per segment - local line numbers have to fit the low 16 bits of a pair
+    const uint32_t kSegmentLines = 4096;
+
+    // postings point at groups of this many lines rather than single ones. the
+    // text a log repeats line after line then costs a byte per group instead
+    // of one per line, for a few more lines to check per hit
+    const uint32_t kLineGroup = 4;
+
+    // memory has to move this much before the scrollback budget gets redone
+    const size_t kRebudgetBytes = 1024 * 1024;
+
+    inline uint32_t Trigram(const char* at)
+    {
+        return (uint32_t)(unsigned char)at[0] | ((uint32_t)(unsigned char)at[1] << 8) | ((uint32_t)(unsigned char)at[2] << 16);
+    }
+
+    // keeps the lines in `lines` that are also on the packed list at [p, end)
+    void Intersect(std::vector<uint16_t>& lines, const uint8_t* p, const uint8_t* end)
+    {
+        size_t kept = 0, i = 0;
+        uint32_t line = 0;
+        bool first = true;
+        while (p < end && i < lines.size())
+        {
+            uint32_t delta = 0;
+            int shift = 0;
+            while (*p & 0x80)
+            {
+                delta |= (uint32_t)(*p++ & 0x7F) << shift;
+                shift += 7;
+            }
+            delta |= (uint32_t)*p++ << shift;
+            line = first ? delta : line + delta;
+            first = false;
+            while (i < lines.size() && lines[i] < line)
+                i++;
+            if (i < lines.size() && lines[i] == line)
+                lines[kept++] = lines[i++];
+        }
+        lines.resize(kept);
+    }
+
+    void Decode(std::vector<uint16_t>& lines, const uint8_t* p, const uint8_t* end)
+    {
+        lines.clear();
+        uint32_t line = 0;
+        bool first = true;
+        while (p < end)
+        {
+            uint32_t delta = 0;
+            int shift = 0;
+            while (*p & 0x80)
+            {
+                delta |= (uint32_t)(*p++ & 0x7F) << shift;
+                shift += 7;
+            }
+            delta |= (uint32_t)*p++ << shift;
+            line = first ? delta : line + delta;
+            first = false;
+            lines.push_back((uint16_t)line);
+        }
+    }
+}
+
+// a full segment's pairs, sorted and packed off the ui thread. it only ever
+// touches its own data, so nothing has to wait for it - a dropped segment
+// just leaves it to finish and get thrown away
+struct OutputIndex::SealJob
+{
+    std::vector<uint64_t> pairs;
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> starts;
+    std::vector<uint8_t> postings;
+    std::atomic<bool> done{ false };
+};
+
+void OutputIndex::SetEnabled(bool enabled)
+{
+    if (enabled == m_enabled)
+        return;
+    m_enabled = enabled;
+    m_segments.release();
+    m_indexedEnd = 0;
+    m_memory = 0;
+    m_budgetedMemory = 0;
+}
+
+bool OutputIndex::Sealing() const
+{
+    for (size_t i = 0; i < m_segments.size(); i++)
+    {
+        if (m_segments[i].sealing)
+            return true;
+    }
+    return false;
+}
+
+size_t OutputIndex::SegmentMemory(const Segment& segment) const
+{
+    return sizeof(Segment) + segment.pairs.capacity() * sizeof(uint64_t) + segment.keys.capacity() * sizeof(uint32_t) +
+        segment.starts.capacity() * sizeof(uint32_t) + segment.postings.capacity();
+}
+
+void OutputIndex::Seal(Segment& segment)
+{
+    auto job = std::make_shared<SealJob>();
+    job->pairs = std::move(segment.pairs);
+    segment.pairs = std::vector<uint64_t>();
+    segment.sealing = job;
+    WorkerPool::Shared().Submit([job] {
+        // the pairs went in a line at a time, so they're already in line order -
+        // a stable radix sort on just the trigram bytes finishes the job
+        std::vector<uint64_t>& pairs = job->pairs;
+        std::vector<uint64_t> sorted(pairs.size());
+        for (int shift = 16; shift < 40; shift += 8)
+        {
+            size_t counts[257] = {};
+            for (uint64_t pair : pairs)
+                counts[((pair >> shift) & 0xFF) + 1]++;
+            for (int b = 0; b < 256; b++)
+                counts[b + 1] += counts[b];
+            for (uint64_t pair : pairs)
+                sorted[counts[(pair >> shift) & 0xFF]++] = pair;
+            pairs.swap(sorted);
+        }
+        std::vector<uint64_t>().swap(sorted);
+        job->postings.reserve(pairs.size());
+        uint32_t key = ~0u, last = 0;
+        uint64_t previous = ~0ull;
+        for (uint64_t pair : pairs)
+        {
+            if (pair == previous)
+                continue;  // the same run twice in one line
+            previous = pair;
+            uint32_t line = (uint32_t)(pair & 0xFFFF);
+            uint32_t delta = line;
+            if ((uint32_t)(pair >> 16) != key)
+            {
+                key = (uint32_t)(pair >> 16);
+                job->keys.push_back(key);
+                job->starts.push_back((uint32_t)job->postings.size());
+            }
+            else
+                delta = line - last;
+            last = line;
+            while (delta >= 0x80)
+            {
+                job->postings.push_back((uint8_t)(delta | 0x80));
+                delta >>= 7;
+            }
+            job->postings.push_back((uint8_t)delta);
+        }
+        job->starts.push_back((uint32_t)job->postings.size());
+        job->postings.shrink_to_fit();
+        std::vector<uint64_t>().swap(pairs);
+        job->done = true;
+    });
+}
+
+void OutputIndex::IndexLine(Segment& segment, std::string_view text)
+{
+    uint64_t line = segment.lineCount++;
+    m_stats.linesIndexed++;
+    m_stats.bytesIndexed += text.size();
+    if (text.size() < 3)
+        return;
+    FoldText(text, m_folded);
+    // repeats within the line come out when the segment gets packed
+    const char* p = m_folded.data();
+    for (size_t i = 0; i + 3 <= m_folded.size(); i++)
+        segment.pairs.push_back(((uint64_t)Trigram(p + i) << 16) | (line / kLineGroup));
+}
+
+bool OutputIndex::Update(const Scrollback& lines, size_t maxBytes)
+{
+    if (!m_enabled)
+        return false;
+
+    // segments whose lines are all gone go with them
+    uint64_t firstId = lines.FirstLineId();
+    while (!m_segments.empty() && m_segments.front().firstId + m_segments.front().lineCount <= firstId)
+    {
+        m_segments.pop_front();
+        m_stats.dropped++;
+    }
+    m_indexedEnd = std::max(m_indexedEnd, firstId);
+
+    // pick up whatever finished packing
+    for (size_t i = 0; i < m_segments.size(); i++)
+    {
+        Segment& segment = m_segments[i];
+        if (!segment.sealing || !segment.sealing->done)
+            continue;
+        segment.keys = std::move(segment.sealing->keys);
+        segment.starts = std::move(segment.sealing->starts);
+        segment.postings = std::move(segment.sealing->postings);
+        segment.sealing.reset();
+        segment.sealed = true;
+        m_stats.sealed++;
+    }
+
+    size_t bytes = 0;
+    uint64_t endId = lines.EndLineId();
+    while (m_indexedEnd < endId && bytes < maxBytes)
+    {
+        // line ids in a segment have to run on from its first one - a jump
+        // (lines evicted before they got indexed) starts a new segment too
+        bool full = !m_segments.empty() && m_segments.back().lineCount == kSegmentLines;
+        bool gap = !m_segments.empty() && m_segments.back().firstId + m_segments.back().lineCount != m_indexedEnd;
+        if (m_segments.empty() || full || gap)
+        {
+            if (!m_segments.empty() && !m_segments.back().sealed && !m_segments.back().sealing)
+                Seal(m_segments.back());
+            Segment segment;
+            segment.firstId = m_indexedEnd;
+            m_segments.push_back(std::move(segment));
+        }
+        std::string_view text = lines[(size_t)(m_indexedEnd - firstId)];
+        IndexLine(m_segments.back(), text);
+        bytes += text.size();
+        m_indexedEnd++;
+    }
+    if (!m_segments.empty() && m_segments.back().lineCount == kSegmentLines && !m_segments.back().sealed && !m_segments.back().sealing)
+        Seal(m_segments.back());
+
+    m_memory = 0;
+    for (size_t i = 0; i < m_segments.size(); i++)
+        m_memory += SegmentMemory(m_segments[i]);
+    size_t moved = m_memory > m_budgetedMemory ? m_memory - m_budgetedMemory : m_budgetedMemory - m_memory;
+    if (moved < kRebudgetBytes)
+        return false;
+    m_budgetedMemory = m_memory;
+    return true;
+}
+
+bool OutputIndex::Candidates(const std::string& folded, uint64_t firstId, std::vector<uint64_t>& out)
+{
+    out.clear();
+    if (!m_enabled || folded.size() < 3)
+        return false;
+    m_stats.queries++;
+
+    std::vector<uint32_t> grams;
+    for (size_t i = 0; i + 3 <= folded.size(); i++)
+        grams.push_back(Trigram(folded.data() + i));
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+    std::vector<uint32_t> lists;
+    std::vector<uint16_t> found;
+    for (size_t s = 0; s < m_segments.size(); s++)
+    {
+        const Segment& segment = m_segments[s];
+        uint64_t end = segment.firstId + segment.lineCount;
+        if (end <= firstId)
+            continue;
+        if (!segment.sealed)
+        {
+            // not packed yet, every line in it is a candidate
+            for (uint64_t lineId = std::max(firstId, segment.firstId); lineId < end; lineId++)
+                out.push_back(lineId);
+            continue;
+        }
+
+        lists.clear();
+        for (uint32_t gram : grams)
+        {
+            auto at = std::lower_bound(segment.keys.begin(), segment.keys.end(), gram);
+            if (at == segment.keys.end() || *at != gram)
+            {
+                lists.clear();
+                break;  // nothing in this segment has that run
+            }
+            lists.push_back((uint32_t)(at - segment.keys.begin()));
+        }
+        if (lists.empty())
+            continue;
+        // shortest list first, every other one can only whittle it down
+        auto length = [&](uint32_t k) { return segment.starts[k + 1] - segment.starts[k]; };
+        std::sort(lists.begin(), lists.end(), [&](uint32_t a, uint32_t b) { return length(a) < length(b); });
+        const uint8_t* postings = segment.postings.data();
+        Decode(found, postings + segment.starts[lists[0]], postings + segment.starts[lists[0] + 1]);
+        for (size_t i = 1; i < lists.size() && !found.empty(); i++)
+            Intersect(found, postings + segment.starts[lists[i]], postings + segment.starts[lists[i] + 1]);
+        for (uint16_t group : found)
+        {
+            uint64_t start = std::max(firstId, segment.firstId + (uint64_t)group * kLineGroup);
+            uint64_t stop = std::min(end, segment.firstId + (uint64_t)(group + 1) * kLineGroup);
+            for (uint64_t lineId = start; lineId < stop; lineId++)
+                out.push_back(lineId);
+        }
+    }
+    m_stats.candidates += out.size();
+    return true;
+}
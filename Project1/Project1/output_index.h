@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ring_buffer.h"
+#include "scrollback.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// optional trigram index over a pane's output, so ctrl+f in a huge log only
+// looks at lines that have every 3 byte run of the query in them
+//
+// lines go in as they're appended, a segment of 4096 at a time. a full segment
+// gets sorted and packed on the worker pool into one delta coded list per
+// trigram of the 4 line groups it shows up in - until then its lines just
+// count as candidates. segments drop
+// off the front as the scrollback evicts, so the index never outlives its lines.
+// all of it is on the ui thread apart from the packing
+class OutputIndex
+{
+public:
+    struct Stats
+    {
+        uint64_t linesIndexed = 0;
+        uint64_t bytesIndexed = 0;
+        uint64_t sealed = 0;          // segments packed
+        uint64_t dropped = 0;         // segments evicted with their lines
+        uint64_t queries = 0;
+        uint64_t candidates = 0;      // lines handed back to be checked for real
+    };
+
+    // off by default. turning it off throws the whole thing away
+    void SetEnabled(bool enabled);
+    bool Enabled() const { return m_enabled; }
+
+    // indexes up to about maxBytes of new output and drops what scrolled out.
+    // true when MemoryBytes() moved enough to be worth re-budgeting the scrollback
+    bool Update(const Scrollback& lines, size_t maxBytes = SIZE_MAX);
+
+    // lines before this id have been indexed (or evicted)
+    uint64_t IndexedEnd() const { return m_indexedEnd; }
+    // a segment is still being packed in the background
+    bool Sealing() const;
+
+    // ids in [firstId, IndexedEnd()) that might contain folded (a FoldText'd
+    // query), ascending. false if the index can't help - it's off or the
+    // query is shorter than a trigram - and everything needs scanning
+    bool Candidates(const std::string& folded, uint64_t firstId, std::vector<uint64_t>& out);
+
+    size_t MemoryBytes() const { return m_memory; }
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    struct SealJob;
+
+    struct Segment
+    {
+        uint64_t firstId = 0;
+        uint32_t lineCount = 0;
+        std::vector<uint64_t> pairs;          // trigram << 16 | line group, until it's packed
+        std::shared_ptr<SealJob> sealing;
+        bool sealed = false;
+        std::vector<uint32_t> keys;           // trigrams, ascending
+        std::vector<uint32_t> starts;         // where each one's list begins in postings, plus the end
+        std::vector<uint8_t> postings;        // line group deltas, 7 bits a byte
+    };
+
+    void Seal(Segment& segment);
+    void IndexLine(Segment& segment, std::string_view text);
+    size_t SegmentMemory(const Segment& segment) const;
+
+    bool m_enabled = false;
+    RingBuffer<Segment> m_segments;
+    uint64_t m_indexedEnd = 0;
+    size_t m_memory = 0;
+    size_t m_budgetedMemory = 0;             // MemoryBytes() the last time Update said to re-budget
+    std::string m_folded;
+    Stats m_stats;
+};
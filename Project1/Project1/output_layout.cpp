@@ -0,0 +1,575 @@
+#include "output_layout.h"
+
+#include "worker_pool.h"
+
+#include "imgui/imgui.h"
+#include "imgui/imgui_internal.h"
+
+#include <cmath>
+#include <shared_mutex>
+
+void RowIndex::Clear()
+{
+    m_rows.clear();
+    m_tree.clear();
+    m_front = 0;
+    m_total = 0;
+}
+
+void RowIndex::Assign(std::vector<uint32_t>&& rows)
+{
+    m_rows = std::move(rows);
+    m_front = 0;
+    m_total = 0;
+    for (uint32_t r : m_rows)
+        m_total += r;
+    Rebuild();
+}
+
+void RowIndex::PushBack(uint32_t rows)
+{
+    if (m_tree.empty())
+        m_tree.push_back(0);
+
+    // node i covers (i - lowbit(i), i], so it's this value plus the entries just before it
+    size_t i = m_rows.size() + 1;
+    size_t lowbit = i & (~i + 1);
+    m_tree.push_back(rows + Prefix(i - 1) - Prefix(i - lowbit));
+    m_rows.push_back(rows);
+    m_total += rows;
+}
+
+void RowIndex::PopFront(size_t count)
+{
+    if (count > Size())
+        count = Size();
+    for (size_t i = 0; i < count; i++)
+        m_total -= m_rows[m_front + i];
+    m_front += count;
+
+    // compact once the dead prefix outgrows the live part, keeps this amortized O(1)
+    if (m_front > 1024 && m_front > Size())
+        Rebuild();
+}
+
+void RowIndex::Set(size_t idx, uint32_t rows)
+{
+    size_t pos = m_front + idx;
+    int64_t delta = (int64_t)rows - (int64_t)m_rows[pos];
+    if (delta == 0)
+        return;
+    m_rows[pos] = rows;
+    m_total += delta;
+    for (size_t i = pos + 1; i < m_tree.size(); i += i & (~i + 1))
+        m_tree[i] += delta;
+}
+
+uint64_t RowIndex::RowOf(size_t idx) const
+{
+    return Prefix(m_front + idx) - Prefix(m_front);
+}
+
+size_t RowIndex::LineAtRow(uint64_t row) const
+{
+    if (Size() == 0)
+        return 0;
+
+    // walk down the tree looking for the last entry whose prefix still fits in target
+    uint64_t remaining = row + Prefix(m_front);
+    size_t n = m_rows.size();
+    size_t pos = 0;
+    size_t step = 1;
+    while (step * 2 <= n)
+        step *= 2;
+    for (; step > 0; step /= 2)
+    {
+        if (pos + step <= n && m_tree[pos + step] <= remaining)
+        {
+            pos += step;
+            remaining -= m_tree[pos];
+        }
+    }
+
+    size_t line = pos - m_front;
+    return line < Size() ? line : Size() - 1;
+}
+
+uint64_t RowIndex::Prefix(size_t count) const
+{
+    uint64_t sum = 0;
+    for (size_t i = count; i > 0; i -= i & (~i + 1))
+        sum += m_tree[i];
+    return sum;
+}
+
+void RowIndex::Rebuild()
+{
+    m_rows.erase(m_rows.begin(), m_rows.begin() + m_front);
+    m_front = 0;
+
+    // O(n) fenwick build: every node pushes its sum up to its parent
+    m_tree.assign(m_rows.size() + 1, 0);
+    for (size_t i = 1; i < m_tree.size(); i++)
+    {
+        m_tree[i] += m_rows[i - 1];
+        size_t parent = i + (i & (~i + 1));
+        if (parent < m_tree.size())
+            m_tree[parent] += m_tree[i];
+    }
+}
+
+void GlyphAdvances::Capture(ImFont* font, float fontSize)
+{
+    // same units CalcWordWrapPosition works in - unscaled baked advances
+    ImFontBaked* baked = font->GetFontBaked(fontSize);
+    scale = fontSize / baked->Size;
+    for (int c = 0; c < 128; c++)
+        advance[c] = baked->GetCharAdvance((ImWchar)c);
+}
+
+namespace
+{
+    enum { kCharOther, kCharBlank, kCharPunct };
+
+    int CharClass(unsigned int c)
+    {
+        if (c == ' ' || c == '\t')
+            return kCharBlank;
+        if (c == '.' || c == ',' || c == ';' || c == '!' || c == '?' || c == '"')
+            return kCharPunct;
+        return kCharOther;
+    }
+
+    // ImFontCalcWordWrapPositionEx, but reading the captured ascii table instead
+    // of the font so it can run off the ui thread. gives up (nullptr) on non-ascii
+    const char* NextWrapAscii(const GlyphAdvances& adv, const char* text, const char* end, float wrapWidth)
+    {
+        float lineWidth = 0.0f;
+        float blankWidth = 0.0f;
+        float spanWidth = 0.0f;
+        wrapWidth /= adv.scale;
+
+        const char* s = text;
+        const char* spanEnd = s;
+        int prevType = kCharOther;
+        while (s < end)
+        {
+            unsigned int c = (unsigned char)*s;
+            if (c >= 0x80)
+                return nullptr;
+            if (c == '\n')
+                return s;
+            if (c == '\r')
+            {
+                s++;
+                continue;
+            }
+
+            float charWidth = adv.advance[c];
+            int type = CharClass(c);
+            if (type == kCharBlank)
+            {
+                if (prevType != kCharBlank)
+                {
+                    spanEnd = s;
+                    lineWidth += spanWidth;
+                    spanWidth = 0.0f;
+                }
+                blankWidth += charWidth;
+            }
+            else
+            {
+                if (prevType == kCharPunct && type != kCharPunct && !(c >= '0' && c <= '9'))
+                {
+                    spanEnd = s;
+                    lineWidth += spanWidth + blankWidth;
+                    spanWidth = blankWidth = 0.0f;
+                }
+                spanWidth += charWidth;
+            }
+
+            if (spanWidth + blankWidth + lineWidth > wrapWidth)
+            {
+                if (spanWidth + blankWidth > wrapWidth)
+                    break;
+                return spanEnd;
+            }
+            prevType = type;
+            s++;
+        }
+
+        // too narrow to fit anything, show one char per row like imgui does
+        if (s == text && text < end)
+            return s + 1;
+        return s;
+    }
+
+    // break a line into rows, storing (row end, next row start) pairs
+    // returns false if nextWrap gave up on the line
+    template <typename NextWrap>
+    bool WrapBreaks(std::string_view line, NextWrap&& nextWrap, std::vector<uint32_t>& out)
+    {
+        const char* base = line.data();
+        const char* end = base + line.size();
+        const char* s = base;
+        while (s < end)
+        {
+            const char* rowEnd = nextWrap(s, end);
+            if (!rowEnd)
+                return false;
+            const char* nextStart = ImTextCalcWordWrapNextLineStart(rowEnd, end);
+            if (nextStart >= end)
+                break;
+            out.push_back((uint32_t)(rowEnd - base));
+            out.push_back((uint32_t)(nextStart - base));
+            s = nextStart;
+        }
+        return true;
+    }
+
+    // lines wrapped per worker chunk before it hands results back
+    const uint64_t kReflowChunk = 4096;
+
+    // below this many lines a relayout just happens inline
+    const size_t kInlineRelayout = 2000;
+
+    // non-ascii lines the worker bounced back, wrapped on the ui thread per frame
+    const size_t kFontLinesPerFrame = 512;
+}
+
+// background re-wrap of everything that was in the scrollback when the width/font changed
+// walks from the newest line to the oldest since that's usually what's on screen
+struct OutputLayout::ReflowJob
+{
+    std::atomic<bool> cancelled{ false };
+    std::atomic<bool> finished{ false };
+    const Scrollback* lines = nullptr;
+    GlyphAdvances advances;
+    float wrapWidth = 0.0f;
+    uint64_t firstId = 0;
+    uint64_t nextEnd = 0;             // worker only
+
+    std::mutex runMutex;              // held by the chunk that's running
+    std::mutex mutex;                 // guards the result vectors
+    std::vector<uint64_t> ids;
+    std::vector<uint32_t> counts;     // breaks per line, UINT32_MAX = needs the real font
+    std::vector<uint32_t> breaks;
+};
+
+void OutputLayout::RunReflowChunk(std::shared_ptr<ReflowJob> job)
+{
+    // held while reading the scrollback, so once CancelReflow returns no chunk touches it again
+    std::unique_lock<std::mutex> run(job->runMutex);
+    if (job->cancelled)
+        return;
+
+    std::vector<uint64_t> ids;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> breaks;
+    uint64_t begin;
+    {
+        std::shared_lock<std::shared_mutex> lock(job->lines->Mutex());
+        uint64_t end = job->nextEnd;
+        begin = end - job->firstId > kReflowChunk ? end - kReflowChunk : job->firstId;
+        uint64_t oldest = job->lines->FirstLineId();
+        if (begin < oldest)
+            begin = end > oldest ? oldest : end;
+
+        ids.reserve((size_t)(end - begin));
+        counts.reserve((size_t)(end - begin));
+        for (uint64_t id = end; id-- > begin;)
+        {
+            std::string_view text = job->lines->Line((size_t)(id - oldest));
+            size_t mark = breaks.size();
+            bool ok = WrapBreaks(text, [&](const char* s, const char* e) {
+                return NextWrapAscii(job->advances, s, e, job->wrapWidth);
+            }, breaks);
+            if (!ok)
+                breaks.resize(mark);
+            ids.push_back(id);
+            counts.push_back(ok ? (uint32_t)((breaks.size() - mark) / 2) : UINT32_MAX);
+        }
+
+        // everything older than the oldest line held is gone, no point going further
+        if (begin <= oldest)
+            begin = job->firstId;
+        job->nextEnd = begin;
+    }
+
+    run.unlock();
+
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->ids.insert(job->ids.end(), ids.begin(), ids.end());
+        job->counts.insert(job->counts.end(), counts.begin(), counts.end());
+        job->breaks.insert(job->breaks.end(), breaks.begin(), breaks.end());
+    }
+
+    if (begin > job->firstId && !job->cancelled)
+        WorkerPool::Shared().Submit([job] { RunReflowChunk(job); });
+    else
+        job->finished = true;
+}
+
+OutputLayout::~OutputLayout()
+{
+    CancelReflow();
+}
+
+void OutputLayout::Sync(const Scrollback& lines, ImFont* font, float fontSize, float wrapWidth)
+{
+    // new width or font means every line needs wrapping again
+    if (font != m_font || fontSize != m_fontSize || wrapWidth != m_wrapWidth)
+    {
+        m_font = font;
+        m_fontSize = fontSize;
+        m_wrapWidth = wrapWidth;
+        m_advances.Capture(font, fontSize);
+        Relayout(lines);
+    }
+
+    // lines evicted (or cleared) from the scrollback
+    if (lines.FirstLineId() > m_firstLineId)
+    {
+        uint64_t gone = lines.FirstLineId() - m_firstLineId;
+        size_t count = gone < m_lines.size() ? (size_t)gone : m_lines.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            const LineWrap& wrap = m_lines.front();
+            if (wrap.state == kWrapped)
+                m_deadBreaks += wrap.count * 2;
+            else
+                m_pendingLines--;
+            m_lines.pop_front();
+        }
+        m_rows.PopFront(count);
+        m_anchorLine = m_anchorLine > count ? m_anchorLine - count : 0;
+        m_firstLineId = lines.FirstLineId();
+    }
+
+    // lines appended since last frame get wrapped as they come in
+    while (m_lines.size() < lines.Size())
+    {
+        m_lines.push_back(LineWrap());
+        m_rows.PushBack(1);
+        m_pendingLines++;
+        WrapNow(lines, m_lines.size() - 1);
+    }
+
+    DrainReflow(lines);
+
+    if (m_deadBreaks > 64 * 1024 && m_deadBreaks > m_breaks.size() / 2)
+        CompactBreaks();
+}
+
+void OutputLayout::EnsureWrapped(const Scrollback& lines, size_t first, size_t last)
+{
+    if (last > m_lines.size())
+        last = m_lines.size();
+    for (size_t i = first; i < last; i++)
+        if (m_lines[i].state != kWrapped)
+            WrapNow(lines, i);
+}
+
+uint64_t OutputLayout::RowOfOffset(const Scrollback& lines, size_t line, uint32_t offset)
+{
+    if (line >= m_lines.size())
+        return m_rows.TotalRows();
+    EnsureWrapped(lines, line, line + 1);
+    // a row ends where the next one starts, so an offset in the spaces a
+    // break swallowed counts as the row after it
+    const LineWrap& wrap = m_lines[line];
+    const uint32_t* breaks = m_breaks.data() + wrap.first;
+    uint32_t row = 0;
+    while (row < wrap.count && breaks[row * 2 + 1] <= offset)
+        row++;
+    return m_rows.RowOf(line) + row;
+}
+
+void OutputLayout::EnsureVisible(const Scrollback& lines, float scrollY, float viewHeight, float rowHeight, bool stickToBottom)
+{
+    if (m_lines.size() == 0 || rowHeight <= 0.0f)
+        return;
+
+    uint64_t rowsInView = (uint64_t)(viewHeight / rowHeight) + 2;
+    uint64_t covered = 0;
+    if (stickToBottom)
+    {
+        // following output, so the view is whatever fits above the last line
+        size_t idx = m_lines.size();
+        while (idx > 0 && covered < rowsInView)
+        {
+            idx--;
+            if (m_lines[idx].state != kWrapped)
+                WrapNow(lines, idx);
+            covered += m_rows.Rows(idx);
+        }
+        m_anchorLine = idx;
+    }
+    else
+    {
+        size_t idx = m_rows.LineAtRow((uint64_t)(scrollY / rowHeight));
+        m_anchorLine = idx;
+        for (; idx < m_lines.size() && covered < rowsInView; idx++)
+        {
+            if (m_lines[idx].state != kWrapped)
+                WrapNow(lines, idx);
+            covered += m_rows.Rows(idx);
+        }
+    }
+}
+
+void OutputLayout::Relayout(const Scrollback& lines)
+{
+    CancelReflow();
+    m_lines.clear();
+    m_breaks.clear();
+    m_deadBreaks = 0;
+    m_fontQueue.clear();
+    m_scrollShift = 0;
+    m_firstLineId = lines.FirstLineId();
+    m_pendingLines = lines.Size();
+
+    // rough row counts from the average glyph width until the real wraps come back
+    float avgAdvance = m_advances.advance['x'] * m_advances.scale;
+    std::vector<uint32_t> estimates(lines.Size());
+    for (size_t i = 0; i < lines.Size(); i++)
+    {
+        m_lines.push_back(LineWrap());
+        float width = lines[i].size() * avgAdvance;
+        estimates[i] = (m_wrapWidth > 0.0f && width > m_wrapWidth) ? (uint32_t)ceilf(width / m_wrapWidth) : 1;
+    }
+    m_rows.Assign(std::move(estimates));
+
+    if (lines.Size() <= kInlineRelayout)
+    {
+        EnsureWrapped(lines, 0, lines.Size());
+        return;
+    }
+
+    m_job = std::make_shared<ReflowJob>();
+    m_job->lines = &lines;
+    m_job->advances = m_advances;
+    m_job->wrapWidth = m_wrapWidth;
+    m_job->firstId = lines.FirstLineId();
+    m_job->nextEnd = lines.EndLineId();
+    std::shared_ptr<ReflowJob> job = m_job;
+    WorkerPool::Shared().Submit([job] { RunReflowChunk(job); });
+}
+
+void OutputLayout::WrapNow(const Scrollback& lines, size_t idx)
+{
+    m_scratch.clear();
+    if (m_wrapWidth > 0.0f)
+    {
+        WrapBreaks(lines[idx], [&](const char* s, const char* e) {
+            return m_font->CalcWordWrapPosition(m_fontSize, s, e, m_wrapWidth);
+        }, m_scratch);
+    }
+    StoreBreaks(idx, m_scratch.data(), (uint32_t)(m_scratch.size() / 2));
+}
+
+void OutputLayout::StoreBreaks(size_t idx, const uint32_t* breaks, uint32_t count)
+{
+    LineWrap& wrap = m_lines[idx];
+    if (wrap.state == kWrapped)
+        m_deadBreaks += wrap.count * 2;
+    else
+        m_pendingLines--;
+
+    wrap.first = (uint32_t)m_breaks.size();
+    wrap.count = count;
+    wrap.state = kWrapped;
+    m_breaks.insert(m_breaks.end(), breaks, breaks + count * 2);
+
+    uint32_t oldRows = m_rows.Rows(idx);
+    m_rows.Set(idx, count + 1);
+    if (idx < m_anchorLine)
+        m_scrollShift += (int64_t)(count + 1) - (int64_t)oldRows;
+}
+
+void OutputLayout::DrainReflow(const Scrollback& lines)
+{
+    if (m_job)
+    {
+        std::vector<uint64_t> ids;
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> breaks;
+        bool finished = m_job->finished;
+        {
+            std::lock_guard<std::mutex> lock(m_job->mutex);
+            ids.swap(m_job->ids);
+            counts.swap(m_job->counts);
+            breaks.swap(m_job->breaks);
+        }
+
+        size_t cursor = 0;
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            uint32_t count = counts[i];
+            const uint32_t* lineBreaks = breaks.data() + cursor;
+            if (count != UINT32_MAX)
+                cursor += count * 2;
+
+            // evicted meanwhile, or already wrapped because it was on screen
+            if (ids[i] < m_firstLineId || ids[i] >= m_firstLineId + m_lines.size())
+                continue;
+            size_t idx = (size_t)(ids[i] - m_firstLineId);
+            if (m_lines[idx].state == kWrapped)
+                continue;
+
+            if (count == UINT32_MAX)
+                m_fontQueue.push_back(ids[i]);
+            else
+                StoreBreaks(idx, lineBreaks, count);
+        }
+
+        if (finished)
+            m_job.reset();
+    }
+
+    // lines the worker couldn't measure go through the real font, a few per frame
+    size_t done = 0;
+    while (!m_fontQueue.empty() && done < kFontLinesPerFrame)
+    {
+        uint64_t id = m_fontQueue.back();
+        m_fontQueue.pop_back();
+        if (id < m_firstLineId || id >= m_firstLineId + m_lines.size())
+            continue;
+        size_t idx = (size_t)(id - m_firstLineId);
+        if (m_lines[idx].state != kWrapped)
+        {
+            WrapNow(lines, idx);
+            done++;
+        }
+    }
+}
+
+void OutputLayout::CompactBreaks()
+{
+    std::vector<uint32_t> live;
+    live.reserve(m_breaks.size() - m_deadBreaks);
+    for (size_t i = 0; i < m_lines.size(); i++)
+    {
+        LineWrap& wrap = m_lines[i];
+        if (wrap.state != kWrapped)
+            continue;
+        uint32_t first = (uint32_t)live.size();
+        live.insert(live.end(), m_breaks.begin() + wrap.first, m_breaks.begin() + wrap.first + wrap.count * 2);
+        wrap.first = first;
+    }
+    m_breaks.swap(live);
+    m_deadBreaks = 0;
+}
+
+void OutputLayout::CancelReflow()
+{
+    if (m_job)
+    {
+        {
+            std::lock_guard<std::mutex> run(m_job->runMutex);
+            m_job->cancelled = true;
+        }
+        m_job.reset();
+    }
+}
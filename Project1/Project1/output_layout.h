@@ -0,0 +1,149 @@
+#pragma once
+
+#include "ring_buffer.h"
+#include "scrollback.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+struct ImFont;
+
+// fenwick tree over how many wrapped rows each output line takes up
+// lets us go row -> line and line -> row in O(log n), which is what the
+// list clipper needs to only lay out the rows that are actually on screen
+class RowIndex
+{
+public:
+    void Clear();
+    void Assign(std::vector<uint32_t>&& rows);   // O(n) bulk build
+    void PushBack(uint32_t rows);
+    void PopFront(size_t count);
+    void Set(size_t idx, uint32_t rows);
+
+    size_t Size() const { return m_rows.size() - m_front; }
+    uint32_t Rows(size_t idx) const { return m_rows[m_front + idx]; }
+    uint64_t TotalRows() const { return m_total; }
+
+    // rows above line idx
+    uint64_t RowOf(size_t idx) const;
+    // line that contains the given row (clamped to the last line)
+    size_t LineAtRow(uint64_t row) const;
+
+private:
+    uint64_t Prefix(size_t count) const;  // sum of the first count stored entries
+    void Rebuild();
+
+    std::vector<uint32_t> m_rows;
+    std::vector<uint64_t> m_tree;         // 1-based fenwick array, m_tree[0] unused
+    size_t m_front = 0;                   // entries popped off the front but not compacted yet
+    uint64_t m_total = 0;
+};
+
+// ascii advance widths copied out of the font on the ui thread, so lines can
+// be wrapped on a worker without touching the (not thread safe) font atlas
+struct GlyphAdvances
+{
+    float advance[128] = {};
+    float scale = 1.0f;
+
+    void Capture(ImFont* font, float fontSize);
+};
+
+// wrapped layout of a pane's scrollback, keyed on content width + font size
+// break offsets get computed once when a line arrives. when the width or font
+// size changes every line falls back to an estimate, the visible ones get
+// re-wrapped right away and a worker re-wraps the rest in the background
+class OutputLayout
+{
+public:
+    ~OutputLayout();
+
+    // catch up with the scrollback (appends, evictions, clears), the wrap settings
+    // and whatever the background reflow finished since last frame
+    void Sync(const Scrollback& lines, ImFont* font, float fontSize, float wrapWidth);
+
+    // make sure lines [first, last) have exact wraps, so what's on screen is right this frame
+    void EnsureWrapped(const Scrollback& lines, size_t first, size_t last);
+
+    // same, but for whatever rows fit in the view at this scroll position
+    void EnsureVisible(const Scrollback& lines, float scrollY, float viewHeight, float rowHeight, bool stickToBottom);
+
+    bool Reflowing() const { return m_pendingLines > 0; }
+
+    // rows that got added/removed above the visible lines by reflow since the
+    // last call - the view scrolls by this much so the text doesn't jump
+    int64_t TakeScrollShift() { int64_t shift = m_scrollShift; m_scrollShift = 0; return shift; }
+
+    uint64_t TotalRows() const { return m_rows.TotalRows(); }
+    uint64_t RowOf(size_t line) const { return m_rows.RowOf(line); }
+    size_t LineAtRow(uint64_t row) const { return m_rows.LineAtRow(row); }
+    uint32_t RowsIn(size_t line) const { return m_rows.Rows(line); }
+
+    // the row a byte offset of a line is on, counted from the top. wraps that
+    // line for real first, so a jump lands on the right row even mid reflow
+    uint64_t RowOfOffset(const Scrollback& lines, size_t line, uint32_t offset);
+
+    // call fn(begin, end) for each row of a line using the cached breaks
+    template <typename Fn>
+    void ForEachRow(size_t idx, std::string_view text, Fn&& fn) const
+    {
+        const char* base = text.data();
+        const LineWrap& wrap = m_lines[idx];
+        if (wrap.state != kWrapped)
+        {
+            // not wrapped yet (only happens off screen), just show it as one row
+            fn(base, base + text.size());
+            return;
+        }
+        const uint32_t* breaks = m_breaks.data() + wrap.first;
+        uint32_t start = 0;
+        for (uint32_t i = 0; i < wrap.count; i++)
+        {
+            fn(base + start, base + breaks[i * 2]);
+            start = breaks[i * 2 + 1];
+        }
+        fn(base + start, base + text.size());
+    }
+
+private:
+    enum : uint8_t { kPending, kWrapped };
+
+    struct LineWrap
+    {
+        uint32_t first = 0;   // index into m_breaks
+        uint32_t count = 0;   // number of breaks, rows = count + 1
+        uint8_t state = kPending;
+    };
+
+    struct ReflowJob;
+    static void RunReflowChunk(std::shared_ptr<ReflowJob> job);
+
+    void Relayout(const Scrollback& lines);
+    void WrapNow(const Scrollback& lines, size_t idx);
+    void StoreBreaks(size_t idx, const uint32_t* breaks, uint32_t count);
+    void DrainReflow(const Scrollback& lines);
+    void CompactBreaks();
+    void CancelReflow();
+
+    RowIndex m_rows;
+    RingBuffer<LineWrap> m_lines;         // parallel to m_rows
+    std::vector<uint32_t> m_breaks;       // (row end, next row start) offset pairs
+    size_t m_deadBreaks = 0;              // entries no live line points at anymore
+    std::vector<uint64_t> m_fontQueue;    // non-ascii lines the worker handed back to us
+    std::vector<uint32_t> m_scratch;
+    size_t m_pendingLines = 0;
+    size_t m_anchorLine = 0;              // first visible line as of the last EnsureVisible
+    int64_t m_scrollShift = 0;
+    std::shared_ptr<ReflowJob> m_job;
+
+    ImFont* m_font = nullptr;
+    float m_fontSize = 0.0f;
+    float m_wrapWidth = 0.0f;
+    GlyphAdvances m_advances;
+    uint64_t m_firstLineId = 0;           // scrollback line id of entry 0
+};
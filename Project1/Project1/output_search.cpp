@@ -0,0 +1,497 @@
+#include "output_search.h"
+#include "output_index.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <shared_mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define OUTPUT_SEARCH_SSE2 1
+#endif
+
+namespace
+{
+    uint32_t FoldCodepoint(uint32_t cp)
+    {
+        if ((cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) ||       // latin-1 capitals, minus the multiplication sign
+            (cp >= 0x391 && cp <= 0x3A9 && cp != 0x3A2) ||    // greek
+            (cp >= 0x410 && cp <= 0x42F))                     // cyrillic
+            return cp + 0x20;
+        if (cp >= 0x400 && cp <= 0x40F)                       // cyrillic with marks
+            return cp + 0x50;
+        return cp;
+    }
+
+    // folds the character at p into out and returns its length (1 or 2, the same
+    // for both). longer sequences and broken bytes go through a byte at a time as is
+    inline size_t FoldChar(const unsigned char* p, const unsigned char* end, unsigned char* out)
+    {
+        unsigned char c = p[0];
+        if (c < 0x80)
+        {
+            out[0] = (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+            return 1;
+        }
+        if ((c & 0xE0) == 0xC0 && end - p >= 2 && (p[1] & 0xC0) == 0x80)
+        {
+            uint32_t cp = FoldCodepoint(((c & 0x1Fu) << 6) | (p[1] & 0x3Fu));
+            out[0] = (unsigned char)(0xC0 | (cp >> 6));
+            out[1] = (unsigned char)(0x80 | (cp & 0x3F));
+            return 2;
+        }
+        out[0] = c;
+        return 1;
+    }
+
+    unsigned char LeadByte(uint32_t cp)
+    {
+        return cp < 0x80 ? (unsigned char)cp : (unsigned char)(0xC0 | (cp >> 6));
+    }
+
+    // lines a worker searches per chunk before handing its hits back
+    const uint64_t kSearchChunk = 8192;
+
+    // below this many lines to look at a search just happens inline
+    const uint64_t kInlineSearch = 20000;
+
+}
+
+template <typename Out>
+void OutputSearch::Matcher::Search(std::string_view line, uint64_t lineId, Out& out)
+{
+    if (!regex)
+    {
+        size_t at = 0;
+        while ((at = text.Find(line, at)) != std::string_view::npos)
+        {
+            out.push_back({ lineId, (uint32_t)at, (uint32_t)text.Length() });
+            at += text.Length();
+        }
+        return;
+    }
+    if (!literal.Empty() && literal.Find(line) == std::string_view::npos)
+        return;
+    re.FindAll(line, spans);
+    for (const Regex::Span& span : spans)
+        out.push_back({ lineId, span.begin, span.end - span.begin });
+}
+
+void FoldText(std::string_view text, std::string& out)
+{
+    const unsigned char* p = (const unsigned char*)text.data();
+    const unsigned char* end = p + text.size();
+    out.resize(text.size());
+    unsigned char* to = (unsigned char*)out.data();
+    while (p < end)
+    {
+        size_t length = FoldChar(p, end, to);
+        p += length;
+        to += length;
+    }
+}
+
+TextPattern::TextPattern(std::string_view pattern)
+{
+    FoldText(pattern, m_folded);
+    if (m_folded.empty())
+        return;
+
+    // whatever folds to the first character can start a match - the folded
+    // byte itself plus the lead byte of each capital that folds to it
+    const unsigned char* first = (const unsigned char*)m_folded.data();
+    uint32_t cp = first[0];
+    if ((first[0] & 0xE0) == 0xC0 && m_folded.size() >= 2 && (first[1] & 0xC0) == 0x80)
+        cp = ((first[0] & 0x1Fu) << 6) | (first[1] & 0x3Fu);
+    size_t count = 0;
+    m_first[count++] = first[0];
+    if (cp < 0x80)
+    {
+        if (cp >= 'a' && cp <= 'z')
+            m_first[count++] = (unsigned char)(cp - 32);
+    }
+    else
+    {
+        for (uint32_t upper : { cp - 0x20, cp - 0x50 })
+        {
+            if (upper >= 0x80 && upper != cp && FoldCodepoint(upper) == cp)
+            {
+                unsigned char lead = LeadByte(upper);
+                if (std::find(m_first, m_first + count, lead) == m_first + count)
+                    m_first[count++] = lead;
+            }
+        }
+    }
+    for (size_t i = count; i < 3; i++)
+        m_first[i] = m_first[0];
+}
+
+bool TextPattern::MatchAt(const char* at, const char* end) const
+{
+    if ((size_t)(end - at) < m_folded.size())
+        return false;
+    const unsigned char* p = (const unsigned char*)at;
+    const unsigned char* textEnd = (const unsigned char*)end;
+    const unsigned char* want = (const unsigned char*)m_folded.data();
+    const unsigned char* wantEnd = want + m_folded.size();
+    unsigned char folded[2];
+    while (want < wantEnd)
+    {
+        size_t length = FoldChar(p, textEnd, folded);
+        if (want + length > wantEnd || folded[0] != want[0] || (length == 2 && folded[1] != want[1]))
+            return false;
+        p += length;
+        want += length;
+    }
+    return true;
+}
+
+size_t TextPattern::Find(std::string_view text, size_t from) const
+{
+    if (m_folded.empty() || from >= text.size() || text.size() - from < m_folded.size())
+        return std::string_view::npos;
+    const char* base = text.data();
+    const char* p = base + from;
+    const char* end = base + text.size();
+    const char* last = end - m_folded.size();   // no match can start past this
+
+#ifdef OUTPUT_SEARCH_SSE2
+    // 16 bytes a go, only positions holding a possible first byte get a real compare
+    const __m128i a = _mm_set1_epi8((char)m_first[0]);
+    const __m128i b = _mm_set1_epi8((char)m_first[1]);
+    const __m128i c = _mm_set1_epi8((char)m_first[2]);
+    while (last - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, a), _mm_cmpeq_epi8(chunk, b)), _mm_cmpeq_epi8(chunk, c));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        while (mask)
+        {
+            const char* at = p + std::countr_zero(mask);
+            if (MatchAt(at, end))
+                return (size_t)(at - base);
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+    for (; p <= last; p++)
+    {
+        unsigned char byte = (unsigned char)*p;
+        if ((byte == m_first[0] || byte == m_first[1] || byte == m_first[2]) && MatchAt(p, end))
+            return (size_t)(p - base);
+    }
+    return std::string_view::npos;
+}
+
+// one search handed to the pool. whichever worker gets there first takes the
+// next chunk, and each chunk's hits get their own slot so the ui can pick them
+// up in order no matter which order they finish in
+struct OutputSearch::SearchJob
+{
+    std::atomic<bool> cancelled{ false };
+    std::shared_mutex runMutex;             // held shared while a chunk reads the scrollback
+    const Scrollback* lines = nullptr;
+    Matcher matcher;
+    uint64_t firstId = 0;                   // the lines to search...
+    uint64_t endId = 0;
+    std::vector<uint64_t> candidates;       // ...or just these, when narrowing
+    size_t chunkCount = 0;
+    std::atomic<size_t> nextChunk{ 0 };
+    std::atomic<size_t> chunksDone{ 0 };
+    std::atomic<uint64_t> linesScanned{ 0 };
+    std::atomic<uint64_t> bytesScanned{ 0 };
+
+    std::mutex mutex;                       // guards the two below
+    std::vector<std::vector<Hit>> results;  // one per chunk
+    std::vector<uint8_t> ready;
+};
+
+OutputSearch::OutputSearch(WorkerPool* pool)
+    : m_pool(pool ? pool : &WorkerPool::Shared())
+{
+}
+
+OutputSearch::~OutputSearch()
+{
+    CancelJob();
+}
+
+void OutputSearch::SearchLine(std::string_view text, uint64_t lineId, RingBuffer<Hit>& out)
+{
+    m_stats.linesScanned++;
+    m_stats.bytesScanned += text.size();
+    m_matcher.Search(text, lineId, out);
+}
+
+void OutputSearch::RunChunk(std::shared_ptr<SearchJob> job, WorkerPool* pool)
+{
+    size_t chunk;
+    std::vector<Hit> hits;
+    {
+        std::shared_lock<std::shared_mutex> run(job->runMutex);
+        if (job->cancelled)
+            return;
+        chunk = job->nextChunk++;
+        if (chunk >= job->chunkCount)
+            return;
+
+        Matcher matcher = job->matcher;
+        std::shared_lock<std::shared_mutex> lock(job->lines->Mutex());
+        const Scrollback& lines = *job->lines;
+        uint64_t oldest = lines.FirstLineId();
+        uint64_t end = lines.EndLineId();
+        uint64_t scanned = 0, bytes = 0;
+        auto search = [&](uint64_t lineId) {
+            // evicted since the search started, nothing to find there any more
+            if (lineId < oldest || lineId >= end)
+                return;
+            std::string_view text = lines[(size_t)(lineId - oldest)];
+            scanned++;
+            bytes += text.size();
+            matcher.Search(text, lineId, hits);
+        };
+        uint64_t begin = chunk * kSearchChunk;
+        if (job->candidates.empty())
+        {
+            uint64_t last = std::min(job->endId, job->firstId + begin + kSearchChunk);
+            for (uint64_t lineId = job->firstId + begin; lineId < last; lineId++)
+                search(lineId);
+        }
+        else
+        {
+            size_t last = (size_t)std::min<uint64_t>(job->candidates.size(), begin + kSearchChunk);
+            for (size_t i = (size_t)begin; i < last; i++)
+                search(job->candidates[i]);
+        }
+        job->linesScanned += scanned;
+        job->bytesScanned += bytes;
+    }
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->results[chunk] = std::move(hits);
+        job->ready[chunk] = 1;
+    }
+    job->chunksDone++;
+
+    // back in the queue instead of looping, so a cancel never waits on more than a chunk
+    if (!job->cancelled && job->nextChunk < job->chunkCount)
+        pool->Submit([job, pool] { RunChunk(job, pool); });
+}
+
+void OutputSearch::StartJob(const Scrollback& lines, std::vector<uint64_t> candidates)
+{
+    auto job = std::make_shared<SearchJob>();
+    job->lines = &lines;
+    job->matcher = m_matcher;
+    job->firstId = lines.FirstLineId();
+    job->endId = lines.EndLineId();
+    uint64_t count = candidates.empty() ? job->endId - job->firstId : candidates.size();
+    job->candidates = std::move(candidates);
+    job->chunkCount = (size_t)((count + kSearchChunk - 1) / kSearchChunk);
+    job->results.resize(job->chunkCount);
+    job->ready.assign(job->chunkCount, 0);
+    // a narrowing pass only re-checks old lines, anything newer still gets scanned after it
+    if (job->candidates.empty())
+        m_scannedEnd = job->endId;
+
+    m_job = job;
+    m_drained = 0;
+    m_stats.background++;
+    size_t runners = std::min<size_t>(m_pool->Threads(), job->chunkCount);
+    for (size_t i = 0; i < runners; i++)
+        m_pool->Submit([job, pool = m_pool] { RunChunk(job, pool); });
+}
+
+void OutputSearch::CancelJob()
+{
+    if (!m_job)
+        return;
+    {
+        // waits out any chunk still reading the scrollback
+        std::unique_lock<std::shared_mutex> run(m_job->runMutex);
+        m_job->cancelled = true;
+    }
+    m_stats.linesScanned += m_job->linesScanned;
+    m_stats.bytesScanned += m_job->bytesScanned;
+    m_stats.cancelled++;
+    m_job.reset();
+}
+
+bool OutputSearch::DrainJob(uint64_t firstId)
+{
+    bool changed = false;
+    {
+        // only the finished chunks at the front - a later one has to wait for
+        // the ones before it so the hits stay in line order
+        std::lock_guard<std::mutex> lock(m_job->mutex);
+        while (m_drained < m_job->chunkCount && m_job->ready[m_drained])
+        {
+            for (const Hit& hit : m_job->results[m_drained])
+            {
+                if (hit.lineId >= firstId)
+                {
+                    m_hits.push_back(hit);
+                    changed = true;
+                }
+            }
+            std::vector<Hit>().swap(m_job->results[m_drained]);
+            m_drained++;
+        }
+    }
+    if (m_drained == m_job->chunkCount)
+    {
+        m_stats.linesScanned += m_job->linesScanned;
+        m_stats.bytesScanned += m_job->bytesScanned;
+        m_job.reset();
+        changed = true;   // Searching() flipped
+    }
+    return changed;
+}
+
+float OutputSearch::Progress() const
+{
+    if (!m_job || m_job->chunkCount == 0)
+        return 1.0f;
+    return (float)m_job->chunksDone / (float)m_job->chunkCount;
+}
+
+bool OutputSearch::Update(const Scrollback& lines, std::string_view query, OutputIndex* index, bool regex)
+{
+    m_stats.updates++;
+    bool changed = false;
+
+    // lines that scrolled out of the budget (or got cleared) take their hits with them
+    uint64_t firstId = lines.FirstLineId();
+    while (!m_hits.empty() && m_hits.front().lineId < firstId)
+    {
+        m_hits.pop_front();
+        changed = true;
+    }
+    m_scannedEnd = std::max(m_scannedEnd, firstId);
+
+    if (query != m_query || regex != m_matcher.regex)
+    {
+        // whatever was still running was for the old query
+        bool complete = !m_job;
+        CancelJob();
+
+        Matcher matcher;
+        matcher.regex = regex;
+        m_error.clear();
+        if (!regex)
+            matcher.text = TextPattern(query);
+        else if (!query.empty() && matcher.re.Compile(query, true, &m_error))
+            matcher.literal = TextPattern(matcher.re.RequiredLiteral());
+        // a line can only have the new query in it if it had the old one
+        bool narrow = complete && !regex && !m_matcher.regex && !m_matcher.Empty() && !matcher.Empty() &&
+            matcher.text.Folded().find(m_matcher.text.Folded()) != std::string::npos;
+        m_query.assign(query.data(), query.size());
+        m_matcher = std::move(matcher);
+        changed = true;
+
+        if (narrow)
+        {
+            m_stats.narrowed++;
+            std::vector<uint64_t> candidates;
+            for (size_t i = 0; i < m_hits.size(); i++)
+            {
+                if (candidates.empty() || candidates.back() != m_hits[i].lineId)
+                    candidates.push_back(m_hits[i].lineId);
+            }
+            m_hits.clear();
+            if (candidates.size() > kInlineSearch)
+                StartJob(lines, std::move(candidates));
+            else
+            {
+                for (uint64_t lineId : candidates)
+                    SearchLine(lines[(size_t)(lineId - firstId)], lineId, m_hits);
+            }
+        }
+        else
+        {
+            m_hits.clear();
+            m_scannedEnd = firstId;
+            std::vector<uint64_t> candidates;
+            const std::string& required = m_matcher.regex ? m_matcher.re.RequiredLiteral() : m_matcher.text.Folded();
+            if (m_matcher.Empty())
+                ;
+            else if (index && index->Candidates(required, firstId, candidates))
+            {
+                // everything the index has seen is settled by its candidates,
+                // whatever it hasn't got to yet gets scanned below
+                m_stats.rescans++;
+                m_stats.indexed++;
+                m_scannedEnd = std::max(firstId, index->IndexedEnd());
+                if (candidates.size() > kInlineSearch)
+                    StartJob(lines, std::move(candidates));
+                else
+                {
+                    for (uint64_t lineId : candidates)
+                        SearchLine(lines[(size_t)(lineId - firstId)], lineId, m_hits);
+                }
+            }
+            else
+            {
+                m_stats.rescans++;
+                if (lines.EndLineId() - firstId > kInlineSearch)
+                    StartJob(lines, {});
+            }
+        }
+    }
+
+    if (m_job)
+        changed |= DrainJob(firstId);
+
+    // whatever came in since last time. while a job runs new lines wait so
+    // they land after its hits
+    if (!m_job && m_matcher.Empty())
+        m_scannedEnd = lines.EndLineId();
+    else if (!m_job)
+    {
+        size_t before = m_hits.size();
+        for (uint64_t lineId = m_scannedEnd; lineId < lines.EndLineId(); lineId++)
+            SearchLine(lines[(size_t)(lineId - firstId)], lineId, m_hits);
+        m_scannedEnd = lines.EndLineId();
+        changed |= m_hits.size() != before;
+    }
+    m_hitLinesStale |= changed;
+    return changed;
+}
+
+const std::vector<uint64_t>& OutputSearch::HitLines()
+{
+    if (m_hitLinesStale)
+    {
+        m_hitLines.clear();
+        for (size_t i = 0; i < m_hits.size(); i++)
+        {
+            if (m_hitLines.empty() || m_hitLines.back() != m_hits[i].lineId)
+                m_hitLines.push_back(m_hits[i].lineId);
+        }
+        m_hitLinesStale = false;
+    }
+    return m_hitLines;
+}
+
+size_t OutputSearch::FirstHitAtOrAfter(uint64_t lineId) const
+{
+    size_t lo = 0, hi = m_hits.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (m_hits[mid].lineId < lineId)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+std::pair<size_t, size_t> OutputSearch::HitsOn(uint64_t lineId) const
+{
+    return { FirstHitAtOrAfter(lineId), FirstHitAtOrAfter(lineId + 1) };
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "regex_dfa.h"
+#include "ring_buffer.h"
+#include "scrollback.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class OutputIndex;
+class WorkerPool;
+
+// the folded copy a TextPattern compares against - same length as text
+void FoldText(std::string_view text, std::string& out);
+
+// case insensitive substring matching straight on the scrollback bytes -
+// nothing gets copied or lowercased up front. folding covers ascii and the
+// two byte latin-1, greek and cyrillic letters, which all fold to something
+// the same length, so a match in the folded text is the same bytes in the real one
+class TextPattern
+{
+public:
+    TextPattern() = default;
+    explicit TextPattern(std::string_view pattern);
+
+    bool Empty() const { return m_folded.empty(); }
+    const std::string& Folded() const { return m_folded; }
+    size_t Length() const { return m_folded.size(); }   // bytes a match covers
+
+    // first match at or after from, npos if there isn't one
+    size_t Find(std::string_view text, size_t from = 0) const;
+
+private:
+    bool MatchAt(const char* at, const char* end) const;
+
+    std::string m_folded;
+    unsigned char m_first[3] = {};    // bytes a match can start with, repeats if fewer
+};
+
+// ctrl+f over one pane's scrollback, kept up to date as the query gets typed
+// and output comes in. the query is a plain string or, in regex mode, a
+// Regex. a query that contains the last one only re-checks the lines that
+// matched before, new lines get scanned as they arrive and hits on lines
+// that scroll out of the budget get dropped
+//
+// a big scrollback gets searched on the worker pool instead - the lines are
+// cut into chunks that every worker pulls from, and the hits come back a
+// chunk at a time in line order, so the count fills in while it runs. typing
+// again cancels whatever hasn't started yet
+class OutputSearch
+{
+public:
+    struct Hit
+    {
+        uint64_t lineId;          // Scrollback line id
+        uint32_t offset;          // bytes into the line
+        uint32_t length;
+    };
+
+    struct Stats
+    {
+        uint64_t updates = 0;
+        uint64_t rescans = 0;         // query changed, every line searched again
+        uint64_t narrowed = 0;        // query got longer, only old hits re-checked
+        uint64_t linesScanned = 0;
+        uint64_t bytesScanned = 0;
+        uint64_t indexed = 0;         // full scans the OutputIndex narrowed down to candidate lines
+        uint64_t background = 0;      // searches that went to the worker pool
+        uint64_t cancelled = 0;       // ...and got dropped for a newer query
+    };
+
+    explicit OutputSearch(WorkerPool* pool = nullptr);  // nullptr = WorkerPool::Shared()
+    ~OutputSearch();
+
+    OutputSearch(const OutputSearch&) = delete;
+    OutputSearch& operator=(const OutputSearch&) = delete;
+
+    // cheap when neither the query nor the scrollback changed. true if Hits() changed.
+    // also where background results get picked up, so call it every frame while one runs.
+    // with an index, a new query only checks the lines it says could match
+    bool Update(const Scrollback& lines, std::string_view query, OutputIndex* index = nullptr, bool regex = false);
+
+    bool RegexMode() const { return m_matcher.regex; }
+    // why the regex didn't compile, empty when it did
+    const std::string& Error() const { return m_error; }
+
+    // a background search is still going - Hits() so far are all in order,
+    // just not everything yet. Progress() is 0..1 of the lines it has to get through
+    bool Searching() const { return m_job != nullptr; }
+    float Progress() const;
+
+    const std::string& Query() const { return m_query; }
+    size_t HitCount() const { return m_hits.size(); }
+    const Hit& HitAt(size_t idx) const { return m_hits[idx]; }
+
+    // [first, last) of the hits on one line, for highlighting
+    std::pair<size_t, size_t> HitsOn(uint64_t lineId) const;
+
+    // every line with a hit on it, ascending - what the output filter shows
+    const std::vector<uint64_t>& HitLines();
+
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    struct SearchJob;
+
+    // what the query turned into. the workers each take a copy, since a
+    // regex builds its DFA as it goes
+    struct Matcher
+    {
+        bool regex = false;
+        TextPattern text;
+        Regex re;
+        TextPattern literal;          // something every regex match has in it, to skip lines quickly
+        std::vector<Regex::Span> spans;
+
+        bool Empty() const { return regex ? !re.Valid() : text.Empty(); }
+        template <typename Out>
+        void Search(std::string_view line, uint64_t lineId, Out& out);
+    };
+
+    size_t FirstHitAtOrAfter(uint64_t lineId) const;
+    void SearchLine(std::string_view text, uint64_t lineId, RingBuffer<Hit>& out);
+    static void RunChunk(std::shared_ptr<SearchJob> job, WorkerPool* pool);
+    void StartJob(const Scrollback& lines, std::vector<uint64_t> candidates);
+    void CancelJob();
+    bool DrainJob(uint64_t firstId);
+
+    WorkerPool* m_pool;
+    std::string m_query;
+    Matcher m_matcher;
+    std::string m_error;
+    RingBuffer<Hit> m_hits;           // by line id, then offset
+    std::vector<uint64_t> m_hitLines;
+    bool m_hitLinesStale = false;
+    uint64_t m_scannedEnd = 0;        // lines before this id have been searched
+    std::shared_ptr<SearchJob> m_job;
+    size_t m_drained = 0;             // chunks of m_job already moved into m_hits
+    Stats m_stats;
+};
@@ -0,0 +1,344 @@
+#include "process.h"
+
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+ChildProcess::~ChildProcess()
+{
+    if (m_started && !m_exited)
+    {
+        Kill();
+        Wait();
+    }
+    Close();
+}
+
+bool ChildProcess::Start(const std::string& commandLine, const SpawnContext& context)
+{
+    return Spawn(commandLine, false, context);
+}
+
+bool ChildProcess::StartShell(const SpawnContext& context)
+{
+    return Spawn(std::string(), true, context);
+}
+
+#ifdef _WIN32
+
+bool ChildProcess::Spawn(const std::string& commandLine, bool shell, const SpawnContext& context)
+{
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.bInheritHandle = TRUE;
+    sa.lpSecurityDescriptor = NULL;
+
+    HANDLE hRead, hWrite;
+    if (!CreatePipe(&hRead, &hWrite, &sa, 0))
+    {
+        m_error = (int)GetLastError();
+        return false;
+    }
+    // only the child's ends get inherited, otherwise we never see EOF
+    SetHandleInformation(hRead, HANDLE_FLAG_INHERIT, 0);
+
+    HANDLE hInRead = NULL, hInWrite = NULL;
+    if (shell)
+    {
+        if (!CreatePipe(&hInRead, &hInWrite, &sa, 0))
+        {
+            m_error = (int)GetLastError();
+            CloseHandle(hRead);
+            CloseHandle(hWrite);
+            return false;
+        }
+        SetHandleInformation(hInWrite, HANDLE_FLAG_INHERIT, 0);
+    }
+
+    STARTUPINFOA si = { sizeof(STARTUPINFOA) };
+    si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+    si.hStdInput = hInRead;
+    si.hStdOutput = hWrite;
+    si.hStdError = hWrite;
+    si.wShowWindow = SW_HIDE;
+
+    PROCESS_INFORMATION pi = { 0 };
+
+    // CreateProcess wants a writable command line
+    // /q keeps the shell from echoing the commands we feed it, /d skips autorun
+    std::string fullCmd = shell ? "cmd.exe /q /d" : "cmd.exe /c " + commandLine;
+    std::vector<char> cmdLine(fullCmd.begin(), fullCmd.end());
+    cmdLine.push_back('\0');
+
+    // start suspended so it's in the job before it can spawn anything
+    BOOL success = CreateProcessA(
+        NULL,
+        cmdLine.data(),
+        NULL,
+        NULL,
+        TRUE,
+        CREATE_SUSPENDED | CREATE_NO_WINDOW,
+        context.env.Block(),
+        context.cwd.empty() ? NULL : context.cwd.c_str(),
+        &si,
+        &pi
+    );
+    CloseHandle(hWrite);
+    if (hInRead)
+        CloseHandle(hInRead);
+
+    if (!success)
+    {
+        m_error = (int)GetLastError();
+        CloseHandle(hRead);
+        if (hInWrite)
+            CloseHandle(hInWrite);
+        return false;
+    }
+
+    HANDLE job = CreateJobObjectA(NULL, NULL);
+    if (job)
+        AssignProcessToJobObject(job, pi.hProcess);
+    ResumeThread(pi.hThread);
+    CloseHandle(pi.hThread);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_process = pi.hProcess;
+    m_job = job;
+    m_read = hRead;
+    m_write = hInWrite;
+    m_started = true;
+    return true;
+}
+
+size_t ChildProcess::Read(char* buffer, size_t size)
+{
+    DWORD bytesRead = 0;
+    if (!m_read || !ReadFile(m_read, buffer, (DWORD)size, &bytesRead, NULL))
+        return 0;  // ERROR_BROKEN_PIPE once the child and its children are gone
+    return bytesRead;
+}
+
+bool ChildProcess::Write(std::string_view data)
+{
+    // not under the lock - a child that isn't reading leaves WriteFile blocked
+    // on a full pipe, and Kill needs the lock to get it unstuck. the handle
+    // only gets closed by the destructor
+    HANDLE write;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        write = m_write;
+    }
+    while (write && !data.empty())
+    {
+        DWORD written = 0;
+        if (!WriteFile(write, data.data(), (DWORD)data.size(), &written, NULL))
+            return false;
+        data.remove_prefix(written);
+    }
+    return write != nullptr;
+}
+
+int ChildProcess::Wait()
+{
+    if (m_started && !m_exited)
+    {
+        WaitForSingleObject(m_process, INFINITE);
+        DWORD exitCode = 0;
+        GetExitCodeProcess(m_process, &exitCode);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exitCode = (int)exitCode;
+        m_exited = true;
+    }
+    return m_exitCode;
+}
+
+void ChildProcess::Kill()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_started || m_exited)
+        return;
+    if (m_job)
+        TerminateJobObject(m_job, 1);
+    else
+        TerminateProcess(m_process, 1);
+}
+
+void ChildProcess::Close()
+{
+    if (m_read) { CloseHandle(m_read); m_read = nullptr; }
+    if (m_write) { CloseHandle(m_write); m_write = nullptr; }
+    if (m_job) { CloseHandle(m_job); m_job = nullptr; }
+    if (m_process) { CloseHandle(m_process); m_process = nullptr; }
+}
+
+#else
+
+bool ChildProcess::Spawn(const std::string& commandLine, bool shell, const SpawnContext& context)
+{
+    int out[2];
+    if (pipe(out) != 0)
+    {
+        m_error = errno;
+        return false;
+    }
+    fcntl(out[0], F_SETFD, FD_CLOEXEC);
+
+    int in[2] = { -1, -1 };
+    if (shell)
+    {
+        // a shell that died under us should fail the Write, not kill the terminal
+        signal(SIGPIPE, SIG_IGN);
+        if (pipe(in) != 0)
+        {
+            m_error = errno;
+            close(out[0]);
+            close(out[1]);
+            return false;
+        }
+        fcntl(in[1], F_SETFD, FD_CLOEXEC);
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (shell)
+    {
+        posix_spawn_file_actions_adddup2(&actions, in[0], 0);
+        posix_spawn_file_actions_addclose(&actions, in[0]);
+    }
+    else
+    {
+        posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    }
+    posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 2);
+    posix_spawn_file_actions_addclose(&actions, out[1]);
+    if (!context.cwd.empty())
+        posix_spawn_file_actions_addchdir_np(&actions, context.cwd.c_str());
+
+    // own process group so Kill takes down the whole pipeline
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    std::string cmd = commandLine;
+    char sh[] = "/bin/sh";
+    char dashC[] = "-c";
+    char* oneShot[] = { sh, dashC, cmd.data(), nullptr };
+    char* interactive[] = { sh, nullptr };
+    pid_t pid;
+    char* const* envp = context.env.Empty() ? environ : context.env.Block();
+    int err = posix_spawn(&pid, "/bin/sh", &actions, &attr, shell ? interactive : oneShot, envp);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    close(out[1]);
+    if (shell)
+        close(in[0]);
+
+    if (err != 0)
+    {
+        m_error = err;
+        close(out[0]);
+        if (shell)
+            close(in[1]);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pid = pid;
+    m_read = out[0];
+    m_write = in[1];
+    m_started = true;
+    return true;
+}
+
+size_t ChildProcess::Read(char* buffer, size_t size)
+{
+    for (;;)
+    {
+        ssize_t n = read(m_read, buffer, size);
+        if (n >= 0)
+            return (size_t)n;
+        if (errno != EINTR)
+            return 0;
+    }
+}
+
+bool ChildProcess::Write(std::string_view data)
+{
+    // same as windows, a blocked write mustn't hold up Kill
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        fd = m_write;
+    }
+    while (fd >= 0 && !data.empty())
+    {
+        ssize_t n = write(fd, data.data(), data.size());
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data.remove_prefix((size_t)n);
+    }
+    return fd >= 0;
+}
+
+int ChildProcess::Wait()
+{
+    if (m_started && !m_exited)
+    {
+        // wait without reaping first, the pid can't be reused until we reap it
+        // so Kill never signals some unrelated process group
+        siginfo_t info;
+        while (waitid(P_PID, (id_t)m_pid, &info, WEXITED | WNOWAIT) < 0 && errno == EINTR)
+            ;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int status = 0;
+        while (waitpid(m_pid, &status, 0) < 0 && errno == EINTR)
+            ;
+        // same convention as the shell, 128 + signal for killed children
+        m_exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        m_exited = true;
+    }
+    return m_exitCode;
+}
+
+void ChildProcess::Kill()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_started && !m_exited)
+        kill(-m_pid, SIGKILL);
+}
+
+void ChildProcess::Close()
+{
+    if (m_read >= 0)
+    {
+        close(m_read);
+        m_read = -1;
+    }
+    if (m_write >= 0)
+    {
+        close(m_write);
+        m_write = -1;
+    }
+}
+
+#endif
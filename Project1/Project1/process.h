@@ -0,0 +1,73 @@
+#pragma once
+
+#include "environment.h"
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// where a child starts and what it sees - empty cwd / env means inherit ours,
+// so two panes can run things in different places without touching global state
+struct SpawnContext
+{
+    std::string cwd;
+    Environment env;
+};
+
+// a child process with stdout and stderr merged into one pipe we read from.
+// windows goes through CreateProcess, everything else through posix_spawn,
+// so the streaming code built on top runs on either
+//
+// Read/Wait block, so they belong on a background thread. Kill and Write are
+// safe to call from another thread while one of them is blocked
+class ChildProcess
+{
+public:
+    ChildProcess() = default;
+    ~ChildProcess();
+
+    ChildProcess(const ChildProcess&) = delete;
+    ChildProcess& operator=(const ChildProcess&) = delete;
+
+    // run one command line through the platform shell (cmd.exe /c or /bin/sh -c)
+    // returns false if it couldn't be started, Error() has the os error code
+    bool Start(const std::string& commandLine, const SpawnContext& context = SpawnContext());
+
+    // start the platform shell itself (cmd.exe or /bin/sh) reading commands from a pipe
+    bool StartShell(const SpawnContext& context = SpawnContext());
+
+    int Error() const { return m_error; }
+
+    // blocks until there's output, returns 0 once every writer has closed the pipe
+    size_t Read(char* buffer, size_t size);
+
+    // send bytes to the child's stdin (StartShell only)
+    bool Write(std::string_view data);
+
+    // wait for the child to exit and return its exit code
+    int Wait();
+
+    // kill the child and anything it started
+    void Kill();
+
+private:
+    bool Spawn(const std::string& commandLine, bool shell, const SpawnContext& context);
+    void Close();
+
+#ifdef _WIN32
+    void* m_process = nullptr;
+    void* m_job = nullptr;          // job object so Kill takes grandchildren down too
+    void* m_read = nullptr;
+    void* m_write = nullptr;
+#else
+    int m_pid = -1;
+    int m_read = -1;
+    int m_write = -1;
+#endif
+    std::mutex m_mutex;             // Kill/Write vs Start/Wait on the reading thread
+    int m_error = 0;
+    int m_exitCode = 0;
+    bool m_started = false;
+    bool m_exited = false;
+};
@@ -0,0 +1,842 @@
+#include "regex_dfa.h"
+
+#include <algorithm>
+#include <bitset>
+
+namespace
+{
+    // bytes plus the two ends of the line, which ^ and $ consume like any other symbol
+    constexpr int kSymbols = 258;
+    constexpr int kLineStart = 256;
+    constexpr int kLineEnd = 257;
+
+    constexpr int32_t kUnknown = -2;
+    constexpr int32_t kDead = -1;
+
+    // past this many DFA states the cache gets thrown away and rebuilt as it goes
+    constexpr size_t kMaxDfaStates = 2048;
+    // repeats get expanded, so {1000} on something big could get silly
+    constexpr size_t kMaxNfaStates = 20000;
+    constexpr int kMaxRepeat = 1000;
+
+    using SymbolSet = std::bitset<kSymbols>;
+
+    struct Node
+    {
+        enum Kind { Empty, Set, Concat, Alternate, Repeat } kind = Empty;
+        int set = -1;
+        int min = 0;
+        int max = -1;                   // -1 = no limit
+        std::vector<Node> children;
+    };
+
+    class Parser
+    {
+    public:
+        Parser(std::string_view pattern, bool ignoreCase, std::vector<SymbolSet>& sets)
+            : m_text(pattern), m_ignoreCase(ignoreCase), m_sets(sets)
+        {
+        }
+
+        bool Parse(Node& root, std::string& error)
+        {
+            if (ParseAlternate(root) && m_pos < m_text.size())
+                Fail("unmatched )");
+            if (!m_error.empty())
+            {
+                error = m_error;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        bool Fail(const char* message)
+        {
+            if (m_error.empty())
+                m_error = message;
+            return false;
+        }
+
+        bool More() const { return m_pos < m_text.size(); }
+        char Peek() const { return m_text[m_pos]; }
+
+        int AddSet(SymbolSet set)
+        {
+            if (m_ignoreCase)
+            {
+                for (int c = 'a'; c <= 'z'; c++)
+                {
+                    if (set[c] || set[c - 32])
+                    {
+                        set[c] = true;
+                        set[c - 32] = true;
+                    }
+                }
+            }
+            m_sets.push_back(set);
+            return (int)m_sets.size() - 1;
+        }
+
+        static Node SetNode(int set)
+        {
+            Node node;
+            node.kind = Node::Set;
+            node.set = set;
+            return node;
+        }
+
+        bool ParseAlternate(Node& out)
+        {
+            Node first;
+            if (!ParseConcat(first))
+                return false;
+            if (!More() || Peek() != '|')
+            {
+                out = std::move(first);
+                return true;
+            }
+            out = Node();
+            out.kind = Node::Alternate;
+            out.children.push_back(std::move(first));
+            while (More() && Peek() == '|')
+            {
+                m_pos++;
+                Node next;
+                if (!ParseConcat(next))
+                    return false;
+                out.children.push_back(std::move(next));
+            }
+            return true;
+        }
+
+        bool ParseConcat(Node& out)
+        {
+            out = Node();
+            out.kind = Node::Concat;
+            while (More() && Peek() != '|' && Peek() != ')')
+            {
+                Node atom;
+                if (!ParseRepeat(atom))
+                    return false;
+                out.children.push_back(std::move(atom));
+            }
+            if (out.children.size() == 1)
+                out = std::move(out.children[0]);
+            else if (out.children.empty())
+                out.kind = Node::Empty;
+            return true;
+        }
+
+        bool ParseNumber(int& value)
+        {
+            if (!More() || Peek() < '0' || Peek() > '9')
+                return false;
+            value = 0;
+            while (More() && Peek() >= '0' && Peek() <= '9')
+            {
+                value = value * 10 + (Peek() - '0');
+                if (value > kMaxRepeat)
+                    return Fail("repeat count too big");
+                m_pos++;
+            }
+            return true;
+        }
+
+        bool ParseRepeat(Node& out)
+        {
+            if (!ParseAtom(out))
+                return false;
+            while (More())
+            {
+                int min, max;
+                char c = Peek();
+                if (c == '*')
+                    min = 0, max = -1;
+                else if (c == '+')
+                    min = 1, max = -1;
+                else if (c == '?')
+                    min = 0, max = 1;
+                else if (c == '{')
+                {
+                    // not a valid count means it was just a brace
+                    size_t at = m_pos;
+                    m_pos++;
+                    if (!ParseNumber(min))
+                    {
+                        if (!m_error.empty())
+                            return false;
+                        m_pos = at;
+                        break;
+                    }
+                    max = min;
+                    if (More() && Peek() == ',')
+                    {
+                        m_pos++;
+                        max = -1;
+                        if (More() && Peek() != '}' && !ParseNumber(max))
+                            return Fail("bad {m,n} repeat");
+                    }
+                    if (!More() || Peek() != '}')
+                        return Fail("missing } in repeat");
+                    if (max >= 0 && max < min)
+                        return Fail("{m,n} repeat with n below m");
+                }
+                else
+                    break;
+                m_pos++;
+                // lazy makes no difference when the longest match wins anyway
+                if (More() && Peek() == '?')
+                    m_pos++;
+                if (out.kind == Node::Empty)
+                    return Fail("nothing to repeat");
+                Node repeat;
+                repeat.kind = Node::Repeat;
+                repeat.min = min;
+                repeat.max = max;
+                repeat.children.push_back(std::move(out));
+                out = std::move(repeat);
+            }
+            return true;
+        }
+
+        // \d and friends, on their own or inside []
+        bool ParseEscape(SymbolSet& set)
+        {
+            if (!More())
+                return Fail("trailing \\");
+            char c = m_text[m_pos++];
+            SymbolSet bytes;
+            bool negate = false;
+            switch (c)
+            {
+            case 'D': negate = true; [[fallthrough]];
+            case 'd':
+                for (int b = '0'; b <= '9'; b++) bytes[b] = true;
+                break;
+            case 'W': negate = true; [[fallthrough]];
+            case 'w':
+                for (int b = 0; b < 256; b++) bytes[b] = (b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || (b >= '0' && b <= '9') || b == '_';
+                break;
+            case 'S': negate = true; [[fallthrough]];
+            case 's':
+                for (int b : { ' ', '\t', '\n', '\r', '\f', '\v' }) bytes[b] = true;
+                break;
+            case 't': bytes['\t'] = true; break;
+            case 'n': bytes['\n'] = true; break;
+            case 'r': bytes['\r'] = true; break;
+            case 'x':
+            {
+                int value = 0;
+                for (int i = 0; i < 2; i++)
+                {
+                    char h = More() ? m_text[m_pos++] : 0;
+                    int digit = h >= '0' && h <= '9' ? h - '0' : h >= 'a' && h <= 'f' ? h - 'a' + 10 : h >= 'A' && h <= 'F' ? h - 'A' + 10 : -1;
+                    if (digit < 0)
+                        return Fail("\\x needs two hex digits");
+                    value = value * 16 + digit;
+                }
+                bytes[value] = true;
+                break;
+            }
+            case 'b': case 'B': case 'A': case 'z': case 'Z':
+                return Fail("word boundaries and \\A \\z aren't supported");
+            default:
+                if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+                    return Fail("unknown escape");
+                bytes[(unsigned char)c] = true;
+                break;
+            }
+            if (negate)
+            {
+                for (int b = 0; b < 256; b++)
+                    bytes[b] = !bytes[b];
+            }
+            set |= bytes;
+            return true;
+        }
+
+        bool ParseClass(SymbolSet& set)
+        {
+            bool negate = More() && Peek() == '^';
+            if (negate)
+                m_pos++;
+            bool first = true;
+            while (More() && (Peek() != ']' || first))
+            {
+                first = false;
+                int low;
+                if (Peek() == '\\')
+                {
+                    m_pos++;
+                    // a class escape can't be one end of a range
+                    SymbolSet escaped;
+                    if (!ParseEscape(escaped))
+                        return false;
+                    if (escaped.count() != 1 || !More() || Peek() != '-')
+                    {
+                        set |= escaped;
+                        continue;
+                    }
+                    low = 0;
+                    while (!escaped[low])
+                        low++;
+                }
+                else
+                    low = (unsigned char)m_text[m_pos++];
+                int high = low;
+                if (m_pos + 1 < m_text.size() && Peek() == '-' && m_text[m_pos + 1] != ']')
+                {
+                    m_pos++;
+                    high = (unsigned char)m_text[m_pos++];
+                    if (high == '\\')
+                    {
+                        SymbolSet escaped;
+                        if (!ParseEscape(escaped) || escaped.count() != 1)
+                            return Fail("bad range in []");
+                        high = 0;
+                        while (!escaped[high])
+                            high++;
+                    }
+                    if (high < low)
+                        return Fail("backwards range in []");
+                }
+                for (int b = low; b <= high; b++)
+                    set[b] = true;
+            }
+            if (!More())
+                return Fail("missing ]");
+            m_pos++;
+            if (negate)
+            {
+                // case folding has to happen before flipping it, or [^a] would still match A
+                if (m_ignoreCase)
+                {
+                    for (int c = 'a'; c <= 'z'; c++)
+                    {
+                        if (set[c] || set[c - 32])
+                        {
+                            set[c] = true;
+                            set[c - 32] = true;
+                        }
+                    }
+                }
+                for (int b = 0; b < 256; b++)
+                    set[b] = !set[b];
+            }
+            return true;
+        }
+
+        bool ParseAtom(Node& out)
+        {
+            char c = m_text[m_pos++];
+            SymbolSet set;
+            switch (c)
+            {
+            case '(':
+                if (m_pos + 1 < m_text.size() && Peek() == '?' && m_text[m_pos + 1] == ':')
+                    m_pos += 2;
+                if (!ParseAlternate(out))
+                    return false;
+                if (!More() || Peek() != ')')
+                    return Fail("missing )");
+                m_pos++;
+                return true;
+            case '*': case '+': case '?':
+                return Fail("nothing to repeat");
+            case '[':
+                if (!ParseClass(set))
+                    return false;
+                break;
+            case '.':
+                for (int b = 0; b < 256; b++)
+                    set[b] = true;
+                break;
+            case '^':
+                set[kLineStart] = true;
+                break;
+            case '$':
+                set[kLineEnd] = true;
+                break;
+            case '\\':
+                if (!ParseEscape(set))
+                    return false;
+                break;
+            default:
+                set[(unsigned char)c] = true;
+                break;
+            }
+            out = SetNode(AddSet(set));
+            return true;
+        }
+
+        std::string_view m_text;
+        size_t m_pos = 0;
+        bool m_ignoreCase;
+        std::vector<SymbolSet>& m_sets;
+        std::string m_error;
+    };
+}
+
+struct Regex::Program
+{
+    struct State
+    {
+        enum Kind : uint8_t { Symbol, Split, Match } kind;
+        int set;                        // Symbol: what it takes
+        int out;
+        int out1;                       // Split: the other way
+    };
+
+    std::vector<SymbolSet> sets;
+    std::vector<State> forward;
+    std::vector<State> reverse;         // same thing with every concatenation backwards
+    int forwardStart = 0;
+    int reverseStart = 0;
+
+    // symbols no set tells apart share a class, which keeps the DFA tables small
+    uint16_t classOf[kSymbols] = {};
+    std::vector<int> classSymbol;       // one symbol from each class
+
+    const std::vector<State>& States(bool backwards) const { return backwards ? reverse : forward; }
+
+    // thompson construction, each fragment's holes are the outs it leaves for whatever comes next
+    class Builder
+    {
+    public:
+        Builder(std::vector<State>& states, bool backwards)
+            : m_states(states), m_backwards(backwards)
+        {
+        }
+
+        bool Build(const Node& root, int& start)
+        {
+            Fragment fragment;
+            if (!Emit(root, fragment))
+                return false;
+            int match = Add(State::Match);
+            Patch(fragment, match);
+            start = fragment.start;
+            return true;
+        }
+
+    private:
+        struct Fragment
+        {
+            int start = -1;
+            std::vector<std::pair<int, int>> holes;     // state, 0 = out, 1 = out1
+        };
+
+        int Add(State::Kind kind, int set = -1)
+        {
+            m_states.push_back({ kind, set, -1, -1 });
+            return (int)m_states.size() - 1;
+        }
+
+        void Patch(const Fragment& fragment, int to)
+        {
+            for (auto [state, which] : fragment.holes)
+                (which ? m_states[state].out1 : m_states[state].out) = to;
+        }
+
+        // fragment followed by next
+        void Append(Fragment& fragment, Fragment&& next)
+        {
+            if (fragment.start < 0)
+            {
+                fragment = std::move(next);
+                return;
+            }
+            Patch(fragment, next.start);
+            fragment.holes = std::move(next.holes);
+        }
+
+        bool Emit(const Node& node, Fragment& out)
+        {
+            if (m_states.size() > kMaxNfaStates)
+                return false;
+            out = Fragment();
+            switch (node.kind)
+            {
+            case Node::Empty:
+            {
+                int split = Add(State::Split);
+                out.start = split;
+                out.holes = { { split, 0 }, { split, 1 } };
+                return true;
+            }
+            case Node::Set:
+            {
+                int symbol = Add(State::Symbol, node.set);
+                out.start = symbol;
+                out.holes = { { symbol, 0 } };
+                return true;
+            }
+            case Node::Concat:
+            {
+                size_t count = node.children.size();
+                for (size_t i = 0; i < count; i++)
+                {
+                    Fragment next;
+                    if (!Emit(node.children[m_backwards ? count - 1 - i : i], next))
+                        return false;
+                    Append(out, std::move(next));
+                }
+                return true;
+            }
+            case Node::Alternate:
+            {
+                if (!Emit(node.children.back(), out))
+                    return false;
+                for (size_t i = node.children.size() - 1; i-- > 0;)
+                {
+                    Fragment option;
+                    if (!Emit(node.children[i], option))
+                        return false;
+                    int split = Add(State::Split);
+                    m_states[split].out = option.start;
+                    m_states[split].out1 = out.start;
+                    option.holes.insert(option.holes.end(), out.holes.begin(), out.holes.end());
+                    out.start = split;
+                    out.holes = std::move(option.holes);
+                }
+                return true;
+            }
+            case Node::Repeat:
+            {
+                // x{2,4} is x x (x (x)?)? and x{2,} is x x x*
+                const Node& child = node.children[0];
+                for (int i = 0; i < node.min; i++)
+                {
+                    Fragment copy;
+                    if (!Emit(child, copy))
+                        return false;
+                    Append(out, std::move(copy));
+                }
+                if (node.max < 0)
+                {
+                    Fragment body;
+                    if (!Emit(child, body))
+                        return false;
+                    int split = Add(State::Split);
+                    m_states[split].out = body.start;
+                    Patch(body, split);
+                    Fragment star;
+                    star.start = split;
+                    star.holes = { { split, 1 } };
+                    Append(out, std::move(star));
+                }
+                else if (node.max > node.min)
+                {
+                    Fragment optional;
+                    for (int i = node.max - node.min; i > 0; i--)
+                    {
+                        Fragment body;
+                        if (!Emit(child, body))
+                            return false;
+                        if (optional.start >= 0)
+                            Append(body, std::move(optional));
+                        int split = Add(State::Split);
+                        m_states[split].out = body.start;
+                        body.holes.push_back({ split, 1 });
+                        optional.start = split;
+                        optional.holes = std::move(body.holes);
+                    }
+                    Append(out, std::move(optional));
+                }
+                if (out.start < 0)
+                    return Emit(Node(), out);  // x{0} matches nothing but the empty string
+                return true;
+            }
+            }
+            return false;
+        }
+
+        std::vector<State>& m_states;
+        bool m_backwards;
+    };
+};
+
+namespace
+{
+    // a set that stands for one ascii character, either case when folding
+    bool LiteralChar(const SymbolSet& set, bool ignoreCase, char& out)
+    {
+        size_t count = set.count();
+        if (count == 0 || count > 2)
+            return false;
+        int c = 0;
+        while (!set[c])
+            c++;
+        if (c >= 128)
+            return false;
+        if (count == 2)
+        {
+            // only a letter and its other case
+            if (!ignoreCase || c < 'A' || c > 'Z' || !set[c + 32])
+                return false;
+            c += 32;
+        }
+        else if (ignoreCase && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')))
+            return false;
+        out = (char)((c >= 'A' && c <= 'Z') ? c + 32 : c);
+        return true;
+    }
+
+    // the longest run of plain characters every match has to go through
+    std::string FindRequiredLiteral(const Node& root, const std::vector<SymbolSet>& sets, bool ignoreCase)
+    {
+        std::string best, run;
+        char c;
+        if (root.kind == Node::Set)
+        {
+            if (LiteralChar(sets[root.set], ignoreCase, c))
+                best.assign(1, c);
+            return best;
+        }
+        if (root.kind != Node::Concat)
+            return best;
+        for (const Node& child : root.children)
+        {
+            if (child.kind == Node::Set && LiteralChar(sets[child.set], ignoreCase, c))
+            {
+                run += c;
+                if (run.size() > best.size())
+                    best = run;
+            }
+            else
+                run.clear();
+        }
+        return best;
+    }
+}
+
+bool Regex::Compile(std::string_view pattern, bool ignoreCase, std::string* error)
+{
+    m_program.reset();
+    m_literal.clear();
+    auto program = std::make_shared<Program>();
+    Node root;
+    std::string message;
+    Parser parser(pattern, ignoreCase, program->sets);
+    if (!parser.Parse(root, message))
+    {
+        if (error)
+            *error = message;
+        return false;
+    }
+    if (!Program::Builder(program->forward, false).Build(root, program->forwardStart) ||
+        !Program::Builder(program->reverse, true).Build(root, program->reverseStart))
+    {
+        if (error)
+            *error = "pattern too big";
+        return false;
+    }
+
+    // symbols in exactly the same sets behave the same everywhere
+    std::unordered_map<std::string, int> classes;
+    std::string signature(program->sets.size(), '0');
+    for (int symbol = 0; symbol < kSymbols; symbol++)
+    {
+        for (size_t i = 0; i < program->sets.size(); i++)
+            signature[i] = program->sets[i][symbol] ? '1' : '0';
+        auto [it, added] = classes.try_emplace(signature, (int)classes.size());
+        if (added)
+            program->classSymbol.push_back(symbol);
+        program->classOf[symbol] = (uint16_t)it->second;
+    }
+
+    m_literal = FindRequiredLiteral(root, program->sets, ignoreCase);
+    m_program = std::move(program);
+    InitDfa(m_forward, false, true);
+    InitDfa(m_anchored, false, false);
+    InitDfa(m_reverse, true, true);
+    if (error)
+        error->clear();
+    return true;
+}
+
+void Regex::Closure(Dfa& dfa, std::vector<int>& set)
+{
+    // set comes in as the states to start from and goes out as everything
+    // reachable from them without taking a symbol, splits left out
+    const std::vector<Program::State>& states = m_program->States(dfa.reverse);
+    if (++dfa.generation == 0)
+    {
+        std::fill(dfa.marks.begin(), dfa.marks.end(), 0);
+        dfa.generation = 1;
+    }
+    dfa.stack.assign(set.begin(), set.end());
+    set.clear();
+    while (!dfa.stack.empty())
+    {
+        int s = dfa.stack.back();
+        dfa.stack.pop_back();
+        if (dfa.marks[s] == dfa.generation)
+            continue;
+        dfa.marks[s] = dfa.generation;
+        if (states[s].kind == Program::State::Split)
+        {
+            dfa.stack.push_back(states[s].out1);
+            dfa.stack.push_back(states[s].out);
+        }
+        else
+            set.push_back(s);
+    }
+    std::sort(set.begin(), set.end());
+}
+
+int Regex::AddState(Dfa& dfa, const std::vector<int>& set)
+{
+    std::string key((const char*)set.data(), set.size() * sizeof(int));
+    auto [it, added] = dfa.ids.try_emplace(std::move(key), (int)dfa.sets.size());
+    if (!added)
+        return it->second;
+    const std::vector<Program::State>& states = m_program->States(dfa.reverse);
+    bool match = std::any_of(set.begin(), set.end(), [&](int s) { return states[s].kind == Program::State::Match; });
+    dfa.sets.push_back(set);
+    dfa.match.push_back(match ? 1 : 0);
+    dfa.next.resize(dfa.next.size() + m_program->classSymbol.size(), kUnknown);
+    return it->second;
+}
+
+void Regex::ResetDfa(Dfa& dfa)
+{
+    dfa.sets.clear();
+    dfa.ids.clear();
+    dfa.next.clear();
+    dfa.match.clear();
+    std::vector<int> start = { dfa.reverse ? m_program->reverseStart : m_program->forwardStart };
+    Closure(dfa, start);
+    dfa.start = AddState(dfa, start);
+}
+
+void Regex::InitDfa(Dfa& dfa, bool reverse, bool unanchored)
+{
+    dfa = Dfa();
+    dfa.program = m_program.get();
+    dfa.reverse = reverse;
+    dfa.unanchored = unanchored;
+    dfa.marks.assign(m_program->States(reverse).size(), 0);
+    ResetDfa(dfa);
+}
+
+int Regex::Step(Dfa& dfa, int state, int cls)
+{
+    size_t at = (size_t)state * m_program->classSymbol.size() + cls;
+    int32_t known = dfa.next[at];
+    if (known != kUnknown)
+        return known;
+
+    const std::vector<Program::State>& states = m_program->States(dfa.reverse);
+    int symbol = m_program->classSymbol[cls];
+    m_scratch.clear();
+    for (int s : dfa.sets[state])
+    {
+        if (states[s].kind == Program::State::Symbol && m_program->sets[states[s].set][symbol])
+            m_scratch.push_back(states[s].out);
+    }
+    // unanchored, a match could also start right here
+    if (dfa.unanchored)
+        m_scratch.push_back(dfa.reverse ? m_program->reverseStart : m_program->forwardStart);
+    Closure(dfa, m_scratch);
+    if (m_scratch.empty())
+    {
+        dfa.next[at] = kDead;
+        return kDead;
+    }
+    if (dfa.sets.size() >= kMaxDfaStates)
+    {
+        // full - start over with just what's needed to carry on. state is gone
+        // after this, so the transition isn't worth remembering
+        std::string key((const char*)m_scratch.data(), m_scratch.size() * sizeof(int));
+        if (dfa.ids.find(key) == dfa.ids.end())
+        {
+            dfa.resets++;
+            ResetDfa(dfa);
+            return AddState(dfa, m_scratch);
+        }
+    }
+    int next = AddState(dfa, m_scratch);
+    dfa.next[at] = next;
+    return next;
+}
+
+bool Regex::Matches(std::string_view text)
+{
+    if (!m_program)
+        return false;
+    const uint16_t* classOf = m_program->classOf;
+    size_t classes = m_program->classSymbol.size();
+    Dfa& dfa = m_forward;
+    int state = dfa.start;
+    if (dfa.match[state])
+        return true;
+    state = Step(dfa, state, classOf[kLineStart]);
+    const unsigned char* p = (const unsigned char*)text.data();
+    const unsigned char* end = p + text.size();
+    for (; p < end; p++)
+    {
+        if (dfa.match[state])
+            return true;
+        // the table lookup is the whole loop once the states are built
+        int32_t next = dfa.next[(size_t)state * classes + classOf[*p]];
+        state = next != kUnknown ? next : Step(dfa, state, classOf[*p]);
+    }
+    if (dfa.match[state])
+        return true;
+    state = Step(dfa, state, classOf[kLineEnd]);
+    return dfa.match[state] != 0;
+}
+
+void Regex::FindAll(std::string_view text, std::vector<Span>& out)
+{
+    out.clear();
+    if (!Matches(text))
+        return;
+
+    // positions run over line start, the bytes, line end - position p is just
+    // before symbol p, which in the text is offset p - 1 clamped to the line
+    size_t n = text.size();
+    const unsigned char* bytes = (const unsigned char*)text.data();
+    const uint16_t* classOf = m_program->classOf;
+    auto classAt = [&](size_t p) {
+        return p == 0 ? classOf[kLineStart] : p == n + 1 ? classOf[kLineEnd] : classOf[bytes[p - 1]];
+    };
+    auto offset = [&](size_t p) { return (uint32_t)(p == 0 ? 0 : std::min(p - 1, n)); };
+
+    // one pass backwards marks every position a match starts at
+    m_starts.assign(n + 3, 0);
+    int state = m_reverse.start;
+    m_starts[n + 2] = m_reverse.match[state];
+    for (size_t p = n + 2; p-- > 0;)
+    {
+        state = Step(m_reverse, state, classAt(p));
+        m_starts[p] = m_reverse.match[state];
+    }
+
+    // then from each start the longest match, carrying on past its end
+    size_t pos = 0;
+    while (pos <= n + 2)
+    {
+        while (pos <= n + 2 && !m_starts[pos])
+            pos++;
+        if (pos > n + 2)
+            break;
+        state = m_anchored.start;
+        size_t last = m_anchored.match[state] ? pos : SIZE_MAX;
+        for (size_t p = pos; p <= n + 1; p++)
+        {
+            state = Step(m_anchored, state, classAt(p));
+            if (state == kDead)
+                break;
+            if (m_anchored.match[state])
+                last = p + 1;
+        }
+        if (last == SIZE_MAX)
+            last = pos;  // only a cache reset could get here, move along
+        if (offset(last) > offset(pos))
+            out.push_back({ offset(pos), offset(last) });
+        pos = last > pos ? last : pos + 1;
+    }
+}
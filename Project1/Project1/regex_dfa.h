@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// regular expressions for ctrl+f and the output filter, matched with a DFA
+// that gets built lazily as text runs through it - so every line costs one
+// table lookup per byte no matter what the pattern is, and there's no
+// backtracking to blow up on
+//
+// supports literals, . [] [^] \d \w \s (and the capitals) \t \xHH, ( ) (?: ),
+// |, * + ? {m,n} and ^ $ for the ends of a line. works on bytes, so . takes
+// one byte of a utf-8 character. matches are leftmost-longest like grep's
+class Regex
+{
+public:
+    struct Span
+    {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    // false (with a message in error) if the pattern doesn't parse.
+    // ignoreCase folds ascii letters
+    bool Compile(std::string_view pattern, bool ignoreCase, std::string* error = nullptr);
+    bool Valid() const { return m_program != nullptr; }
+
+    // anywhere in text at all, including an empty match
+    bool Matches(std::string_view text);
+
+    // every non-empty match, left to right without overlaps
+    void FindAll(std::string_view text, std::vector<Span>& out);
+
+    // lowercase ascii every match has in it, so lines without it can be
+    // skipped (or looked up in an index). empty if there's nothing certain
+    const std::string& RequiredLiteral() const { return m_literal; }
+
+    // DFA states built so far, and how often the cache filled up and started over
+    size_t States() const { return m_forward.sets.size() + m_anchored.sets.size() + m_reverse.sets.size(); }
+    uint64_t CacheResets() const { return m_forward.resets + m_anchored.resets + m_reverse.resets; }
+
+private:
+    struct Program;
+
+    // the DFA for one direction, a state per set of NFA states seen so far.
+    // each copy of a Regex builds its own, so worker threads never share one
+    struct Dfa
+    {
+        const Program* program = nullptr;
+        bool reverse = false;
+        bool unanchored = false;              // a match can start anywhere, not just at the first symbol
+        std::vector<std::vector<int>> sets;
+        std::unordered_map<std::string, int> ids;   // set bytes -> state
+        std::vector<int32_t> next;            // state * classes + class, kUnknown until it's been worked out
+        std::vector<uint8_t> match;
+        int start = 0;
+        uint64_t resets = 0;
+        std::vector<uint32_t> marks;          // closure bookkeeping, one per NFA state
+        uint32_t generation = 0;
+        std::vector<int> stack;
+    };
+
+    void InitDfa(Dfa& dfa, bool reverse, bool unanchored);
+    void ResetDfa(Dfa& dfa);
+    void Closure(Dfa& dfa, std::vector<int>& set);
+    int AddState(Dfa& dfa, const std::vector<int>& set);
+    int Step(Dfa& dfa, int state, int cls);
+
+    std::shared_ptr<const Program> m_program;  // compiled once, shared by every copy
+    Dfa m_forward;                              // unanchored, does this line match at all
+    Dfa m_anchored;                             // from a known start, how far the match goes
+    Dfa m_reverse;                              // unanchored backwards, where matches start
+    std::string m_literal;
+    std::vector<uint8_t> m_starts;
+    std::vector<int> m_scratch;
+};
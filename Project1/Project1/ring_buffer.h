@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// growable circular buffer - like std::deque but one flat block, so pushing
+// and popping at the ends never allocates except when it has to grow
+template <typename T>
+class RingBuffer
+{
+public:
+    RingBuffer() = default;
+    explicit RingBuffer(size_t capacity) { reserve(capacity); }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+    RingBuffer(RingBuffer&& other) noexcept { *this = std::move(other); }
+    RingBuffer& operator=(RingBuffer&& other) noexcept
+    {
+        m_data = std::move(other.m_data);
+        m_capacity = std::exchange(other.m_capacity, 0);
+        m_count = std::exchange(other.m_count, 0);
+        m_head = std::exchange(other.m_head, 0);
+        return *this;
+    }
+
+    size_t size() const { return m_count; }
+    size_t capacity() const { return m_capacity; }
+    bool empty() const { return m_count == 0; }
+    bool full() const { return m_count == m_capacity; }
+
+    T& operator[](size_t idx) { return m_data[(m_head + idx) % m_capacity]; }
+    const T& operator[](size_t idx) const { return m_data[(m_head + idx) % m_capacity]; }
+    T& front() { return m_data[m_head]; }
+    const T& front() const { return m_data[m_head]; }
+    T& back() { return (*this)[m_count - 1]; }
+    const T& back() const { return (*this)[m_count - 1]; }
+
+    void push_back(T value)
+    {
+        if (m_count == m_capacity)
+            reserve(m_capacity ? m_capacity * 2 : 16);
+        m_data[(m_head + m_count) % m_capacity] = std::move(value);
+        m_count++;
+    }
+
+    // fixed size mode - drops the oldest entry instead of growing
+    void push_back_overwrite(T value)
+    {
+        if (m_capacity == 0)
+            return;
+        if (m_count == m_capacity)
+            pop_front();
+        push_back(std::move(value));
+    }
+
+    void pop_front()
+    {
+        m_data[m_head] = T();
+        m_head = (m_head + 1) % m_capacity;
+        m_count--;
+    }
+
+    void pop_back()
+    {
+        (*this)[m_count - 1] = T();
+        m_count--;
+    }
+
+    void clear()
+    {
+        while (m_count > 0)
+            pop_front();
+        m_head = 0;
+    }
+
+    // clear() keeps the block around, this gives it back
+    void release()
+    {
+        m_data.reset();
+        m_capacity = m_count = m_head = 0;
+    }
+
+    void reserve(size_t capacity)
+    {
+        if (capacity <= m_capacity)
+            return;
+        std::unique_ptr<T[]> data(new T[capacity]);
+        for (size_t i = 0; i < m_count; i++)
+            data[i] = std::move((*this)[i]);
+        m_data = std::move(data);
+        m_capacity = capacity;
+        m_head = 0;
+    }
+
+private:
+    std::unique_ptr<T[]> m_data;
+    size_t m_capacity = 0;
+    size_t m_count = 0;
+    size_t m_head = 0;
+};
@@ -0,0 +1,182 @@
+#include "row_cache.h"
+
+#include "imgui/imgui_internal.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define ROW_CACHE_SSE2 1
+#endif
+
+// copy count vertices (a whole number of quads) moved by dx, dy
+static void CopyMoved(ImDrawVert* out, const ImDrawVert* in, int count, float dx, float dy)
+{
+#ifdef ROW_CACHE_SSE2
+    // a quad is four 20 byte vertices, 80 bytes - five registers with the
+    // x and y lanes in a different spot in each. colors never go through
+    // the float add, a color that looks like a nan mustn't get changed
+    static_assert(sizeof(ImDrawVert) == 20, "pos, uv, col");
+    const __m128 offsets[5] = {
+        _mm_setr_ps(dx, dy, 0, 0), _mm_setr_ps(0, dx, dy, 0), _mm_setr_ps(0, 0, dx, dy),
+        _mm_setr_ps(0, 0, 0, dx), _mm_setr_ps(dy, 0, 0, 0),
+    };
+    const __m128 moved[5] = {
+        _mm_castsi128_ps(_mm_setr_epi32(-1, -1, 0, 0)), _mm_castsi128_ps(_mm_setr_epi32(0, -1, -1, 0)),
+        _mm_castsi128_ps(_mm_setr_epi32(0, 0, -1, -1)), _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1)),
+        _mm_castsi128_ps(_mm_setr_epi32(-1, 0, 0, 0)),
+    };
+    const float* src = (const float*)in;
+    float* dst = (float*)out;
+    for (int q = 0; q < count / 4; q++, src += 20, dst += 20)
+    {
+        for (int r = 0; r < 5; r++)
+        {
+            __m128 v = _mm_loadu_ps(src + r * 4);
+            __m128 sum = _mm_add_ps(v, offsets[r]);
+            _mm_storeu_ps(dst + r * 4, _mm_or_ps(_mm_and_ps(moved[r], sum), _mm_andnot_ps(moved[r], v)));
+        }
+    }
+#else
+    for (int i = 0; i < count; i++)
+    {
+        out[i] = in[i];
+        out[i].pos.x += dx;
+        out[i].pos.y += dy;
+    }
+#endif
+}
+
+void RowCache::Begin(TextGrid* grid, ImU32 color)
+{
+    m_stats.frameRows = m_frameRows;
+    m_stats.frameReplayed = m_frameReplayed;
+    m_frameRows = 0;
+    m_frameReplayed = 0;
+
+    m_grid = grid;
+    if (color != m_color)
+    {
+        Clear();
+        m_color = color;
+    }
+}
+
+void RowCache::Clear()
+{
+    if (!m_rows.empty())
+        m_stats.resets++;
+    m_rows.clear();
+    m_lru.clear();
+    for (Slot& slot : m_slots)
+        slot.used = false;
+    m_vertices = 0;
+}
+
+void RowCache::DrawRow(ImVec2 pos, uint64_t lineId, uint32_t offset, std::string_view text)
+{
+    ImDrawList* drawList = m_grid->DrawList();
+    ImVec2 origin(IM_TRUNC(pos.x), IM_TRUNC(pos.y));
+    m_frameRows++;
+
+    // a glyph outside ascii can grow the atlas halfway through a frame, which
+    // moves every uv - anything recorded before that is no good any more
+    if (m_grid->Generation() != m_generation)
+    {
+        Clear();
+        m_generation = m_grid->Generation();
+    }
+
+    Key key{ lineId, offset, (uint32_t)text.size() };
+    // the slot first - a row on screen finds itself there every frame without
+    // hashing its way through the map
+    Slot& slot = SlotFor(key);
+    bool found = slot.used && slot.key == key;
+    if (!found)
+    {
+        auto it = m_rows.find(key);
+        if (it != m_rows.end())
+        {
+            slot.key = key;
+            slot.row = it->second;
+            slot.used = true;
+            found = true;
+        }
+    }
+    if (found)
+    {
+        const ImVec4 clip = drawList->_CmdHeader.ClipRect;
+        if (origin.y > clip.w || origin.y + m_grid->FontSize() < clip.y)
+            return;
+        if (slot.row != m_lru.begin())
+            m_lru.splice(m_lru.begin(), m_lru, slot.row);
+        Replay(drawList, *slot.row, origin);
+        m_stats.replayed++;
+        m_frameReplayed++;
+        return;
+    }
+
+    // draw it the long way, and if none of it got clipped off keep what it
+    // wrote to the list. the vertices are all in one piece even if the list
+    // started over at a new vertex offset on the way
+    int firstVertex = drawList->VtxBuffer.Size;
+    if (!m_grid->DrawRow(origin, text, m_color) || m_grid->Generation() != m_generation || text.empty())
+        return;
+
+    Row row;
+    row.key = key;
+    row.origin = origin;
+    row.vertices.assign(drawList->VtxBuffer.Data + firstVertex, drawList->VtxBuffer.Data + drawList->VtxBuffer.Size);
+    // nothing but glyph quads, two triangles every four vertices. made up
+    // here rather than copied, the list's might restart at a new vertex offset
+    row.indices.resize(row.vertices.size() / 4 * 6);
+    ImDrawIdx* index = row.indices.data();
+    for (size_t base = 0; base + 4 <= row.vertices.size(); base += 4, index += 6)
+    {
+        index[0] = (ImDrawIdx)base; index[1] = (ImDrawIdx)(base + 1); index[2] = (ImDrawIdx)(base + 2);
+        index[3] = (ImDrawIdx)base; index[4] = (ImDrawIdx)(base + 2); index[5] = (ImDrawIdx)(base + 3);
+    }
+    m_vertices += row.vertices.size();
+    m_lru.push_front(std::move(row));
+    m_rows.emplace(key, m_lru.begin());
+    m_stats.recorded++;
+
+    while (m_vertices > kMaxVertices && m_lru.size() > 1)
+    {
+        const Row& oldest = m_lru.back();
+        Slot& oldestSlot = SlotFor(oldest.key);
+        if (oldestSlot.used && oldestSlot.key == oldest.key)
+            oldestSlot.used = false;
+        m_vertices -= oldest.vertices.size();
+        m_rows.erase(oldest.key);
+        m_lru.pop_back();
+        m_stats.evicted++;
+    }
+}
+
+void RowCache::Replay(ImDrawList* drawList, const Row& row, ImVec2 origin)
+{
+    int vertexCount = (int)row.vertices.size();
+    int indexCount = (int)row.indices.size();
+    drawList->PrimReserve(indexCount, vertexCount);
+
+    // a row that hasn't moved since it was recorded is just a memcpy
+    ImDrawVert* vertex = drawList->_VtxWritePtr;
+    float dx = origin.x - row.origin.x;
+    float dy = origin.y - row.origin.y;
+    if (dx == 0.0f && dy == 0.0f)
+        memcpy(vertex, row.vertices.data(), vertexCount * sizeof(ImDrawVert));
+    else
+        CopyMoved(vertex, row.vertices.data(), vertexCount, dx, dy);
+
+    // might have started over at a new vertex offset, so the base only shows up now
+    ImDrawIdx* index = drawList->_IdxWritePtr;
+    unsigned int base = drawList->_VtxCurrentIdx;
+    const ImDrawIdx* source = row.indices.data();
+    for (int i = 0; i < indexCount; i++)
+        index[i] = (ImDrawIdx)(source[i] + base);
+
+    drawList->_VtxWritePtr = vertex + vertexCount;
+    drawList->_IdxWritePtr = index + indexCount;
+    drawList->_VtxCurrentIdx = base + vertexCount;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "text_grid.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// the vertices of output rows, kept from one frame to the next. a line never
+// changes once it's in the scrollback, so a row that was drawn last frame is
+// the same quads this frame, just somewhere else - replaying them is a block
+// copy of its vertices and indices instead of a walk through the text and the
+// glyph table. the vertices get moved by however far the row scrolled, and
+// the indices by where the list is at, nothing else gets touched
+//
+// rows are keyed by line id and the bytes of the line they cover. wrap width
+// and font size aren't in the key: a new width shows up as different byte
+// ranges, a new size (or atlas) as a new glyph table generation, and that or
+// a new text color throws everything away. rows that scroll out of view age
+// out least recently drawn first once kMaxVertices is reached
+class RowCache
+{
+public:
+    struct Stats
+    {
+        uint64_t replayed = 0;        // rows copied out of the cache
+        uint64_t recorded = 0;        // rows drawn through the grid and kept
+        uint64_t evicted = 0;         // rows dropped to stay under the budget
+        uint64_t resets = 0;          // glyph table or text color changed
+        size_t frameRows = 0;         // rows drawn last frame
+        size_t frameReplayed = 0;     // ...of those, how many came out of the cache
+    };
+
+    // once a frame, after the grid's Begin and before any rows
+    void Begin(TextGrid* grid, ImU32 color);
+
+    // bytes [offset, offset + text.size()) of line lineId with its top left at
+    // pos, in the grid's draw list and color
+    void DrawRow(ImVec2 pos, uint64_t lineId, uint32_t offset, std::string_view text);
+
+    size_t Rows() const { return m_rows.size(); }
+    size_t Vertices() const { return m_vertices; }
+    const Stats& GetStats() const { return m_stats; }
+
+    // about 5 MB of vertices (6 with their indices), a few dozen screens of dense output
+    static constexpr size_t kMaxVertices = 1 << 18;
+
+    // rows looked up straight by key hash before going to the map
+    static constexpr size_t kSlots = 256;
+
+private:
+    struct Key
+    {
+        uint64_t lineId;
+        uint32_t offset;
+        uint32_t length;
+        bool operator==(const Key& other) const { return lineId == other.lineId && offset == other.offset && length == other.length; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const { return (size_t)(key.lineId * 0x9E3779B97F4A7C15ull ^ ((uint64_t)key.offset << 32 | key.length)); }
+    };
+    struct Row
+    {
+        Key key;
+        ImVec2 origin;                      // top left it was recorded at
+        std::vector<ImDrawVert> vertices;   // quads as they were drawn there
+        std::vector<ImDrawIdx> indices;     // relative to the row's first vertex
+    };
+
+    struct Slot
+    {
+        Key key;
+        std::list<Row>::iterator row;
+        bool used = false;
+    };
+
+    void Clear();
+    void Replay(ImDrawList* drawList, const Row& row, ImVec2 origin);
+    Slot& SlotFor(const Key& key) { return m_slots[KeyHash()(key) & (kSlots - 1)]; }
+
+    TextGrid* m_grid = nullptr;
+    ImU32 m_color = 0;
+    uint64_t m_generation = 0;
+    std::list<Row> m_lru;                   // most recently drawn first
+    std::unordered_map<Key, std::list<Row>::iterator, KeyHash> m_rows;
+    Slot m_slots[kSlots];                   // last row looked up per hash slot
+    size_t m_vertices = 0;
+    size_t m_frameRows = 0;
+    size_t m_frameReplayed = 0;
+    Stats m_stats;
+};
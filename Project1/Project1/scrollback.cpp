@@ -0,0 +1,130 @@
+#include "scrollback.h"
+
+#include <cstring>
+#include <mutex>
+
+Scrollback::Scrollback(size_t byteBudget)
+    : m_budget(byteBudget < kPageSize ? kPageSize : byteBudget)
+{
+}
+
+void Scrollback::Append(std::string_view line)
+{
+    Append(std::string_view(), line);
+}
+
+void Scrollback::Append(std::string_view prefix, std::string_view line)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    AppendLocked(prefix, line);
+}
+
+void Scrollback::Append(std::string_view prefix, const LineBatch& lines)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (size_t i = 0; i < lines.Size(); i++)
+        AppendLocked(prefix, lines[i]);
+}
+
+void Scrollback::AppendLocked(std::string_view prefix, std::string_view line)
+{
+    size_t length = prefix.size() + line.size();
+    char* dst = Reserve(length);
+    if (!prefix.empty())
+        memcpy(dst, prefix.data(), prefix.size());
+    if (!line.empty())
+        memcpy(dst + prefix.size(), line.data(), line.size());
+}
+
+void Scrollback::Clear()
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_firstLineId += m_lines.size();
+    m_firstPage += (uint32_t)m_pages.size();
+    m_pages.release();
+    m_lines.release();
+    m_spare = Page();
+    m_pageBytes = 0;
+}
+
+void Scrollback::SetByteBudget(size_t bytes)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_budget = bytes < kPageSize ? kPageSize : bytes;
+    EnforceBudget();
+}
+
+size_t Scrollback::BytesUsed() const
+{
+    return m_pageBytes + m_lines.size() * sizeof(LineRef);
+}
+
+std::string_view Scrollback::Line(size_t idx) const
+{
+    const LineRef& ref = m_lines[idx];
+    const Page& page = m_pages[(uint32_t)(ref.page - m_firstPage)];
+    return std::string_view(page.data.get() + ref.offset, ref.length);
+}
+
+// find room for a line of this length and record it in the index
+char* Scrollback::Reserve(size_t length)
+{
+    if (m_pages.empty() || m_pages.back().capacity - m_pages.back().used < length)
+    {
+        // out of room in the current page, start a new one
+        // (budget check first so the page we evict can be recycled right away)
+        if (BytesUsed() + kPageSize > m_budget && !m_pages.empty())
+            EvictFrontPage();
+
+        Page page;
+        if (length <= kPageSize && m_spare.data)
+        {
+            page = std::move(m_spare);
+            page.used = 0;
+        }
+        else
+        {
+            // lines longer than a page get a page of their own
+            page.capacity = (uint32_t)(length > kPageSize ? length : kPageSize);
+            page.data.reset(new char[page.capacity]);
+        }
+        m_pageBytes += page.capacity;
+        m_pages.push_back(std::move(page));
+    }
+
+    Page& page = m_pages.back();
+    LineRef ref;
+    ref.page = m_firstPage + (uint32_t)m_pages.size() - 1;
+    ref.offset = page.used;
+    ref.length = (uint32_t)length;
+    m_lines.push_back(ref);
+    page.used += (uint32_t)length;
+
+    char* dst = page.data.get() + ref.offset;
+    EnforceBudget();
+    return dst;
+}
+
+void Scrollback::EvictFrontPage()
+{
+    // drop every line living in the oldest page
+    while (!m_lines.empty() && m_lines.front().page == m_firstPage)
+    {
+        m_lines.pop_front();
+        m_firstLineId++;
+    }
+
+    Page& front = m_pages.front();
+    m_pageBytes -= front.capacity;
+    if (front.capacity == kPageSize)
+        m_spare = std::move(front);
+    m_pages.pop_front();
+    m_firstPage++;
+}
+
+void Scrollback::EnforceBudget()
+{
+    // always keep the page we're currently writing into
+    while (BytesUsed() > m_budget && m_pages.size() > 1)
+        EvictFrontPage();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "line_splitter.h"
+#include "ring_buffer.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+
+// scrollback storage for a terminal pane
+// line bytes get packed back to back into fixed size pages, so appending a line
+// costs a memcpy instead of a heap allocation. once the byte budget is used up
+// the oldest page gets evicted (and its buffer reused for the next page)
+//
+// threading: only the ui thread writes. writers take Mutex() exclusively, so the
+// ui thread can read without locking while background readers hold it shared
+class Scrollback
+{
+public:
+    static constexpr size_t kPageSize = 64 * 1024;
+    static constexpr size_t kDefaultBudget = 32 * 1024 * 1024;
+
+    explicit Scrollback(size_t byteBudget = kDefaultBudget);
+
+    // append one line, the prefix version is for timestamps so we don't have to concat first
+    void Append(std::string_view line);
+    void Append(std::string_view prefix, std::string_view line);
+    // a whole batch under one lock, every line gets the same prefix
+    void Append(std::string_view prefix, const LineBatch& lines);
+
+    // drop everything and give the memory back (vector::clear kept the capacity around)
+    void Clear();
+
+    void SetByteBudget(size_t bytes);
+    size_t ByteBudget() const { return m_budget; }
+    size_t BytesUsed() const;
+
+    size_t Size() const { return m_lines.size(); }
+    bool Empty() const { return m_lines.empty(); }
+
+    // idx 0 is the oldest line still held. views stay valid until that line gets evicted
+    std::string_view Line(size_t idx) const;
+    std::string_view operator[](size_t idx) const { return Line(idx); }
+
+    // line ids keep counting up across evictions and clears, so other
+    // per-line data can be keyed on them and trimmed from the front
+    uint64_t FirstLineId() const { return m_firstLineId; }
+    uint64_t EndLineId() const { return m_firstLineId + m_lines.size(); }
+
+    std::shared_mutex& Mutex() const { return m_mutex; }
+
+private:
+    struct Page
+    {
+        std::unique_ptr<char[]> data;
+        uint32_t capacity = 0;
+        uint32_t used = 0;
+    };
+
+    struct LineRef
+    {
+        uint32_t page = 0;     // absolute page number (see m_firstPage), wraps harmlessly
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    void AppendLocked(std::string_view prefix, std::string_view line);
+    char* Reserve(size_t length);
+    void EvictFrontPage();
+    void EnforceBudget();
+
+    RingBuffer<Page> m_pages;
+    RingBuffer<LineRef> m_lines;
+    Page m_spare;               // last evicted page, reused so steady state doesn't allocate
+    uint32_t m_firstPage = 0;
+    uint64_t m_firstLineId = 0;
+    size_t m_pageBytes = 0;
+    size_t m_budget;
+    mutable std::shared_mutex m_mutex;
+};
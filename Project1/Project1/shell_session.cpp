@@ -0,0 +1,359 @@
+#include "shell_session.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+namespace
+{
+    bool IsWordBreak(char c)
+    {
+        return c == ' ' || c == '\t' || c == '&' || c == '|' || c == '(' || c == ')' || c == '<' || c == '>';
+    }
+
+    // the command goes inside "( ... ) <nul" so whatever it reads gets EOF
+    // instead of our marker lines. a ) the command line doesn't open itself
+    // would close that block early, so those get a ^. the ( that do open
+    // one are the ones cmd takes as a group: where a command could start,
+    // after do / else, or after a space in an if / for
+    std::string EscapeForBlock(std::string_view command)
+    {
+        std::string out;
+        out.reserve(command.size() + 8);
+        std::string word;
+        bool commandStart = true;   // the next word is a command name
+        bool inIfFor = false;
+        bool quoted = false;
+        int groups = 0;
+
+        auto endWord = [&] {
+            if (word.empty())
+                return;
+            if (commandStart)
+                inIfFor = _stricmp(word.c_str(), "if") == 0 || _stricmp(word.c_str(), "for") == 0;
+            commandStart = _stricmp(word.c_str(), "do") == 0 || _stricmp(word.c_str(), "else") == 0;
+            word.clear();
+        };
+
+        for (size_t i = 0; i < command.size(); i++)
+        {
+            char c = command[i];
+            if (c == '"')
+                quoted = !quoted;
+            if (quoted || c == '"')
+            {
+                word += c;
+                out += c;
+                continue;
+            }
+            if (c == '^')
+            {
+                // a ^ at the very end would escape our line break
+                if (i + 1 == command.size())
+                    break;
+                word += command[++i];
+                out += c;
+                out += command[i];
+                continue;
+            }
+            if (!IsWordBreak(c))
+            {
+                if (!(commandStart && word.empty() && c == '@'))
+                    word += c;
+                out += c;
+                continue;
+            }
+
+            bool spaceBefore = i > 0 && (command[i - 1] == ' ' || command[i - 1] == '\t');
+            endWord();
+            if (c == '(')
+            {
+                if (commandStart || (inIfFor && spaceBefore))
+                {
+                    groups++;
+                    commandStart = true;
+                }
+            }
+            else if (c == ')')
+            {
+                if (groups == 0)
+                    out += '^';
+                else
+                    groups--;
+                commandStart = false;
+            }
+            else if (c == '&' || c == '|')
+            {
+                commandStart = true;
+                inIfFor = false;
+            }
+            out += c;
+        }
+        return out;
+    }
+}
+#endif
+
+ShellSession::~ShellSession()
+{
+    Cancel();
+    Stop();
+}
+
+std::shared_ptr<CommandJob> ShellSession::Run(const std::string& command, const SpawnContext& context)
+{
+    auto job = std::make_shared<CommandJob>(command);
+
+    bool alive;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        alive = m_alive;
+    }
+    if (!alive)
+    {
+        // first command, or the shell exited / got killed since the last one
+        Stop();
+        if (!Start(context))
+        {
+            job->Fail(m_process->Error());
+            return job;
+        }
+    }
+
+    uint64_t seq = ++m_seq;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = job;
+        m_jobSeq = seq;
+    }
+
+    // the marker goes on a line of its own after the command, so nothing the
+    // command line does (an open quote, rem, an if that's false) can eat it or
+    // run it twice. then the environment and the closing marker. it all goes in one write
+    std::string line;
+    std::string seqText = std::to_string(seq);
+#ifdef _WIN32
+    // the echo line is only read once the command is done, so plain %errorlevel% is its exit code.
+    // sort, set /p, pause, more... would read our marker lines otherwise, <nul gives them EOF
+    line = "(\r\n" + EscapeForBlock(command) + "\r\n) <nul\r\necho " + m_marker + seqText + "_%errorlevel%_%cd%\r\nset\r\necho " + m_marker + seqText + "E\r\n";
+#else
+    // eval keeps cd/export in this shell and turns a broken command into a syntax
+    // error of its own, 'command' stops that error from exiting the shell.
+    // /dev/null keeps the command off our pipe
+    std::string quoted;
+    for (char c : command)
+        quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    // env would be a process launch per command, PATH is the one that matters
+    line = "command eval '" + quoted + "' </dev/null\nprintf '%s%d_%d_%s\\n' '" + m_marker + "' " + seqText + " \"$?\" \"$PWD\"\n" +
+        "printf 'PATH=%s\\n%s%dE\\n' \"$PATH\" '" + m_marker + "' " + seqText + "\n";
+#endif
+    // if this fails the shell is gone, the reader sees EOF and finishes the job
+    m_process->Write(line);
+    return job;
+}
+
+void ShellSession::Cancel()
+{
+    std::shared_ptr<CommandJob> job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        job = m_job;
+        // the reader finishes the job once the shell's gone, the next Run
+        // doesn't wait for that to start a fresh one
+        m_alive = false;
+    }
+    if (job)
+        job->MarkCancelled();
+    if (m_process)
+        m_process->Kill();
+}
+
+std::string ShellSession::Cwd() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cwd;
+}
+
+Environment ShellSession::Env() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_env;
+}
+
+bool ShellSession::Start(const SpawnContext& context)
+{
+    m_process = std::make_unique<ChildProcess>();
+    if (!m_process->StartShell(context))
+        return false;
+
+    char marker[48];
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    snprintf(marker, sizeof(marker), "__lt_%llx_", (unsigned long long)now ^ (unsigned long long)(uintptr_t)this);
+    m_marker = marker;
+    m_seq = 0;
+    m_envSeq = 0;
+    m_envVars.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_env = context.env.Empty() ? Environment::FromProcess() : context.env;
+        m_alive = true;
+    }
+    m_reader = std::thread([this] { ReadLoop(); });
+
+    // sequence 0 just means ready - anything before it (the cmd.exe banner) gets dropped
+#ifdef _WIN32
+    m_process->Write("call echo " + m_marker + "0_0_%^cd%\r\n");
+#else
+    m_process->Write("printf '%s0_0_%s\\n' '" + m_marker + "' \"$PWD\"\n");
+#endif
+    return true;
+}
+
+void ShellSession::Stop()
+{
+    if (!m_process)
+        return;
+    m_process->Kill();
+    if (m_reader.joinable())
+        m_reader.join();
+    m_process.reset();
+}
+
+void ShellSession::ReadLoop()
+{
+    LineSplitter splitter;
+    LineBatch lines;
+    bool ready = false;
+    auto onLine = [&](std::string_view line) { OnLine(line, lines, ready); };
+
+    char buffer[64 * 1024];
+    size_t bytesRead;
+    while ((bytesRead = m_process->Read(buffer, sizeof(buffer))) > 0)
+    {
+        splitter.Feed(buffer, bytesRead, onLine);
+        if (lines.Empty())
+            continue;
+
+        std::shared_ptr<CommandJob> job;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            job = m_job;
+        }
+        if (job)
+            job->Publish(lines);
+        lines.Clear();
+    }
+    splitter.Finish(onLine);
+
+    // shell's gone (exit, crash or Cancel) - whatever it was running is done too
+    int exitCode = m_process->Wait();
+    std::shared_ptr<CommandJob> job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        job = std::move(m_job);
+        m_alive = false;
+    }
+    if (job)
+    {
+        if (!lines.Empty())
+            job->Publish(lines);
+        job->Finish(exitCode);
+    }
+}
+
+void ShellSession::OnLine(std::string_view line, LineBatch& lines, bool& ready)
+{
+    size_t pos = line.find(m_marker);
+    if (pos == std::string_view::npos && m_envSeq != 0)
+    {
+        m_envVars.emplace_back(line);
+        return;
+    }
+    if (pos == std::string_view::npos)
+    {
+        // blank lines never made it into the pane before either
+        if (ready && !line.empty())
+            lines.Add(line);
+        return;
+    }
+
+    // output without a trailing newline ends up in front of the marker
+    if (ready && pos > 0)
+        lines.Add(line.substr(0, pos));
+
+    // <marker><seq>_<exit code>_<cwd>, or <marker><seq>E after the environment
+    std::string fields(line.substr(pos + m_marker.size()));
+    char* end = nullptr;
+    uint64_t seq = strtoull(fields.c_str(), &end, 10);
+    if (seq != 0 && seq == m_envSeq && *end == 'E')
+    {
+        FinishJob(seq);
+        return;
+    }
+    int exitCode = 0;
+    if (*end == '_')
+        exitCode = (int)strtol(end + 1, &end, 10);
+    std::string cwd;
+    if (*end == '_')
+        cwd = end + 1;
+
+    // a marker for some other command (one from before a Cancel, or echoed by
+    // the command itself) says nothing about this one
+    std::shared_ptr<CommandJob> job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (seq != 0 && seq != m_jobSeq)
+        {
+            if (ready)
+                lines.Add(line.substr(pos));
+            return;
+        }
+        if (!cwd.empty())
+            m_cwd = cwd;
+        job = m_job;
+    }
+    if (seq == 0)
+    {
+        ready = true;
+        lines.Clear();
+        return;
+    }
+
+    // the command's done, the job finishes once the environment is in
+    if (job && !lines.Empty())
+        job->Publish(lines);
+    lines.Clear();
+    m_envSeq = seq;
+    m_exitCode = exitCode;
+    m_envVars.clear();
+}
+
+void ShellSession::FinishJob(uint64_t seq)
+{
+    std::shared_ptr<CommandJob> job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+#ifdef _WIN32
+        m_env = Environment::FromVars(std::move(m_envVars));
+#else
+        for (const auto& var : m_envVars)
+        {
+            size_t eq = var.find('=');
+            if (eq != std::string::npos)
+                m_env.Set(std::string_view(var).substr(0, eq), std::string_view(var).substr(eq + 1));
+        }
+#endif
+        if (seq == m_jobSeq)
+        {
+            job = std::move(m_job);
+            m_jobSeq = 0;
+        }
+    }
+    m_envSeq = 0;
+    m_envVars.clear();
+    if (job)
+        job->Finish(m_exitCode);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "command_job.h"
+#include "process.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// a long lived shell per pane (cmd.exe, or /bin/sh on posix) that commands get
+// piped into, so running one costs a pipe round trip instead of a process
+// launch, and cd / set stick around between commands
+//
+// every command gets followed by a marker echo of its own carrying a sequence
+// number, the exit code and the cwd. when the reader thread sees the marker
+// with the command's number the command is done, and everything it read
+// before that was its output. after that the shell dumps its environment
+// (all of it with cmd's set, just PATH on posix) and a closing marker, so
+// whatever set / path / a .bat did to it shows up in Env()
+class ShellSession
+{
+public:
+    ShellSession() = default;
+    ~ShellSession();
+
+    ShellSession(const ShellSession&) = delete;
+    ShellSession& operator=(const ShellSession&) = delete;
+
+    // hand a command to the shell (starting one in the given cwd/env if there
+    // isn't one running), the returned job collects its output
+    std::shared_ptr<CommandJob> Run(const std::string& command, const SpawnContext& context);
+
+    // kill the shell and whatever it's running, the next Run starts a fresh one
+    void Cancel();
+
+    // the shell's working directory as of the last command that finished
+    std::string Cwd() const;
+
+    // ...and its environment, the one it started with until then
+    Environment Env() const;
+
+private:
+    bool Start(const SpawnContext& context);
+    void Stop();
+    void ReadLoop();
+    void OnLine(std::string_view line, LineBatch& lines, bool& ready);
+    void FinishJob(uint64_t seq);
+
+    std::unique_ptr<ChildProcess> m_process;
+    std::thread m_reader;
+    std::string m_marker;                 // different per shell so output can't fake it
+    uint64_t m_seq = 0;                   // ui thread only
+
+    // reader thread only
+    uint64_t m_envSeq = 0;                // command whose environment dump is coming in, 0 if none
+    int m_exitCode = 0;                   // ...its exit code
+    std::vector<std::string> m_envVars;   // ...and the "NAME=value" lines so far
+
+    mutable std::mutex m_mutex;           // guards everything below
+    std::shared_ptr<CommandJob> m_job;    // command the shell is running right now
+    uint64_t m_jobSeq = 0;                // ...and the marker that finishes it
+    std::string m_cwd;
+    Environment m_env;
+    bool m_alive = false;
+};
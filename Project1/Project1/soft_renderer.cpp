@@ -0,0 +1,391 @@
+#include "soft_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SOFT_RENDERER_SSE2 1
+#endif
+
+// x / 255 rounded, exact for anything two bytes multiplied can make
+static inline unsigned int Div255(unsigned int x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// texel times vertex color, a channel at a time
+static inline ImU32 Modulate(ImU32 texel, ImU32 color)
+{
+    if (texel == 0xFFFFFFFF)
+        return color;
+    ImU32 out = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+        out |= Div255(((texel >> shift) & 0xFF) * ((color >> shift) & 0xFF)) << shift;
+    return out;
+}
+
+// src alpha / inv src alpha for color, one / inv src alpha for alpha - the
+// blend state the dx11 backend sets up
+static inline void Blend(ImU32* dst, ImU32 src)
+{
+    unsigned int a = src >> IM_COL32_A_SHIFT;
+    if (a == 0)
+        return;
+    if (a == 255)
+    {
+        *dst = src;
+        return;
+    }
+    unsigned int inv = 255 - a;
+    ImU32 d = *dst;
+    ImU32 out = 0;
+    for (int shift = 0; shift < 24; shift += 8)
+        out |= Div255(((src >> shift) & 0xFF) * a + ((d >> shift) & 0xFF) * inv) << shift;
+    out |= Div255(255 * a + (d >> 24) * inv) << 24;
+    *dst = out;
+}
+
+// one color over count pixels. the sse2 path works out the same numbers
+static void FillSpan(ImU32* dst, int count, ImU32 src)
+{
+    unsigned int a = src >> IM_COL32_A_SHIFT;
+    if (a == 0 || count <= 0)
+        return;
+    if (a == 255)
+    {
+        std::fill(dst, dst + count, src);
+        return;
+    }
+#ifdef SOFT_RENDERER_SSE2
+    // each channel is src * a + dst * (255 - a), 8 channels to a register
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i inv = _mm_set1_epi16((short)(255 - a));
+    const short r = (short)((src & 0xFF) * a + 128);
+    const short g = (short)(((src >> 8) & 0xFF) * a + 128);
+    const short b = (short)(((src >> 16) & 0xFF) * a + 128);
+    const short alpha = (short)(255 * a + 128);
+    const __m128i add = _mm_set_epi16(alpha, b, g, r, alpha, b, g, r);
+    auto blend = [&](__m128i d) {
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(d, inv), add);
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    };
+    for (; count >= 4; count -= 4, dst += 4)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i*)dst);
+        __m128i lo = blend(_mm_unpacklo_epi8(d, zero));
+        __m128i hi = blend(_mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; count > 0; count--)
+        Blend(dst++, src);
+}
+
+void SoftRenderer::Init()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    IM_ASSERT(io.BackendRendererUserData == nullptr && "Already initialized a renderer backend!");
+    io.BackendRendererUserData = this;
+    io.BackendRendererName = "soft_renderer";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset | ImGuiBackendFlags_RendererHasTextures;
+}
+
+void SoftRenderer::Shutdown()
+{
+    for (ImTextureData* tex : ImGui::GetPlatformIO().Textures)
+    {
+        if (tex->RefCount == 1)
+        {
+            tex->SetTexID(ImTextureID_Invalid);
+            tex->SetStatus(ImTextureStatus_Destroyed);
+        }
+    }
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendRendererName = nullptr;
+    io.BackendRendererUserData = nullptr;
+    io.BackendFlags &= ~(ImGuiBackendFlags_RendererHasVtxOffset | ImGuiBackendFlags_RendererHasTextures);
+}
+
+// there's nothing to upload, the pixels get read where imgui keeps them. a
+// texture only needs an id so imgui knows it's ready
+void SoftRenderer::UpdateTexture(ImTextureData* tex)
+{
+    if (tex->Status == ImTextureStatus_WantCreate || tex->Status == ImTextureStatus_WantUpdates)
+    {
+        tex->SetTexID((ImTextureID)(intptr_t)tex);
+        tex->SetStatus(ImTextureStatus_OK);
+    }
+    if (tex->Status == ImTextureStatus_WantDestroy && tex->UnusedFrames > 0)
+    {
+        tex->SetTexID(ImTextureID_Invalid);
+        tex->SetStatus(ImTextureStatus_Destroyed);
+    }
+}
+
+SoftRenderer::Texture SoftRenderer::Resolve(const ImDrawCmd& cmd)
+{
+    Texture texture;
+    const ImTextureData* data = cmd.TexRef._TexData;
+    if (data && data->Pixels)
+    {
+        texture.pixels = data->Pixels;
+        texture.width = data->Width;
+        texture.height = data->Height;
+        texture.bytesPerPixel = data->BytesPerPixel;
+    }
+    return texture;
+}
+
+static inline ImU32 Texel(const unsigned char* pixels, int width, int height, int bytesPerPixel, float u, float v)
+{
+    int x = std::clamp((int)(u * width), 0, width - 1);
+    int y = std::clamp((int)(v * height), 0, height - 1);
+    const unsigned char* p = pixels + ((size_t)y * width + x) * bytesPerPixel;
+    if (bytesPerPixel == 1)
+        return ((ImU32)p[0] << IM_COL32_A_SHIFT) | 0x00FFFFFF;
+    return (ImU32)p[0] | (ImU32)p[1] << 8 | (ImU32)p[2] << 16 | (ImU32)p[3] << 24;
+}
+
+void SoftRenderer::Resize(int width, int height)
+{
+    m_width = std::max(width, 0);
+    m_height = std::max(height, 0);
+    m_pixels.assign((size_t)m_width * m_height, 0);
+}
+
+void SoftRenderer::Clear(ImU32 color)
+{
+    std::fill(m_pixels.begin(), m_pixels.end(), color);
+}
+
+void SoftRenderer::RenderDrawData(ImDrawData* drawData)
+{
+    // textures only when they're ours - a frame from another backend's
+    // context has its textures looked after already
+    if (drawData->Textures != nullptr && ImGui::GetIO().BackendRendererUserData == this)
+        for (ImTextureData* tex : *drawData->Textures)
+            if (tex->Status != ImTextureStatus_OK)
+                UpdateTexture(tex);
+
+    if (drawData->DisplaySize.x <= 0.0f || drawData->DisplaySize.y <= 0.0f || m_pixels.empty())
+        return;
+    m_stats.frames++;
+
+    ImVec2 origin = drawData->DisplayPos;
+    ImVec2 scale = drawData->FramebufferScale;
+    for (const ImDrawList* list : drawData->CmdLists)
+    {
+        const ImDrawVert* vertices = list->VtxBuffer.Data;
+        const ImDrawIdx* indices = list->IdxBuffer.Data;
+        for (const ImDrawCmd& cmd : list->CmdBuffer)
+        {
+            if (cmd.UserCallback)
+            {
+                if (cmd.UserCallback != ImDrawCallback_ResetRenderState)
+                    cmd.UserCallback(list, &cmd);
+                continue;
+            }
+
+            // scissor truncated to whole pixels like the dx11 one
+            Clip clip;
+            clip.x0 = std::max(0, (int)((cmd.ClipRect.x - origin.x) * scale.x));
+            clip.y0 = std::max(0, (int)((cmd.ClipRect.y - origin.y) * scale.y));
+            clip.x1 = std::min(m_width, (int)((cmd.ClipRect.z - origin.x) * scale.x));
+            clip.y1 = std::min(m_height, (int)((cmd.ClipRect.w - origin.y) * scale.y));
+            if (clip.x1 <= clip.x0 || clip.y1 <= clip.y0)
+                continue;
+
+            Texture texture = Resolve(cmd);
+            const ImDrawVert* base = vertices + cmd.VtxOffset;
+            auto vertex = [&](ImDrawIdx i) {
+                const ImDrawVert& v = base[i];
+                return Vertex{ (v.pos.x - origin.x) * scale.x, (v.pos.y - origin.y) * scale.y, v.uv.x, v.uv.y, v.col };
+            };
+
+            const ImDrawIdx* idx = indices + cmd.IdxOffset;
+            const ImDrawIdx* end = idx + cmd.ElemCount;
+            while (idx + 3 <= end)
+            {
+                // PrimRect/PrimRectUV: a, (c.x, a.y), c, (a.x, c.y) with one color
+                // and the uvs lined up with the sides
+                if (idx + 6 <= end && idx[3] == idx[0] && idx[4] == idx[2])
+                {
+                    const ImDrawVert& a = base[idx[0]];
+                    const ImDrawVert& b = base[idx[1]];
+                    const ImDrawVert& c = base[idx[2]];
+                    const ImDrawVert& d = base[idx[5]];
+                    if (a.pos.y == b.pos.y && b.pos.x == c.pos.x && c.pos.y == d.pos.y && d.pos.x == a.pos.x &&
+                        a.uv.y == b.uv.y && b.uv.x == c.uv.x && c.uv.y == d.uv.y && d.uv.x == a.uv.x &&
+                        a.col == b.col && a.col == c.col && a.col == d.col)
+                    {
+                        DrawRect(vertex(idx[0]), vertex(idx[2]), texture, clip);
+                        idx += 6;
+                        continue;
+                    }
+                }
+                DrawTriangle(vertex(idx[0]), vertex(idx[1]), vertex(idx[2]), texture, clip);
+                idx += 3;
+            }
+        }
+    }
+}
+
+void SoftRenderer::DrawRect(const Vertex& a, const Vertex& c, const Texture& tex, const Clip& clip)
+{
+    m_stats.rects++;
+    // the pixels whose centers are inside, left and top edges included
+    float minX = std::min(a.x, c.x), maxX = std::max(a.x, c.x);
+    float minY = std::min(a.y, c.y), maxY = std::max(a.y, c.y);
+    int x0 = std::max(clip.x0, (int)std::ceil(minX - 0.5f));
+    int x1 = std::min(clip.x1, (int)std::ceil(maxX - 0.5f));
+    int y0 = std::max(clip.y0, (int)std::ceil(minY - 0.5f));
+    int y1 = std::min(clip.y1, (int)std::ceil(maxY - 0.5f));
+    if (x0 >= x1 || y0 >= y1)
+        return;
+    m_stats.pixels += (uint64_t)(x1 - x0) * (y1 - y0);
+
+    // a fill samples the atlas' white pixel everywhere, that's one color
+    if (!tex.pixels || (a.u == c.u && a.v == c.v))
+    {
+        ImU32 color = tex.pixels ? Modulate(Texel(tex.pixels, tex.width, tex.height, tex.bytesPerPixel, a.u, a.v), a.col) : a.col;
+        for (int y = y0; y < y1; y++)
+            FillSpan(&m_pixels[(size_t)y * m_width + x0], x1 - x0, color);
+        return;
+    }
+
+    float dudx = (c.u - a.u) / (c.x - a.x);
+    float dvdy = (c.v - a.v) / (c.y - a.y);
+    for (int y = y0; y < y1; y++)
+    {
+        float v = a.v + (y + 0.5f - a.y) * dvdy;
+        ImU32* dst = &m_pixels[(size_t)y * m_width];
+        for (int x = x0; x < x1; x++)
+        {
+            ImU32 texel = Texel(tex.pixels, tex.width, tex.height, tex.bytesPerPixel, a.u + (x + 0.5f - a.x) * dudx, v);
+            // most of a glyph's box is empty
+            if ((texel & IM_COL32_A_MASK) == 0)
+                continue;
+            Blend(&dst[x], Modulate(texel, a.col));
+        }
+    }
+}
+
+void SoftRenderer::DrawTriangle(const Vertex& v0, const Vertex& v1In, const Vertex& v2In, const Texture& tex, const Clip& clip)
+{
+    // edge functions are positive inside when the winding is this way round,
+    // imgui makes both
+    auto edge = [](const Vertex& a, const Vertex& b, float px, float py) {
+        return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+    };
+    float area = edge(v0, v1In, v2In.x, v2In.y);
+    if (area == 0.0f)
+        return;
+    const Vertex& v1 = area > 0.0f ? v1In : v2In;
+    const Vertex& v2 = area > 0.0f ? v2In : v1In;
+    area = std::fabs(area);
+    m_stats.triangles++;
+
+    int x0 = std::max(clip.x0, (int)std::floor(std::min({ v0.x, v1.x, v2.x })));
+    int x1 = std::min(clip.x1, (int)std::ceil(std::max({ v0.x, v1.x, v2.x })) + 1);
+    int y0 = std::max(clip.y0, (int)std::floor(std::min({ v0.y, v1.y, v2.y })));
+    int y1 = std::min(clip.y1, (int)std::ceil(std::max({ v0.y, v1.y, v2.y })) + 1);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    // a center right on an edge belongs to whichever of the two triangles
+    // sharing it sees the edge going down (or left, if it's flat)
+    auto owns = [](const Vertex& a, const Vertex& b) {
+        float dy = b.y - a.y;
+        return dy > 0.0f || (dy == 0.0f && b.x < a.x);
+    };
+    const bool own0 = owns(v1, v2), own1 = owns(v2, v0), own2 = owns(v0, v1);
+
+    const bool flatColor = v0.col == v1.col && v0.col == v2.col;
+    const bool flatUv = !tex.pixels || (v0.u == v1.u && v0.u == v2.u && v0.v == v1.v && v0.v == v2.v);
+    ImU32 flat = flatUv && tex.pixels ? Texel(tex.pixels, tex.width, tex.height, tex.bytesPerPixel, v0.u, v0.v) : 0xFFFFFFFF;
+    const float inv = 1.0f / area;
+
+    for (int y = y0; y < y1; y++)
+    {
+        float py = y + 0.5f;
+        ImU32* dst = &m_pixels[(size_t)y * m_width];
+        for (int x = x0; x < x1; x++)
+        {
+            float px = x + 0.5f;
+            float w0 = edge(v1, v2, px, py);
+            float w1 = edge(v2, v0, px, py);
+            float w2 = edge(v0, v1, px, py);
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                continue;
+            if ((w0 == 0.0f && !own0) || (w1 == 0.0f && !own1) || (w2 == 0.0f && !own2))
+                continue;
+            float l0 = w0 * inv, l1 = w1 * inv, l2 = w2 * inv;
+
+            ImU32 color = v0.col;
+            if (!flatColor)
+            {
+                color = 0;
+                for (int shift = 0; shift < 32; shift += 8)
+                {
+                    float c = ((v0.col >> shift) & 0xFF) * l0 + ((v1.col >> shift) & 0xFF) * l1 + ((v2.col >> shift) & 0xFF) * l2;
+                    color |= (ImU32)std::clamp((int)(c + 0.5f), 0, 255) << shift;
+                }
+            }
+            ImU32 texel = flat;
+            if (!flatUv)
+                texel = Texel(tex.pixels, tex.width, tex.height, tex.bytesPerPixel, v0.u * l0 + v1.u * l1 + v2.u * l2, v0.v * l0 + v1.v * l1 + v2.v * l2);
+            Blend(&dst[x], Modulate(texel, color));
+            m_stats.pixels++;
+        }
+    }
+}
+
+uint64_t SoftRenderer::Hash() const
+{
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* p = (const unsigned char*)m_pixels.data();
+    for (size_t i = 0; i < m_pixels.size() * sizeof(ImU32); i++)
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    return hash;
+}
+
+bool SoftRenderer::SaveBmp(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    auto put16 = [&](uint16_t v) { file.put((char)(v & 0xFF)).put((char)(v >> 8)); };
+    auto put32 = [&](uint32_t v) { put16((uint16_t)(v & 0xFFFF)); put16((uint16_t)(v >> 16)); };
+    uint32_t imageSize = (uint32_t)m_pixels.size() * 4;
+    // file header, then a BITMAPINFOHEADER with a negative height for top down
+    put16(0x4D42);
+    put32(14 + 40 + imageSize);
+    put32(0);
+    put32(14 + 40);
+    put32(40);
+    put32((uint32_t)m_width);
+    put32((uint32_t)-m_height);
+    put16(1);
+    put16(32);
+    put32(0);
+    put32(imageSize);
+    put32(2835);
+    put32(2835);
+    put32(0);
+    put32(0);
+
+    // bmp wants bgra
+    std::vector<uint32_t> row(m_width);
+    for (int y = 0; y < m_height; y++)
+    {
+        const ImU32* src = &m_pixels[(size_t)y * m_width];
+        for (int x = 0; x < m_width; x++)
+            row[x] = (src[x] & 0xFF00FF00) | (src[x] & 0xFF) << 16 | (src[x] >> 16 & 0xFF);
+        file.write((const char*)row.data(), (std::streamsize)row.size() * 4);
+    }
+    return (bool)file;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "imgui/imgui.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// draws ImDrawData into a framebuffer in memory, no gpu involved. Init() it
+// on a context of its own and it's that context's renderer backend, the same
+// job imgui_impl_dx11 does, so the whole ui can run headless. it can also
+// draw a frame from a context the dx11 backend owns - textures are read
+// straight out of imgui's own copy of the pixels either way
+//
+// it aims for what the dx11 backend puts on screen: triangles cover the pixel
+// centers inside them, shared edges only once, and colors blend the same way.
+// textures are point sampled - imgui puts glyphs on whole pixels, so for text
+// that's what linear filtering gives anyway. most of an imgui frame is
+// rectangles (glyphs, fills), those are spotted and drawn a span at a time,
+// and solid spans blend 4 pixels at a go where there's sse2
+class SoftRenderer
+{
+public:
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t rects = 0;           // quads drawn as spans
+        uint64_t triangles = 0;       // everything else
+        uint64_t pixels = 0;          // pixels covered
+    };
+
+    // become the renderer backend of the current context
+    void Init();
+    // before the context goes away, lets go of its textures
+    void Shutdown();
+
+    void Resize(int width, int height);
+    void Clear(ImU32 color);
+    void RenderDrawData(ImDrawData* drawData);
+
+    int Width() const { return m_width; }
+    int Height() const { return m_height; }
+    // rows top to bottom, each pixel IM_COL32 order
+    const ImU32* Pixels() const { return m_pixels.data(); }
+    // fnv-1a of the pixels, to tell frames apart without keeping them
+    uint64_t Hash() const;
+    // 32 bit top down bmp
+    bool SaveBmp(const std::string& path) const;
+
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    struct Texture
+    {
+        const unsigned char* pixels = nullptr;    // none draws as plain white
+        int width = 0;
+        int height = 0;
+        int bytesPerPixel = 0;
+    };
+    struct Vertex
+    {
+        float x, y, u, v;
+        ImU32 col;
+    };
+    struct Clip
+    {
+        int x0, y0, x1, y1;
+    };
+
+    void UpdateTexture(ImTextureData* tex);
+    static Texture Resolve(const ImDrawCmd& cmd);
+    void DrawRect(const Vertex& a, const Vertex& c, const Texture& tex, const Clip& clip);
+    void DrawTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const Texture& tex, const Clip& clip);
+
+    int m_width = 0;
+    int m_height = 0;
+    std::vector<ImU32> m_pixels;
+    Stats m_stats;
+};
@@ -0,0 +1,257 @@
+#include "text_grid.h"
+
+#include "imgui/imgui_internal.h"
+
+#include <algorithm>
+
+// quads reserved at a time, so a huge unwrapped line doesn't reserve a quad
+// for every byte when only the start of it is on screen
+static const int kQuadBlock = 256;
+
+void TextGrid::Begin(ImDrawList* drawList, ImFont* font, float fontSize)
+{
+    m_drawList = drawList;
+    m_font = font;
+    m_fontSize = fontSize;
+    Refresh();
+}
+
+// the table is good for as long as the baked font and the atlas texture stay
+// put - a new glyph can grow the atlas, which moves every uv
+void TextGrid::Refresh()
+{
+    ImFontAtlas* atlas = m_font->OwnerAtlas;
+    ImFontBaked* baked = m_font->GetFontBaked(m_fontSize);
+    if (baked == m_baked && atlas->TexData == m_texture && atlas->TexUvScale.x == m_uvScale.x && atlas->TexUvScale.y == m_uvScale.y)
+        return;
+
+    // loading the ascii glyphs the first time can grow the atlas itself, go
+    // round again if it did
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        m_baked = baked;
+        m_texture = atlas->TexData;
+        m_uvScale = atlas->TexUvScale;
+        for (unsigned int c = 0; c < 128; c++)
+            m_ascii[c] = Lookup(c);
+        if (atlas->TexData == m_texture && atlas->TexUvScale.x == m_uvScale.x && atlas->TexUvScale.y == m_uvScale.y)
+            break;
+    }
+    // carriage returns take no room, same as ImFont::RenderText
+    m_ascii['\r'] = Cell{};
+
+    m_maxX0 = 0.0f;
+    m_minX1 = 0.0f;
+    m_maxAdvance = 0.0f;
+    for (const Cell& cell : m_ascii)
+    {
+        m_maxX0 = std::max(m_maxX0, cell.x0);
+        if (cell.visible)
+            m_minX1 = std::min(m_minX1, cell.x1);
+        m_maxAdvance = std::max(m_maxAdvance, cell.advance);
+    }
+    m_stats.rebuilds++;
+}
+
+TextGrid::Cell TextGrid::Lookup(unsigned int c)
+{
+    const ImFontGlyph* glyph = m_baked->FindGlyph((ImWchar)c);
+    float scale = m_fontSize / m_baked->Size;
+    Cell cell;
+    cell.x0 = glyph->X0 * scale;
+    cell.y0 = glyph->Y0 * scale;
+    cell.x1 = glyph->X1 * scale;
+    cell.y1 = glyph->Y1 * scale;
+    cell.u0 = glyph->U0;
+    cell.v0 = glyph->V0;
+    cell.u1 = glyph->U1;
+    cell.v1 = glyph->V1;
+    cell.advance = glyph->AdvanceX * scale;
+    cell.visible = glyph->Visible;
+    cell.colored = glyph->Colored;
+    return cell;
+}
+
+float TextGrid::Width(std::string_view text)
+{
+    float width = 0.0f;
+    const char* s = text.data();
+    const char* end = s + text.size();
+    while (s < end)
+    {
+        unsigned int c = (unsigned char)*s;
+        if (c < 0x80)
+        {
+            width += m_ascii[c].advance;
+            s++;
+            continue;
+        }
+        s += ImTextCharFromUtf8(&c, s, end);
+        width += Lookup(c).advance;
+        Refresh();
+    }
+    return width;
+}
+
+bool TextGrid::DrawRow(ImVec2 pos, std::string_view text, ImU32 color, const CellRun* runs, size_t runCount)
+{
+    // pixel aligned like ImGui's own text
+    float x = IM_TRUNC(pos.x);
+    float y = IM_TRUNC(pos.y);
+    const ImVec4 clip = m_drawList->_CmdHeader.ClipRect;
+    if (text.empty())
+        return true;
+    if (y > clip.w || y + m_fontSize < clip.y)
+        return false;
+    m_stats.rows++;
+
+    // backgrounds first so the glyphs land on top
+    bool whole = true;
+    float pen = x;
+    size_t at = 0;
+    for (size_t r = 0; r < runCount; r++)
+    {
+        size_t begin = std::min<size_t>(runs[r].begin, text.size());
+        size_t end = std::min<size_t>(runs[r].end, text.size());
+        if (!runs[r].bg || begin >= end || begin < at)
+            continue;
+        pen += Width(text.substr(at, begin - at));
+        float runX = pen;
+        pen += Width(text.substr(begin, end - begin));
+        at = end;
+        if (runX > clip.z)
+        {
+            whole = false;
+            break;
+        }
+        m_drawList->AddRectFilled(ImVec2(runX, y), ImVec2(pen, y + m_fontSize), runs[r].bg);
+        m_stats.quads++;
+    }
+
+    ImDrawList* drawList = m_drawList;
+    ImDrawVert* vtx = nullptr;
+    ImDrawIdx* idx = nullptr;
+    unsigned int vtxIndex = 0;
+    int reserved = 0;                 // quads left in the current reservation
+    auto reserve = [&](size_t bytesLeft) {
+        if (vtx)
+        {
+            drawList->_VtxWritePtr = vtx;
+            drawList->_IdxWritePtr = idx;
+            drawList->_VtxCurrentIdx = vtxIndex;
+        }
+        reserved = (int)std::min<size_t>(bytesLeft, kQuadBlock);
+        drawList->PrimReserve(reserved * 6, reserved * 4);
+        vtx = drawList->_VtxWritePtr;
+        idx = drawList->_IdxWritePtr;
+        vtxIndex = drawList->_VtxCurrentIdx;   // might have started over at a new vertex offset
+    };
+
+    auto quad = [&](const Cell& cell, float pen, ImU32 col) {
+        float x1 = pen + cell.x0;
+        float x2 = pen + cell.x1;
+        float y1 = y + cell.y0;
+        float y2 = y + cell.y1;
+        vtx[0].pos.x = x1; vtx[0].pos.y = y1; vtx[0].col = col; vtx[0].uv.x = cell.u0; vtx[0].uv.y = cell.v0;
+        vtx[1].pos.x = x2; vtx[1].pos.y = y1; vtx[1].col = col; vtx[1].uv.x = cell.u1; vtx[1].uv.y = cell.v0;
+        vtx[2].pos.x = x2; vtx[2].pos.y = y2; vtx[2].col = col; vtx[2].uv.x = cell.u1; vtx[2].uv.y = cell.v1;
+        vtx[3].pos.x = x1; vtx[3].pos.y = y2; vtx[3].col = col; vtx[3].uv.x = cell.u0; vtx[3].uv.y = cell.v1;
+        idx[0] = (ImDrawIdx)vtxIndex; idx[1] = (ImDrawIdx)(vtxIndex + 1); idx[2] = (ImDrawIdx)(vtxIndex + 2);
+        idx[3] = (ImDrawIdx)vtxIndex; idx[4] = (ImDrawIdx)(vtxIndex + 2); idx[5] = (ImDrawIdx)(vtxIndex + 3);
+        vtx += 4;
+        idx += 6;
+        vtxIndex += 4;
+        reserved--;
+    };
+
+    const char* s = text.data();
+    const char* end = s + text.size();
+    uint64_t quads = 0;
+
+    // no runs and nothing off the left: the first cells that are sure to end
+    // before clip.z need no clip or color checks at all, only until the first
+    // byte that isn't ascii
+    if (runCount == 0 && x + m_minX1 >= clip.x)
+    {
+        float room = clip.z - x - m_maxX0;
+        size_t fits = room < 0.0f ? 0 : m_maxAdvance > 0.0f ? (size_t)(room / m_maxAdvance) : text.size();
+        const char* fastEnd = s + std::min(fits, text.size());
+        while (s < fastEnd)
+        {
+            if (reserved == 0)
+                reserve(end - s);
+            const char* blockEnd = s + std::min<size_t>(fastEnd - s, (size_t)reserved);
+            for (; s < blockEnd; s++)
+            {
+                unsigned int c = (unsigned char)*s;
+                if (c >= 0x80)
+                    break;
+                const Cell& cell = m_ascii[c];
+                if (cell.visible)
+                {
+                    quad(cell, x, cell.colored ? color | ~IM_COL32_A_MASK : color);
+                    quads++;
+                }
+                x += cell.advance;
+            }
+            if (s < blockEnd)
+                break;
+        }
+    }
+
+    size_t run = 0;
+    while (s < end)
+    {
+        size_t offset = s - text.data();
+        unsigned int c = (unsigned char)*s;
+        const Cell* cell;
+        Cell other;
+        if (c < 0x80)
+        {
+            cell = &m_ascii[c];
+            s++;
+        }
+        else
+        {
+            s += ImTextCharFromUtf8(&c, s, end);
+            other = Lookup(c);
+            cell = &other;
+            Refresh();
+        }
+
+        float x1 = x + cell->x0;
+        float x2 = x + cell->x1;
+        // the pen only moves right, nothing after this is visible either
+        if (x1 > clip.z)
+        {
+            whole = false;
+            break;
+        }
+        if (cell->visible && x2 < clip.x)
+            whole = false;
+        else if (cell->visible)
+        {
+            while (run < runCount && offset >= runs[run].end)
+                run++;
+            ImU32 col = run < runCount && offset >= runs[run].begin && runs[run].fg ? runs[run].fg : color;
+            if (cell->colored)
+                col |= ~IM_COL32_A_MASK;
+            if (reserved == 0)
+                reserve(end - s + 1);
+            quad(*cell, x, col);
+            quads++;
+        }
+        x += cell->advance;
+    }
+    m_stats.cells += s - text.data();
+    m_stats.quads += quads;
+
+    if (vtx)
+    {
+        drawList->_VtxWritePtr = vtx;
+        drawList->_IdxWritePtr = idx;
+        drawList->_VtxCurrentIdx = vtxIndex;
+        drawList->PrimUnreserve(reserved * 6, reserved * 4);
+    }
+    return whole;
+}
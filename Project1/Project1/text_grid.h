@@ -0,0 +1,81 @@
+#pragma once
+
+#include "imgui/imgui.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// colors for bytes [begin, end) of a row. fg 0 keeps the row's text color,
+// bg 0 leaves the background alone
+struct CellRun
+{
+    uint32_t begin;
+    uint32_t end;
+    ImU32 fg;
+    ImU32 bg;
+};
+
+// draws output rows straight into a draw list, a quad per visible cell.
+// the glyph quads and advances of ascii get looked up and scaled once per
+// font/size/atlas instead of once per character, the vertices for a row are
+// reserved in blocks, and cells past the clip rect aren't visited at all.
+// the clip rect gets checked once per row for however many cells are sure
+// to fit, so a plain ascii row is just a copy out of the table per cell.
+// anything that isn't ascii still goes through the font, one glyph at a time
+//
+// cells are as wide as the font says, so a proportional font still lines up
+// with the wrap breaks OutputLayout worked out - with a monospace one it's a grid
+class TextGrid
+{
+public:
+    struct Stats
+    {
+        uint64_t rows = 0;
+        uint64_t cells = 0;           // characters walked
+        uint64_t quads = 0;           // glyphs and backgrounds emitted
+        uint64_t rebuilds = 0;        // glyph table refreshed for a new font, size or atlas
+    };
+
+    // before drawing rows into drawList this frame
+    void Begin(ImDrawList* drawList, ImFont* font, float fontSize);
+
+    // one row with its top left at pos. runs are sorted and don't overlap.
+    // false if the clip rect cut any of it off
+    bool DrawRow(ImVec2 pos, std::string_view text, ImU32 color, const CellRun* runs = nullptr, size_t runCount = 0);
+
+    // width of text, the same sum DrawRow advances by
+    float Width(std::string_view text);
+
+    ImDrawList* DrawList() const { return m_drawList; }
+    float FontSize() const { return m_fontSize; }
+    // changes whenever the glyph table does, so anything holding on to
+    // vertices drawn with an older one knows to throw them away
+    uint64_t Generation() const { return m_stats.rebuilds; }
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    struct Cell
+    {
+        float x0, y0, x1, y1;     // quad relative to the pen, already scaled
+        float u0, v0, u1, v1;
+        float advance;
+        bool visible;
+        bool colored;             // emoji and such ignore the tint
+    };
+
+    void Refresh();
+    Cell Lookup(unsigned int c);
+
+    ImDrawList* m_drawList = nullptr;
+    ImFont* m_font = nullptr;
+    float m_fontSize = 0.0f;
+    ImFontBaked* m_baked = nullptr;
+    ImTextureData* m_texture = nullptr;   // the atlas the uvs are for
+    ImVec2 m_uvScale = ImVec2(0.0f, 0.0f);
+    Cell m_ascii[128] = {};
+    float m_maxX0 = 0.0f;                 // bounds over m_ascii, for the per row clip test
+    float m_minX1 = 0.0f;                 // ...of the visible ones
+    float m_maxAdvance = 0.0f;
+    Stats m_stats;
+};
@@ -0,0 +1,65 @@
+#include "worker_pool.h"
+
+#include "frame_profiler.h"
+
+WorkerPool::WorkerPool(unsigned threads)
+{
+    if (threads == 0)
+    {
+        unsigned cores = std::thread::hardware_concurrency();
+        threads = cores > 1 ? cores - 1 : 1;
+    }
+    for (unsigned i = 0; i < threads; i++)
+        m_threads.emplace_back([this] { Run(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_jobs.clear();  // anything not started yet just gets dropped
+    }
+    m_wake.notify_all();
+    for (auto& t : m_threads)
+        t.join();
+}
+
+void WorkerPool::Submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping)
+            return;
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+WorkerPool& WorkerPool::Shared()
+{
+    static WorkerPool pool;
+    return pool;
+}
+
+void WorkerPool::Run()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping)
+                return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        {
+            FrameProfiler::Scope scope(FrameProfiler::Stage::kWorkerJob);
+            job();
+        }
+        if (void (*notify)() = m_onJobDone.load())
+            notify();
+    }
+}
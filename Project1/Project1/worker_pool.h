@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// small fixed set of background threads for work that shouldn't run on the
+// render loop. jobs should be short - long work re-submits itself in chunks
+// so shutdown and cancellation never have to wait long
+class WorkerPool
+{
+public:
+    explicit WorkerPool(unsigned threads = 0);  // 0 = one per core, minus the ui thread
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void Submit(std::function<void()> job);
+    unsigned Threads() const { return (unsigned)m_threads.size(); }
+
+    // runs on the worker after every job, so the ui can wake up for the result
+    void SetOnJobDone(void (*notify)()) { m_onJobDone = notify; }
+
+    // the pool everything in the terminal shares
+    static WorkerPool& Shared();
+
+private:
+    void Run();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+    std::atomic<void (*)()> m_onJobDone{ nullptr };
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+// benchmarks for the parts of the terminal that don't need a window. each
+// one makes up its own input, times it and prints a line or two. they live
+// out here instead of behind a builtin so timing something never stalls the
+// ui thread of a terminal somebody is using
+//
+// terminal_bench runs every one, terminal_bench fuzzy history just those
+
+void BenchScrollback();
+void BenchOutputLayout();
+void BenchLineSplitter();
+void BenchShellSession();
+void BenchFuzzy();
+void BenchHistorySearch();
+void BenchOutputSearch();
+void BenchOutputIndex();
+void BenchChrome();
+void BenchTextGrid();
+void BenchRowCache();
+void BenchSoftRenderer();
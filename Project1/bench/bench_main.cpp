@@ -0,0 +1,74 @@
+#include "bench.h"
+
+#include "imgui/imgui.h"
+
+#include <cstdio>
+#include <cstring>
+
+struct Benchmark
+{
+    const char* name;
+    void (*run)();
+};
+
+static const Benchmark kBenchmarks[] = {
+    { "scrollback", BenchScrollback },
+    { "output_layout", BenchOutputLayout },
+    { "line_splitter", BenchLineSplitter },
+    { "shell_session", BenchShellSession },
+    { "fuzzy", BenchFuzzy },
+    { "history", BenchHistorySearch },
+    { "output_search", BenchOutputSearch },
+    { "output_index", BenchOutputIndex },
+    { "chrome", BenchChrome },
+    { "text_grid", BenchTextGrid },
+    { "row_cache", BenchRowCache },
+    { "soft_renderer", BenchSoftRenderer },
+};
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool known = false;
+        for (const Benchmark& benchmark : kBenchmarks)
+            known |= strcmp(argv[i], benchmark.name) == 0;
+        if (!known)
+        {
+            fprintf(stderr, "unknown benchmark '%s', there's:", argv[i]);
+            for (const Benchmark& benchmark : kBenchmarks)
+                fprintf(stderr, " %s", benchmark.name);
+            fprintf(stderr, "\n");
+            return 1;
+        }
+    }
+
+    // the ones that draw want what they'd get inside the terminal - a context
+    // with its fonts built, partway through a frame. no window, and nothing
+    // ever gets rendered
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.LogFilename = nullptr;
+    io.DisplaySize = ImVec2(1280, 720);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures | ImGuiBackendFlags_RendererHasVtxOffset;
+    io.Fonts->AddFontDefault();
+    ImGui::NewFrame();
+
+    for (const Benchmark& benchmark : kBenchmarks)
+    {
+        bool wanted = argc == 1;
+        for (int i = 1; i < argc; i++)
+            wanted |= strcmp(argv[i], benchmark.name) == 0;
+        if (wanted)
+        {
+            benchmark.run();
+            fflush(stdout);
+        }
+    }
+
+    ImGui::EndFrame();
+    ImGui::DestroyContext();
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "bench.h"
+
+#include "chrome.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// a frame's worth of chrome, drawn straight and through a cache
+struct ChromeBenchResult
+{
+    size_t frames = 0;
+    size_t vertices = 0;              // per frame, the same either way
+    size_t tessellated = 0;           // per frame once the cache is warm
+    double directUs = 0.0;            // per frame
+    double cachedUs = 0.0;
+};
+
+// needs an imgui context with its fonts built, no window
+static ChromeBenchResult RunChromeBenchmark(size_t frames)
+{
+    ChromeBenchResult result;
+    result.frames = frames;
+    ImDrawList list(ImGui::GetDrawListSharedData());
+    ChromeCache cache;
+
+    // three title bar buttons, one of them going in and out of hover, and a
+    // pulsing caret - what a frame with the mouse on the title bar draws
+    auto frame = [&](size_t i, ChromeCache* with) {
+        list._ResetForNewFrame();
+        list.PushClipRectFullScreen();
+        float hover = (float)(i % 64) / 63.0f;
+        DrawGlowButton(&list, with, ImVec2(900, 22), IM_COL32(220, 220, 60, 200), IM_COL32(255, 255, 95, 255), 0.0f);
+        DrawGlowButton(&list, with, ImVec2(928, 22), IM_COL32(60, 220, 60, 200), IM_COL32(95, 255, 95, 255), hover);
+        DrawGlowButton(&list, with, ImVec2(956, 22), IM_COL32(220, 60, 60, 200), IM_COL32(255, 95, 95, 255), 0.0f);
+        DrawCaret(&list, with, 120.5f + (float)(i % 40), 560, 20, IM_COL32(50, 255, 100, 255), 0.9f + 0.1f * sinf(i * 0.1f));
+        list.PopClipRect();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < frames; i++)
+        frame(i, nullptr);
+    result.directUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+    result.vertices = list.VtxBuffer.Size;
+
+    // one pass to fill the cache, then the timed one
+    cache.NewFrame();
+    for (size_t i = 0; i < frames; i++)
+        frame(i, &cache);
+    cache.NewFrame();
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < frames; i++)
+        frame(i, &cache);
+    result.cachedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+    cache.NewFrame();
+    result.tessellated = cache.GetStats().frameTessellated / frames;
+    return result;
+}
+
+void BenchChrome()
+{
+    // title bar buttons and the caret, tessellated every frame against replayed
+    ChromeBenchResult result = RunChromeBenchmark(2000);
+    printf("Chrome: %zu vertices a frame, %zu tessellated with the cache, %.1f us vs %.1f us drawing them directly\n",
+        result.vertices, result.tessellated, result.cachedUs, result.directUs);
+}
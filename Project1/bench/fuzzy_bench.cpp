@@ -0,0 +1,78 @@
+#include "bench.h"
+
+#include "fuzzy.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// candidates/second for prefilter + score + top-k over made up file names
+struct FuzzyBenchResult
+{
+    size_t candidates = 0;
+    size_t patterns = 0;
+    double seconds = 0.0;
+    double candidatesPerSecond = 0.0;
+    double worstPassMs = 0.0;   // slowest single pattern over all candidates
+};
+
+static FuzzyBenchResult RunFuzzyBenchmark(size_t candidates)
+{
+    // file names shaped like what a big directory or PATH has in it
+    static const char* kStems[] = { "build", "config", "Debug", "main", "readme", "setup", "test", "util", "WinMerge", "x64" };
+    static const char* kExts[] = { ".exe", ".txt", ".cpp", ".h", ".dll", ".json", "", ".bat" };
+    std::vector<std::string> names(candidates), folded(candidates);
+    std::vector<uint64_t> masks(candidates);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < candidates; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        names[i] = std::string(kStems[(seed >> 8) % 10]) + "_" + std::to_string(seed % 100000) + kExts[(seed >> 20) % 8];
+        folded[i] = names[i];
+        for (char& c : folded[i])
+            c = (char)tolower((unsigned char)c);
+        masks[i] = FuzzyCharMask(folded[i]);
+    }
+
+    static const char* kPatterns[] = { "b", "cfg", "mn", "rdm.t", "wm", "x64d", "test_9", "util.json", "zzq" };
+    FuzzyBenchResult result;
+    result.candidates = candidates;
+    std::vector<uint32_t> survivors, best;
+    FuzzyTopK top(30);
+    auto t0 = std::chrono::steady_clock::now();
+    for (const char* text : kPatterns)
+    {
+        auto p0 = std::chrono::steady_clock::now();
+        FuzzyPattern pattern(text);
+        survivors.clear();
+        pattern.Prefilter(masks.data(), masks.size(), survivors);
+        for (uint32_t idx : survivors)
+        {
+            int score = pattern.Score(names[idx], folded[idx]);
+            if (score > 0)
+                top.Push(score, (uint32_t)names[idx].size(), idx);
+        }
+        top.Take(best);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - p0).count();
+        result.worstPassMs = std::max(result.worstPassMs, ms);
+        result.patterns++;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (result.seconds > 0.0)
+        result.candidatesPerSecond = (double)(candidates * result.patterns) / result.seconds;
+    return result;
+}
+
+void BenchFuzzy()
+{
+    // same shape as completing in a big directory, several patterns over every candidate
+    for (size_t candidates : { 10000, 100000 })
+    {
+        FuzzyBenchResult result = RunFuzzyBenchmark(candidates);
+        printf("Fuzzy match: %zu candidates x %zu patterns, %.1f M candidates/s, slowest pass %.2f ms\n",
+            result.candidates, result.patterns, result.candidatesPerSecond / 1e6, result.worstPassMs);
+    }
+}
@@ -0,0 +1,84 @@
+#include "bench.h"
+
+#include "history_search.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// keystroke timings for ctrl+r over a made up history
+struct HistorySearchBenchResult
+{
+    size_t entries = 0;
+    double buildMs = 0.0;
+    size_t keystrokes = 0;          // typed characters plus ctrl+r presses
+    double averageMs = 0.0;
+    double worstMs = 0.0;
+};
+
+static HistorySearchBenchResult RunHistorySearchBenchmark(size_t entries)
+{
+    // the sort of thing a long lived history is full of
+    static const char* kVerbs[] = { "git commit -m \"fix ", "git checkout feature/", "cd C:\\src\\project", "cl /O2 /EHsc module",
+        "ping build", "dir /s *.", "python tools\\gen_", "cmake --build out\\", "type logs\\server_", "findstr /i error " };
+    static const char* kWords[] = { "parser", "layout", "render", "socket", "cache", "index", "loader", "shader", "input", "timer" };
+    std::vector<std::string> commands(entries);
+    uint32_t seed = 4242;
+    for (size_t i = 0; i < entries; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        commands[i] = std::string(kVerbs[(seed >> 8) % 10]) + kWords[(seed >> 16) % 10] + std::to_string(seed % 50000);
+    }
+
+    HistorySearchBenchResult result;
+    HistorySearch search;
+    auto t0 = std::chrono::steady_clock::now();
+    search.AddMany(std::vector<std::string_view>(commands.begin(), commands.end()));
+    result.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    result.entries = search.Size();
+
+    // the very first find in a process pays for some one off warm up, keep it out of the numbers
+    search.Find("e", search.Newest());
+    search.Find("warm", search.Newest());
+
+    // typed one character at a time like ctrl+r sees it, then a few presses for older matches
+    static const char* kQueries[] = { "git co", "project4", "render12", "/s *.", "zq", "feature/cache9", "qqqq", "py", "error socket3" };
+    double totalMs = 0.0;
+    for (const char* text : kQueries)
+    {
+        std::string_view query(text);
+        int64_t match = search.Newest();
+        for (size_t typed = 1; typed <= query.size() + 5; typed++)
+        {
+            auto k0 = std::chrono::steady_clock::now();
+            // once a prefix fails nothing longer can match, same as the ui
+            if (match < 0)
+                ;
+            else if (typed <= query.size())
+                match = search.Find(query.substr(0, typed), match);
+            else if (match > 0)
+                match = search.Find(query, match - 1);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - k0).count();
+            totalMs += ms;
+            result.worstMs = std::max(result.worstMs, ms);
+            result.keystrokes++;
+        }
+    }
+    if (result.keystrokes > 0)
+        result.averageMs = totalMs / result.keystrokes;
+    return result;
+}
+
+void BenchHistorySearch()
+{
+    // ctrl+r, a key at a time over a made up history
+    for (size_t entries : { 100000, 500000 })
+    {
+        HistorySearchBenchResult result = RunHistorySearchBenchmark(entries);
+        printf("History search: %zu entries indexed in %.0f ms, %zu keys, %.3f ms average, slowest %.3f ms\n",
+            result.entries, result.buildMs, result.keystrokes, result.averageMs, result.worstMs);
+    }
+}
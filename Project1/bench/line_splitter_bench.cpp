@@ -0,0 +1,115 @@
+#include "bench.h"
+
+#include "line_splitter.h"
+#include "scrollback.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// a made up stream of child output end to end into a scrollback, the way it
+// used to go (4K reads into a string, istringstream + getline, a '\r' remove
+// pass per line) and through a LineSplitter into batches, plus the splitter
+// on its own
+struct LineSplitterBenchResult
+{
+    size_t bytes = 0;
+    size_t lines = 0;
+    double oldMBPerSecond = 0.0;
+    double newMBPerSecond = 0.0;
+    double splitterMBPerSecond = 0.0;
+    bool same = false;                // both ways got the same lines
+};
+
+static LineSplitterBenchResult RunLineSplitterBenchmark(size_t megabytes)
+{
+    // lines around 60 bytes, a quarter of them ending in "\r\n"
+    static const char* kLines[] = { "  Compiling src/render/", "  Linking CXX executable bin/", "warning: unused variable 'count' in ",
+        "[INFO] request served in ", "    at Worker.run (worker.js:", "Test passed: ", "  -> copying resources to out/" };
+    std::string stream;
+    stream.reserve(megabytes * 1024 * 1024 + 256);
+    uint32_t seed = 31337;
+    LineSplitterBenchResult result;
+    while (stream.size() < megabytes * 1024 * 1024)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        stream += kLines[(seed >> 8) % 7];
+        stream += std::to_string(seed % 1000000);
+        stream += " done in " + std::to_string(seed % 977) + " ms";
+        stream += (seed >> 24) % 4 == 0 ? "\r\n" : "\n";
+        result.lines++;
+    }
+    result.bytes = stream.size();
+    // the budget holds all of it, so neither side pays for evicting
+    const size_t budget = result.bytes * 2;
+    auto mbPerSecond = [&](std::chrono::steady_clock::time_point start) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return seconds > 0.0 ? result.bytes / (1024.0 * 1024.0) / seconds : 0.0;
+    };
+
+    Scrollback oldLines(budget);
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::string pending;
+        for (size_t at = 0; at < stream.size(); at += 4096)
+        {
+            pending.append(stream, at, 4096);
+            size_t lastNewline = pending.rfind('\n');
+            if (lastNewline == std::string::npos)
+                continue;
+            std::istringstream lines(pending.substr(0, lastNewline + 1));
+            std::string line;
+            while (std::getline(lines, line))
+            {
+                line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+                oldLines.Append(line);
+            }
+            pending.erase(0, lastNewline + 1);
+        }
+        result.oldMBPerSecond = mbPerSecond(start);
+    }
+
+    Scrollback newLines(budget);
+    {
+        auto start = std::chrono::steady_clock::now();
+        LineSplitter splitter;
+        LineBatch batch;
+        auto sink = [&](std::string_view line) { batch.Add(line); };
+        for (size_t at = 0; at < stream.size(); at += 64 * 1024)
+        {
+            splitter.Feed(stream.data() + at, std::min<size_t>(64 * 1024, stream.size() - at), sink);
+            newLines.Append("", batch);
+            batch.Clear();
+        }
+        splitter.Finish(sink);
+        newLines.Append("", batch);
+        result.newMBPerSecond = mbPerSecond(start);
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        LineSplitter splitter;
+        size_t count = 0;
+        auto sink = [&](std::string_view) { count++; };
+        for (size_t at = 0; at < stream.size(); at += 64 * 1024)
+            splitter.Feed(stream.data() + at, std::min<size_t>(64 * 1024, stream.size() - at), sink);
+        splitter.Finish(sink);
+        result.splitterMBPerSecond = mbPerSecond(start);
+    }
+
+    result.same = oldLines.Size() == newLines.Size();
+    for (size_t i = 0; result.same && i < oldLines.Size(); i++)
+        result.same = oldLines[i] == newLines[i];
+    return result;
+}
+
+void BenchLineSplitter()
+{
+    LineSplitterBenchResult result = RunLineSplitterBenchmark(256);
+    printf("Line splitter: %.0f MB, %zu lines into a scrollback, %.0f MB/s vs %.0f MB/s through getline, %.0f MB/s splitting alone%s\n",
+        result.bytes / (1024.0 * 1024.0), result.lines, result.newMBPerSecond, result.oldMBPerSecond, result.splitterMBPerSecond,
+        result.same ? "" : " (LINES DIFFER)");
+}
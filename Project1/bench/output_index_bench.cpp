@@ -0,0 +1,84 @@
+#include "bench.h"
+
+#include "output_index.h"
+#include "output_search.h"
+#include "scrollback.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <thread>
+
+// index cost against plain scanning on a made up log
+struct OutputIndexBenchResult
+{
+    size_t lines = 0;
+    size_t bytes = 0;
+    double buildMs = 0.0;
+    size_t indexBytes = 0;
+    size_t queries = 0;
+    double scanMs = 0.0;            // average per query, brute force
+    double indexedMs = 0.0;         // average per query, through the index
+};
+
+static OutputIndexBenchResult RunOutputIndexBenchmark(size_t lineCount)
+{
+    static const char* kLines[] = { "  Compiling src/render/", "  Linking CXX executable bin/", "warning: unused variable 'count' in ",
+        "[INFO] request served in ", "    at Worker.run (worker.js:", "Test passed: ", "  -> copying resources to out/" };
+    Scrollback lines(lineCount * 96);
+    OutputIndexBenchResult result;
+    std::string text;
+    uint32_t seed = 777;
+    for (size_t i = 0; i < lineCount; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        text = kLines[(seed >> 8) % 7];
+        text += std::to_string(seed % 100000);
+        text += (seed >> 20) % 500 == 0 ? " ERROR: connection Timeout" : " ok";
+        lines.Append(text);
+        result.bytes += text.size();
+    }
+    result.lines = lines.Size();
+
+    OutputIndex index;
+    index.SetEnabled(true);
+    auto t0 = std::chrono::steady_clock::now();
+    index.Update(lines);
+    while (index.Sealing())
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        index.Update(lines);
+    }
+    result.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    result.indexBytes = index.MemoryBytes();
+
+    // a fresh search each time, same as opening ctrl+f and typing it out
+    static const char* kQueries[] = { "connection timeout", "worker.js:4242", "executable bin/9", "zebra", "served in 1234", "unused variable" };
+    auto run = [&](OutputIndex* with) {
+        auto q0 = std::chrono::steady_clock::now();
+        for (const char* query : kQueries)
+        {
+            OutputSearch search;
+            search.Update(lines, query, with);
+            while (search.Searching())
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                search.Update(lines, query, with);
+            }
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - q0).count() / std::size(kQueries);
+    };
+    result.queries = std::size(kQueries);
+    result.scanMs = run(nullptr);
+    result.indexedMs = run(&index);
+    return result;
+}
+
+void BenchOutputIndex()
+{
+    // what the index costs and what it saves, against scanning every line
+    OutputIndexBenchResult result = RunOutputIndexBenchmark(400000);
+    printf("Output index: %zu lines (%.1f MB) indexed in %.0f ms into %.1f MB, query %.2f ms vs %.2f ms scanning\n",
+        result.lines, result.bytes / (1024.0 * 1024.0), result.buildMs, result.indexBytes / (1024.0 * 1024.0), result.indexedMs, result.scanMs);
+}
@@ -0,0 +1,141 @@
+#include "bench.h"
+
+#include "output_layout.h"
+#include "scrollback.h"
+
+#include "imgui/imgui.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// steady state frames of a pane's output, every line through TextWrapped
+// (what panes used to do) against only the visible rows through an
+// OutputLayout and the list clipper
+struct OutputLayoutBenchResult
+{
+    size_t lines = 0;
+    double naiveMs = 0.0;             // per frame, 0 if it wasn't run
+    double layoutMs = 0.0;            // per frame
+    double firstSyncMs = 0.0;         // wrapping everything the first time
+};
+
+// sets up a context of its own and puts the current one back after
+static OutputLayoutBenchResult RunOutputLayoutBenchmark(size_t lineCount, bool naive)
+{
+    OutputLayoutBenchResult result;
+    result.lines = lineCount;
+
+    ImGuiContext* previous = ImGui::GetCurrentContext();
+    ImGuiContext* context = ImGui::CreateContext();
+    ImGui::SetCurrentContext(context);
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.LogFilename = nullptr;
+    io.DisplaySize = ImVec2(1000, 600);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures | ImGuiBackendFlags_RendererHasVtxOffset;
+    io.Fonts->AddFontDefault();
+
+    // mostly short lines, every so often one long enough to wrap a few times
+    Scrollback lines(lineCount * 256);
+    uint32_t seed = 99;
+    std::string text;
+    for (size_t i = 0; i < lineCount; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        text = "[" + std::to_string(i) + "] build step " + std::to_string(seed % 1000) + " finished";
+        if ((seed >> 16) % 16 == 0)
+        {
+            for (int k = 0; k < 12; k++)
+                text += " and then some more words to wrap";
+        }
+        lines.Append(text);
+    }
+
+    OutputLayout layout;
+    auto frame = [&](bool useLayout) {
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(ImVec2(0, 0));
+        ImGui::SetNextWindowSize(io.DisplaySize);
+        ImGui::Begin("pane", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings);
+        ImGui::BeginChild("output", ImVec2(0, 0));
+        if (useLayout)
+        {
+            // the same steps RenderTerminalPane goes through, stuck to the bottom
+            float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+            layout.Sync(lines, ImGui::GetFont(), ImGui::GetFontSize(), ImGui::GetContentRegionAvail().x);
+            layout.EnsureVisible(lines, ImGui::GetScrollY(), ImGui::GetWindowHeight(), rowHeight, true);
+            layout.TakeScrollShift();
+            ImGuiListClipper clipper;
+            clipper.Begin((int)layout.TotalRows(), rowHeight);
+            while (clipper.Step())
+            {
+                size_t lineIdx = layout.LineAtRow(clipper.DisplayStart);
+                int row = (int)layout.RowOf(lineIdx);
+                while (row < clipper.DisplayEnd && lineIdx < lines.Size())
+                {
+                    layout.ForEachRow(lineIdx, lines[lineIdx], [&](const char* begin, const char* end) {
+                        if (row++ < clipper.DisplayStart || row > clipper.DisplayEnd)
+                            return;
+                        ImGui::TextUnformatted(begin, end);
+                    });
+                    lineIdx++;
+                }
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < lines.Size(); i++)
+            {
+                std::string_view line = lines[i];
+                ImGui::PushTextWrapPos(0.0f);
+                ImGui::TextUnformatted(line.data(), line.data() + line.size());
+                ImGui::PopTextWrapPos();
+            }
+        }
+        ImGui::SetScrollHereY(1.0f);
+        ImGui::EndChild();
+        ImGui::End();
+        ImGui::Render();
+    };
+    auto time = [&](bool useLayout, int frames) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++)
+            frame(useLayout);
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+    };
+
+    // the first frames build the atlas and settle the scroll
+    if (naive)
+    {
+        time(false, 3);
+        result.naiveMs = time(false, 10);
+    }
+    result.firstSyncMs = time(true, 1);
+    time(true, 3);
+    result.layoutMs = time(true, 100);
+
+    ImGui::SetCurrentContext(previous);
+    ImGui::DestroyContext(context);
+    return result;
+}
+
+void BenchOutputLayout()
+{
+    // TextWrapped over a million lines takes long enough not to bother
+    for (size_t lines : { 1000, 100000, 1000000 })
+    {
+        OutputLayoutBenchResult result = RunOutputLayoutBenchmark(lines, lines <= 100000);
+        if (result.naiveMs > 0.0)
+        {
+            printf("Output layout: %zu lines, %.3f ms a frame vs %.3f ms wrapping every line, %.0f ms first frame\n",
+                result.lines, result.layoutMs, result.naiveMs, result.firstSyncMs);
+        }
+        else
+        {
+            printf("Output layout: %zu lines, %.3f ms a frame, %.0f ms first frame\n", result.lines, result.layoutMs, result.firstSyncMs);
+        }
+    }
+}
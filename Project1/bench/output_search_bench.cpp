@@ -0,0 +1,75 @@
+#include "bench.h"
+
+#include "output_search.h"
+#include "scrollback.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// full scans of a made up scrollback on 1, 2, 4... worker threads
+struct OutputSearchBenchResult
+{
+    unsigned threads = 0;
+    size_t lines = 0;
+    size_t bytes = 0;
+    double ms = 0.0;
+    double megabytesPerSecond = 0.0;
+};
+
+static std::vector<OutputSearchBenchResult> RunOutputSearchBenchmark(size_t lineCount, unsigned maxThreads)
+{
+    // something like a long build log, with the odd line worth finding
+    static const char* kLines[] = { "  Compiling src/render/", "  Linking CXX executable bin/", "warning: unused variable 'count' in ",
+        "[INFO] request served in ", "    at Worker.run (worker.js:", "Test passed: ", "  -> copying resources to out/" };
+    std::string text;
+    Scrollback lines(lineCount * 96);
+    uint32_t seed = 1234;
+    size_t bytes = 0;
+    for (size_t i = 0; i < lineCount; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        text = kLines[(seed >> 8) % 7];
+        text += std::to_string(seed % 100000);
+        text += (seed >> 20) % 500 == 0 ? " ERROR: connection Timeout" : " ok";
+        lines.Append(text);
+        bytes += text.size();
+    }
+
+    std::vector<OutputSearchBenchResult> results;
+    for (unsigned threads = 1; threads <= std::max(maxThreads, 1u); threads *= 2)
+    {
+        WorkerPool pool(threads);
+        OutputSearch search(&pool);
+        auto t0 = std::chrono::steady_clock::now();
+        search.Update(lines, "connection timeout");
+        while (search.Searching())
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            search.Update(lines, "connection timeout");
+        }
+        OutputSearchBenchResult result;
+        result.threads = threads;
+        result.lines = lines.Size();
+        result.bytes = bytes;
+        result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        if (result.ms > 0.0)
+            result.megabytesPerSecond = (double)bytes / (1024.0 * 1024.0) / (result.ms / 1000.0);
+        results.push_back(result);
+    }
+    return results;
+}
+
+void BenchOutputSearch()
+{
+    // ctrl+f over a full scrollback, more workers each time
+    for (const OutputSearchBenchResult& result : RunOutputSearchBenchmark(400000, std::thread::hardware_concurrency()))
+    {
+        printf("Output search: %zu lines (%.1f MB) on %u thread%s in %.1f ms, %.0f MB/s\n",
+            result.lines, result.bytes / (1024.0 * 1024.0), result.threads, result.threads == 1 ? "" : "s", result.ms, result.megabytesPerSecond);
+    }
+}
@@ -0,0 +1,95 @@
+#include "bench.h"
+
+#include "row_cache.h"
+#include "text_grid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// rows of a made up log drawn through a TextGrid every frame, and replayed
+// out of a warm RowCache
+struct RowCacheBenchResult
+{
+    size_t rows = 0;
+    size_t chars = 0;                 // per pass
+    double gridNsPerChar = 0.0;
+    double cachedNsPerChar = 0.0;     // scrolling, every replayed row gets moved
+    double stillNsPerChar = 0.0;      // redrawn in place, nothing to move
+};
+
+// needs an imgui context with its fonts built, no window
+static RowCacheBenchResult RunRowCacheBenchmark(size_t rows)
+{
+    // the same sort of made up log the text grid benchmark draws
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < rows; i++)
+    {
+        lines.push_back("[12:34:" + std::to_string(10 + i % 50) + "] cl.exe /c /O2 src\\module_" + std::to_string(i * 7919 % 1000) +
+            ".cpp -Fo build\\obj\\module.obj   warning C4267: conversion from 'size_t' to 'int' (" + std::to_string(i) + ")");
+    }
+
+    RowCacheBenchResult result;
+    result.rows = rows;
+    for (const std::string& line : lines)
+        result.chars += line.size();
+
+    ImFont* font = ImGui::GetFont();
+    float fontSize = ImGui::GetFontSize();
+    ImDrawList list(ImGui::GetDrawListSharedData());
+    TextGrid grid;
+    RowCache cache;
+    const ImU32 color = IM_COL32(230, 230, 230, 255);
+    const int passes = 20;
+
+    // a screen at a time, scrolled by a pixel each pass so the cached rows
+    // really do get moved
+    auto pass = [&](bool useCache, int scroll) {
+        for (size_t first = 0; first < lines.size(); first += 40)
+        {
+            list._ResetForNewFrame();
+            list.PushClipRect(ImVec2(0, 0), ImVec2(4096, 4096));
+            list.PushTexture(font->OwnerAtlas->TexRef);
+            grid.Begin(&list, font, fontSize);
+            if (useCache)
+                cache.Begin(&grid, color);
+            for (size_t i = first; i < std::min(first + 40, lines.size()); i++)
+            {
+                ImVec2 pos(8.0f, 8.0f + (i - first) * fontSize + scroll);
+                const std::string& line = lines[i];
+                if (useCache)
+                    cache.DrawRow(pos, i, 0, line);
+                else
+                    grid.DrawRow(pos, line, color);
+            }
+        }
+    };
+
+    // the fastest pass of each, same as the text grid benchmark
+    auto measure = [&](bool useCache, bool scrolling) {
+        pass(useCache, 0);  // loads the glyphs and fills the cache
+        double best = 0.0;
+        for (int p = 0; p < passes; p++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            pass(useCache, scrolling ? p + 1 : 0);
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (double)result.chars;
+            best = p == 0 ? ns : std::min(best, ns);
+        }
+        return best;
+    };
+    result.gridNsPerChar = measure(false, true);
+    result.cachedNsPerChar = measure(true, true);
+    result.stillNsPerChar = measure(true, false);
+    return result;
+}
+
+void BenchRowCache()
+{
+    // the same rows scrolling, drawn through the grid against replayed
+    RowCacheBenchResult result = RunRowCacheBenchmark(400);
+    printf("Row cache: %zu rows (%zu chars), %.2f ns a char replayed (%.2f ns in place) vs %.2f ns through the text grid\n",
+        result.rows, result.chars, result.cachedNsPerChar, result.stillNsPerChar, result.gridNsPerChar);
+}
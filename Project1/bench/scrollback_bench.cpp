@@ -0,0 +1,86 @@
+#include "bench.h"
+
+#include "scrollback.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// the same made up output appended to a vector<string> (what panes used to
+// keep) and to a Scrollback, big enough that nothing gets evicted, then to
+// one that's full and dropping a page at a time
+struct ScrollbackBenchResult
+{
+    size_t lines = 0;
+    double payloadBytes = 0.0;        // average line length
+    double vectorBytesPerLine = 0.0;  // strings and their heap blocks, no allocator overhead
+    double vectorMLinesPerSecond = 0.0;
+    double scrollbackBytesPerLine = 0.0;
+    double scrollbackMLinesPerSecond = 0.0;
+    double budgetMLinesPerSecond = 0.0;
+};
+
+static ScrollbackBenchResult RunScrollbackBenchmark(size_t lineCount)
+{
+    static const char* kLines[] = { "  Compiling src/render/", "  Linking CXX executable bin/", "warning: unused variable 'count' in ",
+        "[INFO] request served in ", "    at Worker.run (worker.js:", "Test passed: ", "  -> copying resources to out/" };
+    std::vector<std::string> texts(lineCount);
+    uint32_t seed = 2024;
+    size_t payload = 0;
+    for (size_t i = 0; i < lineCount; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        texts[i] = std::string(kLines[(seed >> 8) % 7]) + std::to_string(seed % 100000) + ((seed >> 20) % 4 == 0 ? " (cached)" : "");
+        payload += texts[i].size();
+    }
+
+    ScrollbackBenchResult result;
+    result.lines = lineCount;
+    result.payloadBytes = (double)payload / lineCount;
+    auto mlinesPerSecond = [&](std::chrono::steady_clock::time_point start) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return seconds > 0.0 ? lineCount / seconds / 1e6 : 0.0;
+    };
+
+    {
+        std::vector<std::string> lines;
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& text : texts)
+            lines.push_back(text);
+        result.vectorMLinesPerSecond = mlinesPerSecond(start);
+        size_t bytes = lines.capacity() * sizeof(std::string);
+        for (const std::string& line : lines)
+        {
+            if (line.capacity() > std::string().capacity())
+                bytes += line.capacity() + 1;
+        }
+        result.vectorBytesPerLine = (double)bytes / lineCount;
+    }
+    {
+        Scrollback lines(payload * 2);
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& text : texts)
+            lines.Append(text);
+        result.scrollbackMLinesPerSecond = mlinesPerSecond(start);
+        result.scrollbackBytesPerLine = (double)lines.BytesUsed() / lineCount;
+    }
+    {
+        // an eighth of it fits, the rest is evicting the whole way
+        Scrollback lines(payload / 8);
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& text : texts)
+            lines.Append(text);
+        result.budgetMLinesPerSecond = mlinesPerSecond(start);
+    }
+    return result;
+}
+
+void BenchScrollback()
+{
+    ScrollbackBenchResult result = RunScrollbackBenchmark(2000000);
+    printf("Scrollback: %zu lines of %.1f bytes, vector<string> %.1f bytes a line at %.1f M lines/s\n",
+        result.lines, result.payloadBytes, result.vectorBytesPerLine, result.vectorMLinesPerSecond);
+    printf("Scrollback: paged %.1f bytes a line at %.1f M lines/s, %.1f M lines/s when full\n",
+        result.scrollbackBytesPerLine, result.scrollbackMLinesPerSecond, result.budgetMLinesPerSecond);
+}
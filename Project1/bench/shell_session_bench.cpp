@@ -0,0 +1,85 @@
+#include "bench.h"
+
+#include "process.h"
+#include "shell_session.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// round trips of a command that does nothing, through a pane's long lived
+// shell and through a fresh shell process per command (what panes used to do)
+struct ShellSessionBenchResult
+{
+    size_t commands = 0;
+    double sessionMedianMs = 0.0;
+    double sessionP99Ms = 0.0;
+    double spawnMedianMs = 0.0;
+    double spawnP99Ms = 0.0;
+    size_t failed = 0;                // commands that didn't exit 0
+};
+
+static ShellSessionBenchResult RunShellSessionBenchmark(size_t commands)
+{
+#ifdef _WIN32
+    const std::string command = "rem";
+#else
+    const std::string command = "true";
+#endif
+    ShellSessionBenchResult result;
+    result.commands = commands;
+    auto percentiles = [](std::vector<double>& ms, double& median, double& p99) {
+        std::sort(ms.begin(), ms.end());
+        median = ms[ms.size() / 2];
+        p99 = ms[std::min(ms.size() - 1, ms.size() * 99 / 100)];
+    };
+
+    std::vector<double> ms;
+    {
+        ShellSession session;
+        SpawnContext context;
+        // the first one starts the shell, that's not what's being timed
+        for (size_t i = 0; i <= commands; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::shared_ptr<CommandJob> job = session.Run(command, context);
+            while (!job->Finished())
+                std::this_thread::yield();
+            if (i > 0)
+                ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            result.failed += job->ExitCode() != 0;
+        }
+        percentiles(ms, result.sessionMedianMs, result.sessionP99Ms);
+    }
+
+    ms.clear();
+    char buffer[4096];
+    for (size_t i = 0; i < commands; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        ChildProcess process;
+        if (!process.Start(command))
+        {
+            result.failed++;
+            continue;
+        }
+        while (process.Read(buffer, sizeof(buffer)) > 0)
+            ;
+        result.failed += process.Wait() != 0;
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    if (!ms.empty())
+        percentiles(ms, result.spawnMedianMs, result.spawnP99Ms);
+    return result;
+}
+
+void BenchShellSession()
+{
+    ShellSessionBenchResult result = RunShellSessionBenchmark(500);
+    printf("Shell session: %zu commands, median %.3f ms p99 %.3f ms vs a process each median %.3f ms p99 %.3f ms%s\n",
+        result.commands, result.sessionMedianMs, result.sessionP99Ms, result.spawnMedianMs, result.spawnP99Ms,
+        result.failed ? " (SOME FAILED)" : "");
+}
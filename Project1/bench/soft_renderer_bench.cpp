@@ -0,0 +1,111 @@
+#include "bench.h"
+
+#include "soft_renderer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// frames of a terminal-ish window built by its own imgui context and drawn
+// by a SoftRenderer, the whole way from NewFrame to pixels
+struct SoftRendererBenchResult
+{
+    size_t frames = 0;
+    int width = 0;
+    int height = 0;
+    size_t vertices = 0;              // per frame
+    double buildMs = 0.0;             // per frame, NewFrame to Render
+    double rasterMs = 0.0;            // ...and drawing it
+    uint64_t hash = 0;                // of the last frame, the same every run
+};
+
+// sets up a context of its own and puts the current one back after
+static SoftRendererBenchResult RunSoftRendererBenchmark(size_t frames)
+{
+    SoftRendererBenchResult result;
+    result.frames = frames;
+    result.width = 1280;
+    result.height = 720;
+
+    ImGuiContext* previous = ImGui::GetCurrentContext();
+    ImGuiContext* context = ImGui::CreateContext();
+    ImGui::SetCurrentContext(context);
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.LogFilename = nullptr;
+    io.DisplaySize = ImVec2((float)result.width, (float)result.height);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.Fonts->AddFontDefault();
+
+    SoftRenderer renderer;
+    renderer.Init();
+    renderer.Resize(result.width, result.height);
+
+    // a window of output with a few widgets on top, nothing that moves so
+    // every frame (and every run) comes out the same
+    std::vector<std::string> lines;
+    for (int i = 0; i < 48; i++)
+    {
+        lines.push_back("[12:34:" + std::to_string(10 + i) + "] cl.exe /c /O2 src\\module_" + std::to_string(i * 7919 % 1000) +
+            ".cpp -Fo build\\obj\\module.obj   warning C4267: conversion from 'size_t' to 'int'");
+    }
+    auto frame = [&]() {
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(ImVec2(20, 20));
+        ImGui::SetNextWindowSize(ImVec2(result.width - 40.0f, result.height - 40.0f));
+        ImGui::Begin("Terminal", nullptr, ImGuiWindowFlags_NoSavedSettings);
+        ImGui::Button("Run");
+        ImGui::SameLine();
+        ImGui::ProgressBar(0.4f, ImVec2(200, 0));
+        ImGui::Separator();
+        ImGui::BeginChild("output", ImVec2(0, 0), ImGuiChildFlags_Borders);
+        for (const std::string& line : lines)
+            ImGui::TextUnformatted(line.data(), line.data() + line.size());
+        ImGui::EndChild();
+        ImDrawList* drawList = ImGui::GetForegroundDrawList();
+        drawList->AddCircleFilled(ImVec2(result.width - 60.0f, 60.0f), 16.0f, IM_COL32(255, 95, 86, 200));
+        drawList->AddRectFilled(ImVec2(60, result.height - 90.0f), ImVec2(400, result.height - 50.0f), IM_COL32(40, 120, 220, 160), 8.0f);
+        ImGui::End();
+        ImGui::Render();
+    };
+
+    // the first frames load glyphs and settle the layout
+    for (int i = 0; i < 3; i++)
+    {
+        frame();
+        renderer.Clear(IM_COL32(0, 0, 0, 255));
+        renderer.RenderDrawData(ImGui::GetDrawData());
+    }
+
+    double build = 0.0, raster = 0.0;
+    for (size_t f = 0; f < frames; f++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        frame();
+        auto built = std::chrono::steady_clock::now();
+        renderer.Clear(IM_COL32(0, 0, 0, 255));
+        renderer.RenderDrawData(ImGui::GetDrawData());
+        auto drawn = std::chrono::steady_clock::now();
+        build += std::chrono::duration<double, std::milli>(built - start).count();
+        raster += std::chrono::duration<double, std::milli>(drawn - built).count();
+    }
+    result.vertices = (size_t)ImGui::GetDrawData()->TotalVtxCount;
+    result.buildMs = frames ? build / frames : 0.0;
+    result.rasterMs = frames ? raster / frames : 0.0;
+    result.hash = renderer.Hash();
+
+    renderer.Shutdown();
+    ImGui::SetCurrentContext(previous);
+    ImGui::DestroyContext(context);
+    return result;
+}
+
+void BenchSoftRenderer()
+{
+    // a whole frame without the gpu, imgui's side and the rasterizing
+    SoftRendererBenchResult result = RunSoftRendererBenchmark(100);
+    printf("Software frame: %dx%d, %zu vertices, %.2f ms to build and %.2f ms to draw, hash %016llx\n",
+        result.width, result.height, result.vertices, result.buildMs, result.rasterMs, (unsigned long long)result.hash);
+}
@@ -0,0 +1,87 @@
+#include "bench.h"
+
+#include "text_grid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// rows of a made up log through ImDrawList::AddText and through a TextGrid
+struct TextGridBenchResult
+{
+    size_t rows = 0;
+    size_t chars = 0;                 // per pass
+    double addTextNsPerChar = 0.0;
+    double gridNsPerChar = 0.0;
+};
+
+// needs an imgui context with its fonts built, no window
+static TextGridBenchResult RunTextGridBenchmark(size_t rows)
+{
+    // build output sort of lines, a screen's worth of columns each
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < rows; i++)
+    {
+        lines.push_back("[12:34:" + std::to_string(10 + i % 50) + "] cl.exe /c /O2 src\\module_" + std::to_string(i * 7919 % 1000) +
+            ".cpp -Fo build\\obj\\module.obj   warning C4267: conversion from 'size_t' to 'int' (" + std::to_string(i) + ")");
+    }
+
+    TextGridBenchResult result;
+    result.rows = rows;
+    for (const std::string& line : lines)
+        result.chars += line.size();
+
+    ImFont* font = ImGui::GetFont();
+    float fontSize = ImGui::GetFontSize();
+    ImDrawList list(ImGui::GetDrawListSharedData());
+    TextGrid grid;
+    const ImU32 color = IM_COL32(230, 230, 230, 255);
+    const int passes = 20;
+
+    // a screen at a time, so a list never needs more than 16 bit indices
+    auto pass = [&](bool useGrid) {
+        for (size_t first = 0; first < lines.size(); first += 40)
+        {
+            list._ResetForNewFrame();
+            list.PushClipRect(ImVec2(0, 0), ImVec2(4096, 4096));
+            list.PushTexture(font->OwnerAtlas->TexRef);
+            if (useGrid)
+                grid.Begin(&list, font, fontSize);
+            for (size_t i = first; i < std::min(first + 40, lines.size()); i++)
+            {
+                ImVec2 pos(8.0f, 8.0f + (i - first) * fontSize);
+                const std::string& line = lines[i];
+                if (useGrid)
+                    grid.DrawRow(pos, line, color);
+                else
+                    list.AddText(font, fontSize, pos, color, line.data(), line.data() + line.size());
+            }
+        }
+    };
+
+    // the fastest pass of each, one slow pass on a busy machine shouldn't decide it
+    for (bool useGrid : { false, true })
+    {
+        pass(useGrid);  // loads the glyphs
+        double best = 0.0;
+        for (int p = 0; p < passes; p++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            pass(useGrid);
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (double)result.chars;
+            best = p == 0 ? ns : std::min(best, ns);
+        }
+        (useGrid ? result.gridNsPerChar : result.addTextNsPerChar) = best;
+    }
+    return result;
+}
+
+void BenchTextGrid()
+{
+    // output rows through ImGui's text path against the grid
+    TextGridBenchResult result = RunTextGridBenchmark(400);
+    printf("Text grid: %zu rows (%zu chars), %.2f ns a char vs %.2f ns through AddText\n",
+        result.rows, result.chars, result.gridNsPerChar, result.addTextNsPerChar);
+}
@@ -0,0 +1,216 @@
+#include "frame_scheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using Clock = FrameScheduler::Clock;
+using std::chrono::milliseconds;
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+// a scheduler past its startup frames, with nothing pending
+static void Settle(FrameScheduler& scheduler, Clock::time_point now)
+{
+    while (scheduler.BeginFrame(now))
+        ;
+}
+
+static void TestStartsThenIdles()
+{
+    FrameScheduler scheduler;
+    Clock::time_point t0 = Clock::now();
+
+    // the first two frames get drawn without anyone asking
+    CHECK(scheduler.TimeToNextFrame(t0) == Clock::duration::zero());
+    CHECK(scheduler.BeginFrame(t0));
+    CHECK(scheduler.BeginFrame(t0));
+
+    // then nothing is owed, so the loop can sleep for as long as it likes
+    CHECK(!scheduler.BeginFrame(t0));
+    CHECK(scheduler.TimeToNextFrame(t0) == Clock::duration::max());
+    CHECK(scheduler.TimeToNextFrame(t0 + std::chrono::hours(1)) == Clock::duration::max());
+    CHECK(scheduler.GetStats().frames == 2);
+    CHECK(scheduler.GetStats().wakeups == 3);
+}
+
+static void TestInvalidate()
+{
+    FrameScheduler scheduler;
+    Clock::time_point t0 = Clock::now();
+    Settle(scheduler, t0);
+
+    scheduler.Invalidate();
+    CHECK(scheduler.TimeToNextFrame(t0) == Clock::duration::zero());
+    CHECK(scheduler.BeginFrame(t0));
+    CHECK(!scheduler.BeginFrame(t0));
+
+    // input asks for two, and a smaller ask on top doesn't cut that short
+    scheduler.Invalidate(2);
+    scheduler.Invalidate(1);
+    CHECK(scheduler.BeginFrame(t0));
+    CHECK(scheduler.BeginFrame(t0));
+    CHECK(!scheduler.BeginFrame(t0));
+    CHECK(scheduler.TimeToNextFrame(t0) == Clock::duration::max());
+}
+
+static void TestThrottle()
+{
+    FrameScheduler scheduler;
+    Clock::time_point t0 = Clock::now();
+    Settle(scheduler, t0);
+    scheduler.Invalidate();
+    CHECK(scheduler.BeginFrame(t0));
+    CHECK(scheduler.FrameTime() == t0);
+
+    // an animation asks for its next frame relative to the one being drawn,
+    // and only the earliest ask counts
+    scheduler.RequestFrameIn(0.5);
+    scheduler.RequestFrameIn(0.25);
+    scheduler.RequestFrameIn(1.0);
+    CHECK(scheduler.TimeToNextFrame(t0) == milliseconds(250));
+    CHECK(scheduler.TimeToNextFrame(t0 + milliseconds(100)) == milliseconds(150));
+
+    // waking early draws nothing and keeps the deadline
+    CHECK(!scheduler.BeginFrame(t0 + milliseconds(100)));
+    CHECK(scheduler.TimeToNextFrame(t0 + milliseconds(100)) == milliseconds(150));
+
+    // late is due straight away
+    CHECK(scheduler.TimeToNextFrame(t0 + milliseconds(400)) == Clock::duration::zero());
+    CHECK(scheduler.BeginFrame(t0 + milliseconds(250)));
+    CHECK(scheduler.GetStats().deadlines == 1);
+
+    // that frame used the deadline up, an animation that stopped asking goes idle
+    CHECK(!scheduler.BeginFrame(t0 + milliseconds(500)));
+    CHECK(scheduler.TimeToNextFrame(t0 + milliseconds(500)) == Clock::duration::max());
+
+    // one that keeps asking every frame keeps getting frames at its rate
+    Clock::time_point now = t0 + milliseconds(1000);
+    scheduler.RequestFrameAt(now);
+    for (int i = 0; i < 5; i++)
+    {
+        CHECK(scheduler.BeginFrame(now));
+        scheduler.RequestFrameIn(0.1);
+        CHECK(!scheduler.BeginFrame(now + milliseconds(50)));
+        now += milliseconds(100);
+    }
+    CHECK(scheduler.GetStats().deadlines == 6);
+}
+
+static void TestSignalWakesOnce()
+{
+    FrameScheduler scheduler;
+    std::atomic<int> wakes{ 0 };
+    scheduler.SetWakeHook([&] { wakes++; });
+    Clock::time_point t0 = Clock::now();
+    Settle(scheduler, t0);
+
+    // a flood of output posts one wake until the frame it asked for starts
+    for (int i = 0; i < 100; i++)
+        scheduler.Signal();
+    CHECK(wakes == 1);
+    CHECK(scheduler.TimeToNextFrame(t0) == Clock::duration::zero());
+    CHECK(scheduler.BeginFrame(t0));
+    CHECK(!scheduler.BeginFrame(t0));
+
+    // a signal that lands while a frame is being drawn owes another frame
+    scheduler.Invalidate();
+    CHECK(scheduler.BeginFrame(t0));
+    scheduler.Signal();
+    CHECK(wakes == 2);
+    CHECK(scheduler.BeginFrame(t0));
+    CHECK(!scheduler.BeginFrame(t0));
+    CHECK(scheduler.GetStats().signals == 2);
+}
+
+static void TestSignalFromThreads()
+{
+    FrameScheduler scheduler;
+    std::atomic<int> wakes{ 0 };
+    scheduler.SetWakeHook([&] { wakes++; });
+    Clock::time_point t0 = Clock::now();
+    Settle(scheduler, t0);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 10000; i++)
+                scheduler.Signal();
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    CHECK(wakes == 1);
+    CHECK(scheduler.BeginFrame(t0));
+    CHECK(!scheduler.BeginFrame(t0));
+}
+
+// the main loop against a fake clock - how many frames ten seconds costs
+static int SimulateLoop(FrameScheduler& scheduler, Clock::time_point& now, bool jobRunning)
+{
+    Clock::time_point end = now + std::chrono::seconds(10);
+    int frames = 0;
+    for (;;)
+    {
+        Clock::duration wait = scheduler.TimeToNextFrame(now);
+        // nothing pending - the real loop blocks on the message queue, no timeout
+        if (wait == Clock::duration::max() || now + wait > end)
+            break;
+        now += wait;
+        if (!scheduler.BeginFrame(now))
+            continue;
+        frames++;
+        // what the running command indicator asks for while it's drawn
+        if (jobRunning)
+            scheduler.RequestFrameIn(0.125);
+    }
+    now = end;
+    return frames;
+}
+
+static void TestIdleAndSpinnerRates()
+{
+    FrameScheduler scheduler;
+    Clock::time_point now = Clock::now();
+    Settle(scheduler, now);
+
+    // idle: no frames, and the wait stays unbounded
+    CHECK(SimulateLoop(scheduler, now, false) == 0);
+    CHECK(scheduler.TimeToNextFrame(now) == Clock::duration::max());
+
+    // a command running keeps the spinner at 8 frames a second, not vsync
+    scheduler.Invalidate();
+    int frames = SimulateLoop(scheduler, now, true);
+    CHECK(frames >= 79 && frames <= 81);
+
+    // once it's done that's one more frame and back to sleep
+    CHECK(SimulateLoop(scheduler, now, false) == 1);
+    CHECK(scheduler.TimeToNextFrame(now) == Clock::duration::max());
+}
+
+int main()
+{
+    TestStartsThenIdles();
+    TestInvalidate();
+    TestThrottle();
+    TestSignalWakesOnce();
+    TestSignalFromThreads();
+    TestIdleAndSpinnerRates();
+    if (g_failures)
+        fprintf(stderr, "%d check%s failed\n", g_failures, g_failures == 1 ? "" : "s");
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+#include "shell_session.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+// runs a command to the end (or gives up after a few seconds), its output in lines
+static bool RunToEnd(ShellSession& shell, const std::string& command, std::vector<std::string>* lines = nullptr, int* exitCode = nullptr)
+{
+    std::shared_ptr<CommandJob> job = shell.Run(command, SpawnContext{});
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    LineBatch batch;
+    while (!job->Finished())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            fprintf(stderr, "'%s' never finished\n", command.c_str());
+            shell.Cancel();
+            return false;
+        }
+        job->TakeLines(batch);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    job->TakeLines(batch);
+    if (lines)
+    {
+        lines->clear();
+        for (size_t i = 0; i < batch.Size(); i++)
+            lines->emplace_back(batch[i]);
+    }
+    if (exitCode)
+        *exitCode = job->ExitCode();
+    return true;
+}
+
+static void TestOutputAndExitCode()
+{
+    ShellSession shell;
+    std::vector<std::string> lines;
+    int exitCode = -1;
+    CHECK(RunToEnd(shell, "echo hello", &lines, &exitCode));
+    CHECK(lines.size() == 1 && lines[0] == "hello");
+    CHECK(exitCode == 0);
+
+#ifdef _WIN32
+    CHECK(RunToEnd(shell, "cmd /c exit 3", &lines, &exitCode));
+#else
+    CHECK(RunToEnd(shell, "(exit 3)", &lines, &exitCode));
+#endif
+    CHECK(exitCode == 3);
+}
+
+static void TestCwdSticks()
+{
+    ShellSession shell;
+#ifdef _WIN32
+    CHECK(RunToEnd(shell, "cd /d %SystemRoot%"));
+#else
+    CHECK(RunToEnd(shell, "cd /"));
+#endif
+    std::string cwd = shell.Cwd();
+    CHECK(!cwd.empty());
+
+    CHECK(RunToEnd(shell, "echo x"));
+    CHECK(shell.Cwd() == cwd);
+}
+
+// what the shell did to its PATH comes back, expanded, instead of the text of the command
+static void TestEnvComesBack()
+{
+    ShellSession shell;
+    CHECK(RunToEnd(shell, "echo x"));
+    const char* before = shell.Env().Get("PATH");
+    CHECK(before != nullptr);
+    std::string path = before ? before : "";
+
+#ifdef _WIN32
+    CHECK(RunToEnd(shell, "set PATH=%PATH%;C:\\lt_test_dir"));
+    std::string expected = path + ";C:\\lt_test_dir";
+#else
+    CHECK(RunToEnd(shell, "PATH=\"$PATH:/lt_test_dir\""));
+    std::string expected = path + ":/lt_test_dir";
+#endif
+    const char* after = shell.Env().Get("PATH");
+    CHECK(after != nullptr && expected == after);
+
+    // and a shell started over from it has it too
+    Environment env = shell.Env();
+    shell.Cancel();
+    SpawnContext context;
+    context.env = env;
+    std::shared_ptr<CommandJob> job = shell.Run("echo x", context);
+    while (!job->Finished())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    after = shell.Env().Get("PATH");
+    CHECK(after != nullptr && expected == after);
+}
+
+// commands that read stdin must get EOF, not the lines we send after them
+static void TestStdinReaders()
+{
+    ShellSession shell;
+#ifdef _WIN32
+    const char* commands[] = { "sort", "set /p x=", "more", "findstr x", "pause", "echo (a) & sort", "echo b)" };
+#else
+    const char* commands[] = { "sort", "read x", "cat", "head -n 1", "echo b)" };
+#endif
+    for (const char* command : commands)
+        CHECK(RunToEnd(shell, command));
+
+    // and the session still works afterwards
+    std::vector<std::string> lines;
+    CHECK(RunToEnd(shell, "echo after", &lines));
+    CHECK(lines.size() == 1 && lines[0] == "after");
+
+#ifdef _WIN32
+    // a ) of the command's own can't close the <nul block early
+    CHECK(RunToEnd(shell, "echo (hi)", &lines));
+    CHECK(lines.size() == 1 && lines[0] == "(hi)");
+#endif
+}
+
+int main()
+{
+    TestOutputAndExitCode();
+    TestCwdSticks();
+    TestEnvComesBack();
+    TestStdinReaders();
+
+    if (g_failures)
+        fprintf(stderr, "%d check%s failed\n", g_failures, g_failures == 1 ? "" : "s");
+    return g_failures ? 1 : 0;
+}